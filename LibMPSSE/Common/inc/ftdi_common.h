@@ -23,6 +23,14 @@
  * 0.1 - initial version
  * 0.2 - 20110708 - Changed MAX_CLOCK_RATE from 3.4 to 30MHz
  * 0.3 - 20111103 - Added MPSSE command definations for fullduplex transfers
+ * 0.5 - 20261015 - Added MPSSE commands to clock without data transfer
+ *				  Added MPSSE_MAX_DATA_LENGTH
+ *				  LOCK_CHANNEL & UNLOCK_CHANNEL now take the channel's mutex
+ *				  Added DEVICE_READ_TIMEOUT
+ *				  Added MPSSE_DATA_OUT_BIT & MPSSE_DATA_IN_BIT
+ *				  Added MPSSE_CMD_WAIT_ON_IO_HIGH & MPSSE_CMD_WAIT_ON_IO_LOW
+ *				  Added MPSSE_CMD_ENABLE_ADAPTIVE_CLOCKING & MPSSE_CMD_DISABLE_ADAPTIVE_CLOCKING
+ *				  Added MPSSE_DATA_LSB_FIRST_BIT
  */
 
 #ifndef FTDI_COMMON_H
@@ -33,9 +41,11 @@
 /*								Macro defines								  */
 /******************************************************************************/
 /* Macros to be called before starting and after ending communication over a MPSSE channel.
-Implement the lock/unlock only if really required, otherwise keep as placeholders */
-#define LOCK_CHANNEL(arg)	{;}
-#define UNLOCK_CHANNEL(arg)	{;}
+The argument is a pointer to the channel's context, which must have an InfraMutex member named
+lock. A transaction on a channel is hence never interleaved with another one on the same channel,
+while transactions on different channels run in parallel */
+#define LOCK_CHANNEL(arg)	INFRA_MUTEX_LOCK(&((arg)->lock))
+#define UNLOCK_CHANNEL(arg)	INFRA_MUTEX_UNLOCK(&((arg)->lock))
 
 #define MIN_CLOCK_RATE 					0
 #define MAX_CLOCK_RATE 					30000000
@@ -47,6 +57,7 @@ Implement the lock/unlock only if really required, otherwise keep as placeholder
 #define DISABLE_EVENT					0
 #define DISABLE_CHAR					0
 #define DEVICE_READ_TIMEOUT_INFINITE    0
+#define DEVICE_READ_TIMEOUT 			5000
 #define DEVICE_WRITE_TIMEOUT 			5000
 #define INTERFACE_MASK_IN				0x00
 #define INTERFACE_MASK_OUT				0x01
@@ -62,7 +73,16 @@ Implement the lock/unlock only if really required, otherwise keep as placeholder
 #define MPSSE_CMD_SEND_IMMEDIATE			0x87
 #define MPSSE_CMD_ENABLE_3PHASE_CLOCKING	0x8C
 #define MPSSE_CMD_DISABLE_3PHASE_CLOCKING	0x8D
+/* Each clock edge waits for the return clock on GPIOL3 - FT2232H, FT4232H & FT232H only */
+#define MPSSE_CMD_ENABLE_ADAPTIVE_CLOCKING	0x96
+#define MPSSE_CMD_DISABLE_ADAPTIVE_CLOCKING	0x97
 #define MPSSE_CMD_ENABLE_DRIVE_ONLY_ZERO	0x9E
+/* Clock commands without data transfer - FT2232H, FT4232H & FT232H only */
+#define MPSSE_CMD_CLOCK_N_BITS				0x8E
+#define MPSSE_CMD_CLOCK_N_BYTES				0x8F
+/* Commands that stall the MPSSE until GPIOL1 is high/low - FT2232H, FT4232H & FT232H only */
+#define MPSSE_CMD_WAIT_ON_IO_HIGH			0x88
+#define MPSSE_CMD_WAIT_ON_IO_LOW			0x89
 
 
 
@@ -83,6 +103,15 @@ Implement the lock/unlock only if really required, otherwise keep as placeholder
 #define MPSSE_CMD_DATA_BYTES_IN_POS_OUT_NEG_EDGE	0x31
 #define MPSSE_CMD_DATA_BYTES_IN_NEG_OUT_POS_EDGE	0x34
 
+/*Bits of a data command that tell whether it clocks data out and/or in*/
+#define MPSSE_DATA_OUT_BIT					0x10
+#define MPSSE_DATA_IN_BIT					0x20
+/*Bit of a data command that makes it clock each byte LSB first*/
+#define MPSSE_DATA_LSB_FIRST_BIT			0x08
+
+/*Maximum number of bytes that can be clocked by one byte mode data command*/
+#define MPSSE_MAX_DATA_LENGTH				65536
+
 
 /*SCL & SDA directions*/
 #define DIRECTION_SCLIN_SDAIN				0x10
@@ -0,0 +1,161 @@
+/*!
+ * \file ftdi_emu.h
+ *
+ * \author FTDI
+ * \date 20261015
+ *
+ * Copyright  2000-2014 Future Technology Devices International Limited
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Project: libMPSSE
+ * Module: Emulator
+ *
+ * Rivision History:
+ * 0.5  - 20261015 - initial version
+ *				  added EmuSlave.busy, the wait on I/O commands are emulated
+ *				  slaves may be selected by ACBUS0-ACBUS7(EMU_CS_PIN_ACBUS0)
+ *
+ */
+
+#ifndef FTDI_EMU_H
+#define FTDI_EMU_H
+
+#include "ftdi_infra.h"		/*portable infrastructure(datatypes, libraries, etc)*/
+
+
+/******************************************************************************/
+/*								Macro defines								  */
+/******************************************************************************/
+
+/* Environment variable that makes Init_libMPSSE install the emulator instead of loading D2XX.
+Its value is the number of channels to emulate, any other value selects EMU_DEFAULT_CHANNELS */
+#define EMU_ENVIRONMENT_VARIABLE		"LIBMPSSE_EMULATOR"
+
+/* Defaults of the members of EmuConfig that are 0 */
+#define EMU_DEFAULT_CHANNELS			2
+#define EMU_DEFAULT_PACKET_SIZE			512			/* high speed bulk endpoint */
+#define EMU_DEFAULT_USB_RATE			40000000	/* bytes per second */
+#define EMU_DEFAULT_TRANSFER_TIME		125000		/* ns, one microframe */
+
+/* Limits of the emulated chips */
+#define EMU_MAX_CHANNELS				16
+#define EMU_MAX_SLAVES					13			/* one on each of ADBUS3-7 & ACBUS0-7 */
+
+/* EmuSlave.csPin of ACBUS0, those of ACBUS1-ACBUS7 follow */
+#define EMU_CS_PIN_ACBUS0				8
+#define EMU_MAX_FIFO_PACKETS			64
+#define EMU_STATUS_BYTES				2			/* modem status bytes of each IN packet */
+#define EMU_LIBRARY_VERSION				0x00000500
+
+/* Size of the memory of the flash slave created by Emu_FlashSlave when 0 is given */
+#define EMU_FLASH_DEFAULT_SIZE			0x100000
+#define EMU_FLASH_PAGE_SIZE				256
+#define EMU_FLASH_SECTOR_SIZE			4096
+#define EMU_FLASH_BLOCK_SIZE			65536
+/* Number of status register reads for which WIP stays set after a program or an erase */
+#define EMU_FLASH_PROGRAM_POLLS			1
+#define EMU_FLASH_ERASE_POLLS			8
+
+/* Virtual time that the wait on I/O commands spend on each look at GPIOL1, and the number of
+looks after which the MPSSE is considered stalled until it is reset */
+#define EMU_WAIT_POLL_TIME				1000		/* ns */
+#define EMU_WAIT_MAX_POLLS				100000
+
+/* SPI NOR flash commands understood by the flash slave */
+#define EMU_FLASH_CMD_PAGE_PROGRAM		0x02
+#define EMU_FLASH_CMD_READ				0x03
+#define EMU_FLASH_CMD_WRITE_DISABLE		0x04
+#define EMU_FLASH_CMD_READ_STATUS		0x05
+#define EMU_FLASH_CMD_WRITE_ENABLE		0x06
+#define EMU_FLASH_CMD_FAST_READ			0x0B
+#define EMU_FLASH_CMD_SECTOR_ERASE		0x20
+#define EMU_FLASH_CMD_CHIP_ERASE		0xC7
+#define EMU_FLASH_CMD_CHIP_ERASE_ALT	0x60
+#define EMU_FLASH_CMD_BLOCK_ERASE		0xD8
+#define EMU_FLASH_CMD_READ_JEDEC_ID		0x9F
+#define EMU_FLASH_STATUS_WIP			0x01
+#define EMU_FLASH_STATUS_WEL			0x02
+#define EMU_FLASH_MANUFACTURER_ID		0xEF
+#define EMU_FLASH_MEMORY_TYPE			0x40
+
+
+/******************************************************************************/
+/*								Type defines								  */
+/******************************************************************************/
+
+/* Functions of a virtual SPI slave. Bits are passed in the order they are on the wire, the
+first one in bit 7, whatever the bit order of the MPSSE command. transfer returns the bits
+the slave drives on MISO for the noOfBits(1-8) bits of mosi, aligned in the same way. busy
+is asked for the level of GPIOL1(ADBUS5) while it is an input, the line is pulled high
+unless a slave returns TRUE */
+typedef void (*EMU_SLAVE_SELECT)(void *context, bool selected);
+typedef uint8 (*EMU_SLAVE_TRANSFER)(void *context, uint8 mosi, uint8 noOfBits);
+typedef void (*EMU_SLAVE_DESTROY)(void *context);
+typedef bool (*EMU_SLAVE_BUSY)(void *context);
+
+/* A virtual SPI slave attached to an emulated channel with Emu_AttachSlave */
+typedef struct EmuSlave_t
+{
+	uint8				csPin;		/* ADBUS pin(3-7) that selects the slave, 8-15 for ACBUS0-7 */
+	bool				csActiveLow;
+	EMU_SLAVE_SELECT	select;		/* called when the slave is selected or deselected, may be NULL */
+	EMU_SLAVE_TRANSFER	transfer;	/* called for the bits clocked while it is selected */
+	EMU_SLAVE_DESTROY	destroy;	/* called when the slave is detached, may be NULL */
+	EMU_SLAVE_BUSY		busy;		/* TRUE while the slave pulls GPIOL1 low, may be NULL */
+	void				*context;	/* passed to the functions */
+}EmuSlave;
+
+/* Chips emulated by Emu_Install. Members that are 0 take the EMU_DEFAULT_xxx value */
+typedef struct EmuConfig_t
+{
+	uint32	noOfChannels;		/* MPSSE channels listed by the emulated D2XX */
+	uint32	deviceType;			/* FT_DEVICE_2232H(default), FT_DEVICE_4232H or FT_DEVICE_232H */
+	uint32	usbPacketSize;		/* size of the bulk packets in bytes */
+	uint32	usbBytesPerSecond;	/* throughput of the bus */
+	uint32	usbTransferTime;	/* ns of overhead of each FT_Write and FT_Read */
+	uint32	fifoSize;			/* bytes, 0 = FIFO size of deviceType */
+}EmuConfig;
+
+/* Counters of an emulated channel, returned by Emu_GetStats. time is the virtual time
+that the traffic would have taken on the chip and bus that are modelled */
+typedef struct EmuStats_t
+{
+	uint64	time;				/* ns */
+	uint64	sckCycles;			/* clock cycles generated by the MPSSE */
+	uint64	bytesWritten;		/* bytes written by the host */
+	uint64	bytesRead;			/* bytes read by the host */
+	uint32	usbWrites;
+	uint32	usbReads;			/* reads that returned data */
+	uint32	outPackets;
+	uint32	inPackets;
+	uint32	latencyFlushes;		/* IN packets sent because the latency timer expired */
+	uint32	sendImmediates;		/* IN packets sent because of SEND_IMMEDIATE */
+	uint32	commands;			/* MPSSE commands executed */
+	uint32	badCommands;		/* commands answered with MID_BAD_COMMAND_RESPONSE */
+}EmuStats;
+
+
+/******************************************************************************/
+/*								Function declarations						  */
+/******************************************************************************/
+FT_STATUS Emu_InstallFunctions(const EmuConfig *config);
+void Emu_Cleanup(void);
+FTDI_API FT_STATUS Emu_Install(const EmuConfig *config);
+FTDI_API FT_STATUS Emu_Uninstall(void);
+FTDI_API FT_STATUS Emu_AttachSlave(uint32 index, const EmuSlave *slave);
+FTDI_API FT_STATUS Emu_GetStats(uint32 index, EmuStats *stats);
+FTDI_API FT_STATUS Emu_ResetStats(uint32 index);
+FTDI_API FT_STATUS Emu_LoopbackSlave(uint8 csPin, bool csActiveLow, EmuSlave *slave);
+FTDI_API FT_STATUS Emu_FlashSlave(uint8 csPin, bool csActiveLow, uint32 size,
+	EmuSlave *slave);
+
+#endif	/*FTDI_EMU_H*/
@@ -0,0 +1,1923 @@
+/*!
+ * \file ftdi_emu.c
+ *
+ * \author FTDI
+ * \date 20261015
+ *
+ * Copyright  2000-2014 Future Technology Devices International Limited
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Project: libMPSSE
+ * Module: Emulator
+ *
+ * The emulator is a D2XX that is built into the library. Emu_Install fills varFunctionPtrLst
+ * with the Emu_FT_xxx functions, so the rest of the library runs unchanged on emulated
+ * FT2232H, FT4232H or FT232H chips instead of real ones. The emulated MPSSE parses the
+ * command stream written to it, executes the data, GPIO, clock and wait on I/O commands,
+ * answers anything else with the bad command response, and clocks the data through the
+ * virtual SPI slaves that are attached to its chip selects(ADBUS3-ADBUS7 or ACBUS0-ACBUS7).
+ * GPIOL1(ADBUS5) is pulled high
+ * unless a slave says that it is busy.
+ *
+ * Each channel also keeps a virtual clock of the time the traffic would take on a real chip:
+ * - every FT_Write and FT_Read costs usbTransferTime, the data moves at usbBytesPerSecond in
+ *   packets of usbPacketSize bytes
+ * - a packet is accepted when the command FIFO(fifoSize) has room for it and is executed by
+ *   the MPSSE when it has arrived, at the SCLK period that the clock commands selected
+ * - the data for the host is sent in packets that carry EMU_STATUS_BYTES of modem status,
+ *   when the packet is full, when SEND_IMMEDIATE is executed, or else when the latency timer
+ *   expires
+ * The data itself is never delayed in real time, so tests run as fast as the host can parse.
+ *
+ * Rivision History:
+ * 0.5  - 20261015 - initial version
+ *				  emulated MPSSE_CMD_WAIT_ON_IO_HIGH & MPSSE_CMD_WAIT_ON_IO_LOW, GPIOL1 follows
+ *				  the busy function of the slaves, the flash slave is busy while WIP is set
+ *				  adaptive clocking commands are taken from ftdi_common.h
+ *				  slaves may be selected by the pins of the high byte
+ *				  each IN packet keeps its own ready time, a read waits only for the
+ *				  packet that holds the last byte returned
+ *				  clocks without data(0x8E/0x8F) take time and are counted in sckCycles
+ */
+
+
+/******************************************************************************/
+/*								Include files					  			  */
+/******************************************************************************/
+#include "ftdi_infra.h"		/*portable infrastructure(datatypes, libraries, etc)*/
+#include "ftdi_common.h"	/*MPSSE commands*/
+#include "ftdi_mid.h"		/*Middle layer*/
+#include "ftdi_emu.h"		/*Emulator specific*/
+
+
+/******************************************************************************/
+/*								Macro and type defines					  		  */
+/******************************************************************************/
+/*Comment the following line to disable parameter checking at the start of each function*/
+#define ENABLE_PARAMETER_CHECKING	1
+
+/* Clocks of the MPSSE, in MHz, with and without the divide by 5 */
+#define EMU_MASTER_CLOCK			60
+#define EMU_MASTER_CLOCK_DIV5		12
+
+/* Bits of a data command other than MPSSE_DATA_OUT_BIT & MPSSE_DATA_IN_BIT */
+#define EMU_DATA_BIT_MODE			0x02
+#define EMU_DATA_LSB_FIRST			0x08
+#define IS_EMU_DATA_CMD(opcode)		(((opcode) >= 0x10) && ((opcode) < 0x40))
+/* Pin of the low byte that the wait on I/O commands look at */
+#define EMU_GPIOL1					0x20
+
+/* ID reported by FT_GetDeviceInfo, vendor in the upper and product in the lower 16 bits */
+#define EMU_ID_FT2232H				0x04036010
+#define EMU_ID_FT4232H				0x04036011
+#define EMU_ID_FT232H				0x04036014
+
+/* Serial number and description of a channel, the port letter is added to those of chips
+that have more than one MPSSE */
+#define EMU_SERIAL_NUMBER			"EMU%03u"
+#define EMU_DESCRIPTION				"MPSSE Emulator"
+
+/* Returns the device of a handle, NULL if it is not an open emulated channel */
+#define EMU_DEVICE(handle)	((((EmuDevice*)(handle)) >= emuDevices) && \
+	(((EmuDevice*)(handle)) < &emuDevices[emuConfig.noOfChannels]) && \
+	((EmuDevice*)(handle))->opened ? (EmuDevice*)(handle) : NULL)
+
+/* State of a SPI NOR flash slave */
+typedef struct EmuFlash_t
+{
+	uint8	*memory;
+	uint32	size;
+	uint8	status;
+	uint32	busyPolls;		/* status reads for which WIP is still set */
+	uint8	opcode;			/* command of the current transaction */
+	uint32	address;
+	uint32	byteCount;		/* bytes received since the slave was selected */
+	uint8	inShift;		/* bits received of the current byte */
+	uint8	outShift;		/* byte being sent */
+	uint8	bitCount;		/* bits of the current byte clocked so far */
+}EmuFlash;
+
+/* An IN packet on its way to the host */
+typedef struct EmuPacket_t
+{
+	uint32	noOfBytes;		/* data bytes of the packet not read yet */
+	uint64	readyTime;		/* when the packet reaches the host */
+}EmuPacket;
+
+/* An emulated MPSSE channel */
+typedef struct EmuDevice_t
+{
+	InfraMutex	lock;
+	FT_DEVICE_LIST_INFO_NODE info;
+	bool		opened;
+	bool		mpsseEnabled;
+
+	/* MPSSE state */
+	uint8		lowValue;
+	uint8		lowDirection;
+	uint8		highValue;
+	uint8		highDirection;
+	bool		loopback;
+	bool		divideBy5;
+	bool		threePhase;
+	bool		adaptive;
+	uint16		divisor;
+	uint32		cyclePs;		/* length of a clock cycle in picoseconds */
+	uint8		dataOut;		/* level of the data out line, 0x00 or 0xFF */
+	bool		stalled;		/* a wait on I/O gave up, nothing runs until a reset */
+
+	/* Command parser */
+	uint8		cmd[3];			/* opcode and parameters of the current command */
+	uint32		cmdLength;		/* bytes of cmd received */
+	uint32		dataLeft;		/* data bytes of a byte mode write still to come */
+
+	/* Virtual slaves */
+	EmuSlave	slaves[EMU_MAX_SLAVES];
+	bool		selected[EMU_MAX_SLAVES];
+	uint32		noOfSlaves;
+
+	/* Data for the host */
+	uint8		*rxBuffer;
+	uint32		rxSize;
+	uint32		rxHead;
+	uint32		rxTail;
+	uint32		rxPending;		/* bytes in the chip that are not sent in a packet yet */
+	EmuPacket	*packets;		/* ring of the packets sent and not read yet */
+	uint32		packetsSize;
+	uint32		packetHead;
+	uint32		noOfQueuedPackets;
+	uint8		latencyTimer;
+	uint32		readTimeout;
+	DWORD		eventMask;
+	PVOID		eventParam;
+
+	/* Virtual clock, in ns */
+	uint64		now;			/* time seen by the host */
+	uint64		timeBase;		/* now when the statistics were reset */
+	uint64		chipTime;		/* when the MPSSE has executed what it received */
+	uint64		rxReadyTime;	/* when the last packet sent reaches the host */
+	uint64		producedTime;	/* when the last pending byte was produced */
+	uint64		fifoDone[EMU_MAX_FIFO_PACKETS];/* when each FIFO slot was emptied */
+	uint32		noOfPackets;	/* OUT packets received since the channel was opened */
+	EmuStats	stats;
+}EmuDevice;
+
+
+/******************************************************************************/
+/*								Local function declarations					  */
+/******************************************************************************/
+/* Emulated D2XX functions */
+FT_STATUS CAL_CONV Emu_FT_GetLibraryVersion(LPDWORD lpdwVersion);
+FT_STATUS CAL_CONV Emu_FT_CreateDeviceInfoList(LPDWORD lpdwNumDevs);
+FT_STATUS CAL_CONV Emu_FT_GetDeviceInfoList(FT_DEVICE_LIST_INFO_NODE *pDest,
+	LPDWORD lpdwNumDevs);
+FT_STATUS CAL_CONV Emu_FT_Open(int iDevice, FT_HANDLE *ftHandle);
+FT_STATUS CAL_CONV Emu_FT_OpenEx(PVOID pArg1, DWORD Flags, FT_HANDLE *ftHandle);
+FT_STATUS CAL_CONV Emu_FT_Close(FT_HANDLE ftHandle);
+FT_STATUS CAL_CONV Emu_FT_ResetDevice(FT_HANDLE ftHandle);
+FT_STATUS CAL_CONV Emu_FT_Purge(FT_HANDLE ftHandle, DWORD dwMask);
+FT_STATUS CAL_CONV Emu_FT_SetUSBParameters(FT_HANDLE ftHandle,
+	DWORD dwInTransferSize, DWORD dwOutTransferSize);
+FT_STATUS CAL_CONV Emu_FT_SetChars(FT_HANDLE ftHandle, UCHAR uEventCh,
+	UCHAR uEventChEn, UCHAR uErrorCh, UCHAR uErrorChEn);
+FT_STATUS CAL_CONV Emu_FT_SetTimeouts(FT_HANDLE ftHandle, DWORD dwReadTimeout,
+	DWORD dwWriteTimeout);
+FT_STATUS CAL_CONV Emu_FT_SetLatencyTimer(FT_HANDLE ftHandle, UCHAR ucTimer);
+FT_STATUS CAL_CONV Emu_FT_SetBitmode(FT_HANDLE ftHandle, UCHAR ucMask, UCHAR ucMode);
+FT_STATUS CAL_CONV Emu_FT_GetQueueStatus(FT_HANDLE ftHandle,
+	LPDWORD lpdwAmountInRxQueue);
+FT_STATUS CAL_CONV Emu_FT_Read(FT_HANDLE ftHandle, LPVOID lpBuffer,
+	DWORD dwBytesToRead, LPDWORD lpdwBytesReturned);
+FT_STATUS CAL_CONV Emu_FT_Write(FT_HANDLE ftHandle, LPVOID lpBuffer,
+	DWORD dwBytesToWrite, LPDWORD lpdwBytesWritten);
+FT_STATUS CAL_CONV Emu_FT_GetDeviceInfo(FT_HANDLE ftHandle, FT_DEVICE *lpftDevice,
+	LPDWORD lpdwID, PCHAR SerialNumber, PCHAR Description, LPVOID Dummy);
+FT_STATUS CAL_CONV Emu_FT_SetEventNotification(FT_HANDLE ftHandle,
+	DWORD dwEventMask, PVOID pvArg);
+/* MPSSE functions */
+void Emu_ResetMPSSE(EmuDevice *dev);
+void Emu_Execute(EmuDevice *dev, const uint8 *data, uint32 noOfBytes);
+uint32 Emu_CmdLength(uint8 opcode);
+void Emu_Command(EmuDevice *dev);
+void Emu_ClockBytes(EmuDevice *dev, uint8 opcode, const uint8 *data, uint32 noOfBytes);
+void Emu_ClockBits(EmuDevice *dev, uint8 opcode, uint8 data, uint8 noOfBits);
+uint8 Emu_Wire(EmuDevice *dev, uint8 mosi, uint8 noOfBits);
+void Emu_ClockIdle(EmuDevice *dev, uint32 noOfBits);
+void Emu_UpdateCycle(EmuDevice *dev);
+void Emu_UpdateSelects(EmuDevice *dev);
+uint8 Emu_LowPins(EmuDevice *dev);
+void Emu_WaitOnIO(EmuDevice *dev, bool level);
+uint8 Emu_Reverse(uint8 value);
+/* Functions that model the data sent to the host */
+void Emu_Produce(EmuDevice *dev, uint8 value);
+void Emu_SendPacket(EmuDevice *dev);
+void Emu_QueuePacket(EmuDevice *dev, uint32 noOfBytes);
+uint32 Emu_ArrivedBytes(EmuDevice *dev);
+uint64 Emu_ConsumePackets(EmuDevice *dev, uint32 noOfBytes);
+void Emu_LatencyFlush(EmuDevice *dev);
+void Emu_SignalEvent(EmuDevice *dev);
+/* Slave functions */
+void Emu_DetachSlaves(EmuDevice *dev);
+uint8 Emu_LoopbackTransfer(void *context, uint8 mosi, uint8 noOfBits);
+void Emu_FlashSelect(void *context, bool selected);
+uint8 Emu_FlashTransfer(void *context, uint8 mosi, uint8 noOfBits);
+void Emu_FlashDestroy(void *context);
+bool Emu_FlashBusy(void *context);
+uint8 Emu_FlashOutput(EmuFlash *flash);
+void Emu_FlashInput(EmuFlash *flash, uint8 value);
+
+
+/******************************************************************************/
+/*								Global variables							  */
+/******************************************************************************/
+EmuDevice *emuDevices = NULL;
+EmuConfig emuConfig;
+bool emuInstalled = FALSE;
+/* The function table that the emulator replaced, restored by Emu_Uninstall */
+InfraFunctionPtrLst emuSavedFunctionPtrLst;
+
+
+/******************************************************************************/
+/*						Global function definitions						  */
+/******************************************************************************/
+
+/*!
+ * \brief Installs the emulator into the function table
+ *
+ * This function creates the emulated channels and points varFunctionPtrLst at the emulated
+ * D2XX functions. It is called by Emu_Install, and by Init_libMPSSE before the other modules
+ * are initialized when the environment variable EMU_ENVIRONMENT_VARIABLE is set.
+ *
+ * \param[in] config Chips to emulate, NULL for the defaults
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_Install
+ * \note The channel list of the middle layer is not refreshed
+ * \warning
+ */
+FT_STATUS Emu_InstallFunctions(const EmuConfig *config)
+{
+	EmuConfig newConfig;
+	EmuDevice *devices;
+	uint32 i,ports,chip,port;
+	FN_ENTER;
+
+	memset(&newConfig,0,sizeof(newConfig));
+	if(NULL != config)
+		newConfig = *config;
+	if(0 == newConfig.noOfChannels)
+		newConfig.noOfChannels = EMU_DEFAULT_CHANNELS;
+	if(0 == newConfig.deviceType)
+		newConfig.deviceType = FT_DEVICE_2232H;
+	if(0 == newConfig.usbPacketSize)
+		newConfig.usbPacketSize = EMU_DEFAULT_PACKET_SIZE;
+	if(0 == newConfig.usbBytesPerSecond)
+		newConfig.usbBytesPerSecond = EMU_DEFAULT_USB_RATE;
+	if(0 == newConfig.usbTransferTime)
+		newConfig.usbTransferTime = EMU_DEFAULT_TRANSFER_TIME;
+	if(0 == newConfig.fifoSize)
+		newConfig.fifoSize = Mid_GetFifoSize(newConfig.deviceType);
+	if((newConfig.noOfChannels > EMU_MAX_CHANNELS) || \
+		(newConfig.usbPacketSize <= EMU_STATUS_BYTES) || \
+		(newConfig.fifoSize < newConfig.usbPacketSize) || \
+		((FT_DEVICE_2232H != newConfig.deviceType) && \
+		(FT_DEVICE_4232H != newConfig.deviceType) && \
+		(FT_DEVICE_232H != newConfig.deviceType)))
+	{
+		DBG(MSG_ERR,"invalid emulator configuration\n");
+		return FT_INVALID_PARAMETER;
+	}
+	if(emuInstalled)
+	{
+		for(i=0;i<emuConfig.noOfChannels;i++)
+		{
+			if(emuDevices[i].opened)
+			{
+				DBG(MSG_ERR,"emulated channel %u is open\n",(unsigned)i);
+				return FT_OTHER_ERROR;
+			}
+		}
+	}
+
+	devices = (EmuDevice*)INFRA_MALLOC(sizeof(EmuDevice)*newConfig.noOfChannels);
+	if(NULL == devices)
+	{
+		return FT_INSUFFICIENT_RESOURCES;
+	}
+	memset(devices,0,sizeof(EmuDevice)*newConfig.noOfChannels);
+	/* Only the MPSSE ports of the chips are listed, A and B of a FT2232H or FT4232H */
+	ports = (FT_DEVICE_232H == newConfig.deviceType)?1:2;
+	for(i=0;i<newConfig.noOfChannels;i++)
+	{
+		chip = i/ports;
+		port = i%ports;
+		INFRA_MUTEX_INIT(&devices[i].lock);
+		devices[i].info.Type = newConfig.deviceType;
+		devices[i].info.ID = (FT_DEVICE_2232H == newConfig.deviceType)?EMU_ID_FT2232H:\
+			(FT_DEVICE_4232H == newConfig.deviceType)?EMU_ID_FT4232H:EMU_ID_FT232H;
+		devices[i].info.LocId = ((chip+1)<<4) | (port+1);
+		sprintf(devices[i].info.SerialNumber,EMU_SERIAL_NUMBER,(unsigned)chip);
+		strcpy(devices[i].info.Description,EMU_DESCRIPTION);
+		if(ports > 1)
+		{
+			sprintf(&devices[i].info.SerialNumber[strlen(devices[i].info.SerialNumber)],\
+				"%c",(char)('A'+port));
+			sprintf(&devices[i].info.Description[strlen(devices[i].info.Description)],\
+				" %c",(char)('A'+port));
+		}
+		devices[i].latencyTimer = 16;
+		Emu_ResetMPSSE(&devices[i]);
+	}
+
+	if(emuInstalled)
+	{
+		Emu_Cleanup();
+	}
+	else
+	{
+		emuSavedFunctionPtrLst = varFunctionPtrLst;
+	}
+	emuDevices = devices;
+	emuConfig = newConfig;
+	emuInstalled = TRUE;
+
+	varFunctionPtrLst.p_FT_GetLibraryVersion = Emu_FT_GetLibraryVersion;
+	varFunctionPtrLst.p_FT_GetNumChannel = Emu_FT_CreateDeviceInfoList;
+	varFunctionPtrLst.p_FT_GetDeviceInfoList = Emu_FT_GetDeviceInfoList;
+	varFunctionPtrLst.p_FT_Open = Emu_FT_Open;
+	varFunctionPtrLst.p_FT_OpenEx = Emu_FT_OpenEx;
+	varFunctionPtrLst.p_FT_Close = Emu_FT_Close;
+	varFunctionPtrLst.p_FT_ResetDevice = Emu_FT_ResetDevice;
+	varFunctionPtrLst.p_FT_Purge = Emu_FT_Purge;
+	varFunctionPtrLst.p_FT_SetUSBParameters = Emu_FT_SetUSBParameters;
+	varFunctionPtrLst.p_FT_SetChars = Emu_FT_SetChars;
+	varFunctionPtrLst.p_FT_SetTimeouts = Emu_FT_SetTimeouts;
+	varFunctionPtrLst.p_FT_SetLatencyTimer = Emu_FT_SetLatencyTimer;
+	varFunctionPtrLst.p_FT_SetBitmode = Emu_FT_SetBitmode;
+	varFunctionPtrLst.p_FT_GetQueueStatus = Emu_FT_GetQueueStatus;
+	varFunctionPtrLst.p_FT_Read = Emu_FT_Read;
+	varFunctionPtrLst.p_FT_Write = Emu_FT_Write;
+	varFunctionPtrLst.p_FT_GetDeviceInfo = Emu_FT_GetDeviceInfo;
+	varFunctionPtrLst.p_FT_SetEventNotification = Emu_FT_SetEventNotification;
+	DBG(MSG_INFO,"emulating %u channels\n",(unsigned)emuConfig.noOfChannels);
+	FN_EXIT;
+	return FT_OK;
+}
+
+/*!
+ * \brief Frees the emulated channels
+ *
+ * This function detaches the slaves of the emulated channels and frees them. It is called
+ * by Cleanup_libMPSSE, the function table is left as it is
+ *
+ * \param[in] none
+ * \return none
+ * \sa Emu_Uninstall
+ * \note
+ * \warning
+ */
+void Emu_Cleanup(void)
+{
+	uint32 i;
+	FN_ENTER;
+	if(NULL != emuDevices)
+	{
+		for(i=0;i<emuConfig.noOfChannels;i++)
+		{
+			Emu_DetachSlaves(&emuDevices[i]);
+			if(NULL != emuDevices[i].rxBuffer)
+			{
+				INFRA_FREE(emuDevices[i].rxBuffer);
+			}
+			if(NULL != emuDevices[i].packets)
+			{
+				INFRA_FREE(emuDevices[i].packets);
+			}
+			INFRA_MUTEX_DESTROY(&emuDevices[i].lock);
+		}
+		INFRA_FREE(emuDevices);
+		emuDevices = NULL;
+	}
+	FN_EXIT;
+}
+
+
+/******************************************************************************/
+/*						Public function definitions						  		   */
+/******************************************************************************/
+
+/*!
+ * \brief Replaces D2XX with emulated chips
+ *
+ * This function makes the library use emulated chips instead of the D2XX driver, so that it
+ * can be tested and benchmarked on machines without FTDI hardware. The emulated channels are
+ * listed by SPI_GetNumChannels & SPI_GetChannelInfo and opened as usual. Calling it again
+ * replaces the emulated chips with new ones.
+ *
+ * \param[in] config Chips to emulate, NULL for EMU_DEFAULT_CHANNELS FT2232H channels
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_Uninstall, Emu_AttachSlave, Emu_GetStats
+ * \note The library can also be made to start with the emulator by setting the environment
+ * variable LIBMPSSE_EMULATOR(EMU_ENVIRONMENT_VARIABLE), in which case D2XX is not loaded at all
+ * \warning Channels opened through D2XX must be closed first. FT_OTHER_ERROR is returned if an
+ * emulated channel is open
+ */
+FTDI_API FT_STATUS Emu_Install(const EmuConfig *config)
+{
+	FT_STATUS status;
+	FN_ENTER;
+	status = Emu_InstallFunctions(config);
+	CHECK_STATUS(status);
+	status = FT_RefreshChannelList(SPI);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Goes back to D2XX
+ *
+ * This function restores the D2XX functions that Emu_Install replaced and frees the emulated
+ * chips with their slaves
+ *
+ * \param[in] none
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_Install
+ * \note FT_NOT_SUPPORTED is returned if the emulator was installed because of
+ * EMU_ENVIRONMENT_VARIABLE, as D2XX was never loaded
+ * \warning FT_OTHER_ERROR is returned if an emulated channel is open
+ */
+FTDI_API FT_STATUS Emu_Uninstall(void)
+{
+	FT_STATUS status;
+	uint32 i;
+	FN_ENTER;
+	if(!emuInstalled || (NULL == emuSavedFunctionPtrLst.p_FT_Open))
+	{
+		return FT_NOT_SUPPORTED;
+	}
+	for(i=0;i<emuConfig.noOfChannels;i++)
+	{
+		if(emuDevices[i].opened)
+		{
+			DBG(MSG_ERR,"emulated channel %u is open\n",(unsigned)i);
+			return FT_OTHER_ERROR;
+		}
+	}
+	varFunctionPtrLst = emuSavedFunctionPtrLst;
+	emuInstalled = FALSE;
+	Emu_Cleanup();
+	status = FT_RefreshChannelList(SPI);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Attaches a virtual SPI slave to an emulated channel
+ *
+ * This function connects a slave to the ADBUS or ACBUS pin given by its csPin member. The
+ * slave sees the bits clocked by the MPSSE while its chip select is asserted, and what it
+ * drives on MISO is clocked in. If several slaves are selected the MISO line is the AND of
+ * their outputs, if none is it reads high.
+ *
+ * \param[in] index Index of the emulated channel(0 based)
+ * \param[in] slave Slave to attach, copied. If its transfer member is NULL the slave attached
+ *			to csPin is detached instead
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_LoopbackSlave, Emu_FlashSlave
+ * \note The slaves do not look at the clock edges, they behave as if they used the SPI mode
+ * of the commands. The MPSSE loopback(MID_TURN_ON_LOOPBACK_CMD) overrides MISO
+ * \warning The slave that was attached to csPin, if any, is destroyed. FT_INVALID_PARAMETER is
+ * returned if a different slave is already attached to the pin
+ */
+FTDI_API FT_STATUS Emu_AttachSlave(uint32 index, const EmuSlave *slave)
+{
+	FT_STATUS status=FT_OK;
+	EmuDevice *dev;
+	uint32 i;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(slave);
+#endif
+	if(!emuInstalled || (index >= emuConfig.noOfChannels))
+	{
+		return FT_INVALID_PARAMETER;
+	}
+	if((slave->csPin < 3) || (slave->csPin >= EMU_CS_PIN_ACBUS0+8))
+	{
+		return FT_INVALID_PARAMETER;
+	}
+	dev = &emuDevices[index];
+	INFRA_MUTEX_LOCK(&dev->lock);
+	for(i=0;(i<dev->noOfSlaves) && (dev->slaves[i].csPin != slave->csPin);i++);
+	if(i < dev->noOfSlaves)
+	{/* Detach the slave of the pin */
+		if(NULL != dev->slaves[i].destroy)
+			dev->slaves[i].destroy(dev->slaves[i].context);
+		dev->noOfSlaves--;
+		dev->slaves[i] = dev->slaves[dev->noOfSlaves];
+		dev->selected[i] = dev->selected[dev->noOfSlaves];
+	}
+	if(NULL != slave->transfer)
+	{
+		i = dev->noOfSlaves++;
+		dev->slaves[i] = *slave;
+		dev->selected[i] = FALSE;
+		Emu_UpdateSelects(dev);
+	}
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Gets the counters of an emulated channel
+ *
+ * This function returns the traffic of an emulated channel since it was created or
+ * Emu_ResetStats was called, with the virtual time that it would have taken on the chip and
+ * bus that are modelled. Unlike the wall clock time, the virtual time does not depend on the
+ * machine running the emulator, so it can be compared across runs to find regressions in the
+ * efficiency of the command stream.
+ *
+ * \param[in] index Index of the emulated channel(0 based)
+ * \param[out] stats Counters of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_ResetStats, SPI_GetStats
+ * \note
+ * \warning
+ */
+FTDI_API FT_STATUS Emu_GetStats(uint32 index, EmuStats *stats)
+{
+	FT_STATUS status=FT_OK;
+	EmuDevice *dev;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(stats);
+#endif
+	if(!emuInstalled || (index >= emuConfig.noOfChannels))
+	{
+		return FT_INVALID_PARAMETER;
+	}
+	dev = &emuDevices[index];
+	INFRA_MUTEX_LOCK(&dev->lock);
+	*stats = dev->stats;
+	stats->time = dev->now - dev->timeBase;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Clears the counters of an emulated channel
+ *
+ * \param[in] index Index of the emulated channel(0 based)
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_GetStats
+ * \note The virtual time of the channel keeps running, Emu_GetStats reports the time
+ * elapsed since this call
+ * \warning
+ */
+FTDI_API FT_STATUS Emu_ResetStats(uint32 index)
+{
+	EmuDevice *dev;
+	FN_ENTER;
+	if(!emuInstalled || (index >= emuConfig.noOfChannels))
+	{
+		return FT_INVALID_PARAMETER;
+	}
+	dev = &emuDevices[index];
+	INFRA_MUTEX_LOCK(&dev->lock);
+	memset(&dev->stats,0,sizeof(dev->stats));
+	dev->timeBase = dev->now;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	FN_EXIT;
+	return FT_OK;
+}
+
+/*!
+ * \brief Describes a loopback slave
+ *
+ * This function fills a slave that drives MISO with the bits it receives on MOSI, as if the
+ * two lines were wired together while csPin is asserted
+ *
+ * \param[in] csPin ADBUS pin(3-7) that selects the slave, 8-15 for ACBUS0-ACBUS7
+ * \param[in] csActiveLow TRUE if the slave is selected when csPin is low
+ * \param[out] slave Slave to be passed to Emu_AttachSlave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_AttachSlave
+ * \note
+ * \warning
+ */
+FTDI_API FT_STATUS Emu_LoopbackSlave(uint8 csPin, bool csActiveLow, EmuSlave *slave)
+{
+	FT_STATUS status=FT_OK;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(slave);
+#endif
+	memset(slave,0,sizeof(*slave));
+	slave->csPin = csPin;
+	slave->csActiveLow = csActiveLow;
+	slave->transfer = Emu_LoopbackTransfer;
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Creates a SPI NOR flash slave
+ *
+ * This function creates a slave that behaves like a 25 series SPI NOR flash of the given
+ * size. It understands read(0x03), fast read(0x0B), page program(0x02), sector(0x20),
+ * block(0xD8) & chip(0xC7/0x60) erase, write enable/disable(0x06/0x04), read status(0x05) and
+ * read JEDEC ID(0x9F). Programs and erases keep the WIP bit of the status register set for
+ * EMU_FLASH_PROGRAM_POLLS and EMU_FLASH_ERASE_POLLS status reads, or looks at GPIOL1, which
+ * the flash pulls low while WIP is set. The memory starts erased.
+ *
+ * \param[in] csPin ADBUS pin(3-7) that selects the slave, 8-15 for ACBUS0-ACBUS7
+ * \param[in] csActiveLow TRUE if the slave is selected when csPin is low
+ * \param[in] size Size of the memory in bytes, a power of 2 of at least EMU_FLASH_BLOCK_SIZE.
+ *			0 selects EMU_FLASH_DEFAULT_SIZE
+ * \param[out] slave Slave to be passed to Emu_AttachSlave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Emu_AttachSlave
+ * \note The memory is freed when the slave is detached, or by slave->destroy if it is never
+ * attached
+ * \warning
+ */
+FTDI_API FT_STATUS Emu_FlashSlave(uint8 csPin, bool csActiveLow, uint32 size,
+	EmuSlave *slave)
+{
+	FT_STATUS status=FT_OK;
+	EmuFlash *flash;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(slave);
+#endif
+	if(0 == size)
+		size = EMU_FLASH_DEFAULT_SIZE;
+	if((size < EMU_FLASH_BLOCK_SIZE) || (size & (size-1)))
+	{
+		return FT_INVALID_PARAMETER;
+	}
+	flash = (EmuFlash*)INFRA_MALLOC(sizeof(EmuFlash));
+	if(NULL == flash)
+	{
+		return FT_INSUFFICIENT_RESOURCES;
+	}
+	memset(flash,0,sizeof(*flash));
+	flash->memory = (uint8*)INFRA_MALLOC(size);
+	if(NULL == flash->memory)
+	{
+		INFRA_FREE(flash);
+		return FT_INSUFFICIENT_RESOURCES;
+	}
+	memset(flash->memory,0xFF,size);
+	flash->size = size;
+
+	memset(slave,0,sizeof(*slave));
+	slave->csPin = csPin;
+	slave->csActiveLow = csActiveLow;
+	slave->select = Emu_FlashSelect;
+	slave->transfer = Emu_FlashTransfer;
+	slave->destroy = Emu_FlashDestroy;
+	slave->busy = Emu_FlashBusy;
+	slave->context = flash;
+	FN_EXIT;
+	return status;
+}
+
+
+/******************************************************************************/
+/*						Local function definitions						  		   */
+/******************************************************************************/
+
+/*!
+ * \brief Emulated FT_GetLibraryVersion
+ */
+FT_STATUS CAL_CONV Emu_FT_GetLibraryVersion(LPDWORD lpdwVersion)
+{
+	*lpdwVersion = EMU_LIBRARY_VERSION;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_CreateDeviceInfoList
+ */
+FT_STATUS CAL_CONV Emu_FT_CreateDeviceInfoList(LPDWORD lpdwNumDevs)
+{
+	*lpdwNumDevs = emuConfig.noOfChannels;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_GetDeviceInfoList
+ */
+FT_STATUS CAL_CONV Emu_FT_GetDeviceInfoList(FT_DEVICE_LIST_INFO_NODE *pDest,
+	LPDWORD lpdwNumDevs)
+{
+	uint32 i;
+
+	for(i=0;i<emuConfig.noOfChannels;i++)
+	{
+		pDest[i] = emuDevices[i].info;
+		pDest[i].Flags = FT_FLAGS_HISPEED | (emuDevices[i].opened?FT_FLAGS_OPENED:0);
+		pDest[i].ftHandle = emuDevices[i].opened?(FT_HANDLE)&emuDevices[i]:NULL;
+	}
+	*lpdwNumDevs = emuConfig.noOfChannels;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_Open
+ */
+FT_STATUS CAL_CONV Emu_FT_Open(int iDevice, FT_HANDLE *ftHandle)
+{
+	EmuDevice *dev;
+
+	if((iDevice < 0) || ((uint32)iDevice >= emuConfig.noOfChannels))
+	{
+		return FT_DEVICE_NOT_FOUND;
+	}
+	dev = &emuDevices[iDevice];
+	INFRA_MUTEX_LOCK(&dev->lock);
+	if(dev->opened)
+	{
+		INFRA_MUTEX_UNLOCK(&dev->lock);
+		return FT_DEVICE_NOT_OPENED;
+	}
+	dev->opened = TRUE;
+	dev->mpsseEnabled = FALSE;
+	dev->eventMask = 0;
+	dev->eventParam = NULL;
+	dev->rxHead = dev->rxTail = dev->rxPending = 0;
+	dev->noOfQueuedPackets = 0;
+	Emu_ResetMPSSE(dev);
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	*ftHandle = (FT_HANDLE)dev;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_OpenEx
+ */
+FT_STATUS CAL_CONV Emu_FT_OpenEx(PVOID pArg1, DWORD Flags, FT_HANDLE *ftHandle)
+{
+	uint32 i;
+
+	for(i=0;i<emuConfig.noOfChannels;i++)
+	{
+		if(((FT_OPEN_BY_SERIAL_NUMBER == Flags) && \
+			(0 == strcmp((char*)pArg1,emuDevices[i].info.SerialNumber))) || \
+			((FT_OPEN_BY_DESCRIPTION == Flags) && \
+			(0 == strcmp((char*)pArg1,emuDevices[i].info.Description))) || \
+			((FT_OPEN_BY_LOCATION == Flags) && \
+			((DWORD)(size_t)pArg1 == emuDevices[i].info.LocId)))
+		{
+			return Emu_FT_Open((int)i,ftHandle);
+		}
+	}
+	return FT_DEVICE_NOT_FOUND;
+}
+
+/*!
+ * \brief Emulated FT_Close
+ */
+FT_STATUS CAL_CONV Emu_FT_Close(FT_HANDLE ftHandle)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	dev->opened = FALSE;
+	dev->eventParam = NULL;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_ResetDevice
+ */
+FT_STATUS CAL_CONV Emu_FT_ResetDevice(FT_HANDLE ftHandle)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	dev->mpsseEnabled = FALSE;
+	dev->rxHead = dev->rxTail = dev->rxPending = 0;
+	dev->noOfQueuedPackets = 0;
+	Emu_ResetMPSSE(dev);
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_Purge
+ */
+FT_STATUS CAL_CONV Emu_FT_Purge(FT_HANDLE ftHandle, DWORD dwMask)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	if(dwMask & FT_PURGE_RX)
+	{
+		dev->rxHead = dev->rxTail = dev->rxPending = 0;
+		dev->noOfQueuedPackets = 0;
+	}
+	if(dwMask & FT_PURGE_TX)
+	{
+		dev->cmdLength = 0;
+		dev->dataLeft = 0;
+	}
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetUSBParameters, the transfer sizes are not modelled
+ */
+FT_STATUS CAL_CONV Emu_FT_SetUSBParameters(FT_HANDLE ftHandle,
+	DWORD dwInTransferSize, DWORD dwOutTransferSize)
+{
+	return (NULL == EMU_DEVICE(ftHandle))?FT_INVALID_HANDLE:FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetChars, the event and error characters are not modelled
+ */
+FT_STATUS CAL_CONV Emu_FT_SetChars(FT_HANDLE ftHandle, UCHAR uEventCh,
+	UCHAR uEventChEn, UCHAR uErrorCh, UCHAR uErrorChEn)
+{
+	return (NULL == EMU_DEVICE(ftHandle))?FT_INVALID_HANDLE:FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetTimeouts
+ */
+FT_STATUS CAL_CONV Emu_FT_SetTimeouts(FT_HANDLE ftHandle, DWORD dwReadTimeout,
+	DWORD dwWriteTimeout)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	dev->readTimeout = dwReadTimeout;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetLatencyTimer
+ */
+FT_STATUS CAL_CONV Emu_FT_SetLatencyTimer(FT_HANDLE ftHandle, UCHAR ucTimer)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	dev->latencyTimer = ucTimer;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetBitMode, only FT_BITMODE_MPSSE enables the MPSSE
+ */
+FT_STATUS CAL_CONV Emu_FT_SetBitmode(FT_HANDLE ftHandle, UCHAR ucMask, UCHAR ucMode)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	dev->mpsseEnabled = (FT_BITMODE_MPSSE == ucMode)?TRUE:FALSE;
+	Emu_ResetMPSSE(dev);
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_GetQueueStatus
+ *
+ * Data that the chip still holds is reported as if the latency timer had expired. Only the
+ * packets that have reached the host are counted, if none has the host waits for the first
+ */
+FT_STATUS CAL_CONV Emu_FT_GetQueueStatus(FT_HANDLE ftHandle,
+	LPDWORD lpdwAmountInRxQueue)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	Emu_LatencyFlush(dev);
+	*lpdwAmountInRxQueue = Emu_ArrivedBytes(dev);
+	if((0 == *lpdwAmountInRxQueue) && (dev->rxTail != dev->rxHead))
+	{
+		dev->now = Emu_ConsumePackets(dev,0);
+		*lpdwAmountInRxQueue = Emu_ArrivedBytes(dev);
+	}
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_Read
+ *
+ * Returns at once with what is available. The virtual time advances to when the packet that
+ * holds the last byte returned reaches the host, packets behind it are still in flight. The
+ * read timeout is only added to the virtual time when less data than asked for is returned
+ */
+FT_STATUS CAL_CONV Emu_FT_Read(FT_HANDLE ftHandle, LPVOID lpBuffer,
+	DWORD dwBytesToRead, LPDWORD lpdwBytesReturned)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+	uint32 noOfBytes;
+	uint64 readyTime;
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	Emu_LatencyFlush(dev);
+	noOfBytes = dev->rxTail - dev->rxHead;
+	if(noOfBytes > dwBytesToRead)
+		noOfBytes = dwBytesToRead;
+	memcpy(lpBuffer,&dev->rxBuffer[dev->rxHead],noOfBytes);
+	dev->rxHead += noOfBytes;
+	if(dev->rxHead == dev->rxTail)
+		dev->rxHead = dev->rxTail = 0;
+
+	readyTime = Emu_ConsumePackets(dev,noOfBytes);
+	if(dev->now < readyTime)
+		dev->now = readyTime;
+	dev->now += emuConfig.usbTransferTime;
+	if(noOfBytes < dwBytesToRead)
+		dev->now += (uint64)dev->readTimeout*1000000;
+	if(noOfBytes > 0)
+		dev->stats.usbReads++;
+	dev->stats.bytesRead += noOfBytes;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	*lpdwBytesReturned = noOfBytes;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_Write
+ *
+ * The data is split into packets. Each packet waits for a free slot of the command FIFO, is
+ * moved at the speed of the bus, and is executed by the MPSSE once it has arrived
+ */
+FT_STATUS CAL_CONV Emu_FT_Write(FT_HANDLE ftHandle, LPVOID lpBuffer,
+	DWORD dwBytesToWrite, LPDWORD lpdwBytesWritten)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+	uint8 *data = (uint8*)lpBuffer;
+	uint32 offset,size,noOfFifoPackets;
+	uint64 *slot;
+	bool received;
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	noOfFifoPackets = emuConfig.fifoSize/emuConfig.usbPacketSize;
+	if(noOfFifoPackets > EMU_MAX_FIFO_PACKETS)
+		noOfFifoPackets = EMU_MAX_FIFO_PACKETS;
+
+	INFRA_MUTEX_LOCK(&dev->lock);
+	dev->now += emuConfig.usbTransferTime;
+	for(offset=0;offset<dwBytesToWrite;offset+=size)
+	{
+		size = dwBytesToWrite - offset;
+		if(size > emuConfig.usbPacketSize)
+			size = emuConfig.usbPacketSize;
+		slot = &dev->fifoDone[dev->noOfPackets % noOfFifoPackets];
+		if(dev->now < *slot)
+			dev->now = *slot;
+		dev->now += (uint64)size*1000000000/emuConfig.usbBytesPerSecond;
+		if(dev->mpsseEnabled)
+		{
+			if(dev->chipTime < dev->now)
+				dev->chipTime = dev->now;
+			Emu_Execute(dev,&data[offset],size);
+		}
+		*slot = dev->chipTime;
+		dev->noOfPackets++;
+		dev->stats.outPackets++;
+	}
+	dev->stats.usbWrites++;
+	dev->stats.bytesWritten += dwBytesToWrite;
+	received = (dev->rxTail != dev->rxHead)?TRUE:FALSE;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	if(received)
+		Emu_SignalEvent(dev);
+	*lpdwBytesWritten = dwBytesToWrite;
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_GetDeviceInfo
+ */
+FT_STATUS CAL_CONV Emu_FT_GetDeviceInfo(FT_HANDLE ftHandle, FT_DEVICE *lpftDevice,
+	LPDWORD lpdwID, PCHAR SerialNumber, PCHAR Description, LPVOID Dummy)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	if(NULL != lpftDevice)
+		*lpftDevice = dev->info.Type;
+	if(NULL != lpdwID)
+		*lpdwID = dev->info.ID;
+	if(NULL != SerialNumber)
+		strcpy(SerialNumber,dev->info.SerialNumber);
+	if(NULL != Description)
+		strcpy(Description,dev->info.Description);
+	return FT_OK;
+}
+
+/*!
+ * \brief Emulated FT_SetEventNotification, only FT_EVENT_RXCHAR is signalled
+ */
+FT_STATUS CAL_CONV Emu_FT_SetEventNotification(FT_HANDLE ftHandle,
+	DWORD dwEventMask, PVOID pvArg)
+{
+	EmuDevice *dev = EMU_DEVICE(ftHandle);
+
+	if(NULL == dev)
+	{
+		return FT_INVALID_HANDLE;
+	}
+	INFRA_MUTEX_LOCK(&dev->lock);
+	dev->eventMask = dwEventMask;
+	dev->eventParam = pvArg;
+	INFRA_MUTEX_UNLOCK(&dev->lock);
+	return FT_OK;
+}
+
+/*!
+ * \brief Puts the MPSSE of a channel in its reset state
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ * \note Attached slaves are deselected and a stalled MPSSE runs again
+ */
+void Emu_ResetMPSSE(EmuDevice *dev)
+{
+	dev->lowValue = dev->lowDirection = 0;
+	dev->highValue = dev->highDirection = 0;
+	dev->loopback = FALSE;
+	dev->divideBy5 = TRUE;
+	dev->threePhase = FALSE;
+	dev->adaptive = FALSE;
+	dev->divisor = 0;
+	dev->dataOut = 0;
+	dev->stalled = FALSE;
+	dev->cmdLength = 0;
+	dev->dataLeft = 0;
+	Emu_UpdateCycle(dev);
+	Emu_UpdateSelects(dev);
+}
+
+/*!
+ * \brief Parses and executes a part of the command stream
+ *
+ * A command may be split across calls, the parser keeps its state in the channel. A stalled
+ * MPSSE drops what it receives
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] data Bytes received by the MPSSE
+ * \param[in] noOfBytes Number of bytes in data
+ * \return none
+ */
+void Emu_Execute(EmuDevice *dev, const uint8 *data, uint32 noOfBytes)
+{
+	uint32 i=0,n;
+
+	while((i < noOfBytes) && !dev->stalled)
+	{
+		if(dev->dataLeft > 0)
+		{/* Data of a byte mode command */
+			n = noOfBytes - i;
+			if(n > dev->dataLeft)
+				n = dev->dataLeft;
+			Emu_ClockBytes(dev,dev->cmd[0],&data[i],n);
+			dev->dataLeft -= n;
+			i += n;
+			continue;
+		}
+		dev->cmd[dev->cmdLength++] = data[i++];
+		if(dev->cmdLength == Emu_CmdLength(dev->cmd[0]))
+		{
+			Emu_Command(dev);
+			dev->cmdLength = 0;
+		}
+	}
+}
+
+/*!
+ * \brief Returns the length of a command, without the data of byte mode commands
+ *
+ * \param[in] opcode First byte of the command
+ * \return Number of bytes
+ */
+uint32 Emu_CmdLength(uint8 opcode)
+{
+	uint32 length;
+
+	if(IS_EMU_DATA_CMD(opcode))
+	{
+		if(opcode & EMU_DATA_BIT_MODE)
+			length = (opcode & MPSSE_DATA_OUT_BIT)?3:2;
+		else
+			length = 3;
+		return length;
+	}
+	switch(opcode)
+	{
+		case MPSSE_CMD_SET_DATA_BITS_LOWBYTE:
+		case MPSSE_CMD_SET_DATA_BITS_HIGHBYTE:
+		case MID_SET_CLOCK_FREQUENCY_CMD:
+		case MPSSE_CMD_CLOCK_N_BYTES:
+		case MPSSE_CMD_ENABLE_DRIVE_ONLY_ZERO:
+			length = 3;
+			break;
+		case MPSSE_CMD_CLOCK_N_BITS:
+			length = 2;
+			break;
+		default:
+			length = 1;
+	}
+	return length;
+}
+
+/*!
+ * \brief Executes the command that has been received
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ */
+void Emu_Command(EmuDevice *dev)
+{
+	uint8 opcode = dev->cmd[0];
+	uint32 length;
+
+	dev->stats.commands++;
+	if(IS_EMU_DATA_CMD(opcode))
+	{
+		if(opcode & EMU_DATA_BIT_MODE)
+		{
+			Emu_ClockBits(dev,opcode,(opcode & MPSSE_DATA_OUT_BIT)?dev->cmd[2]:0,\
+				(uint8)(dev->cmd[1]+1));
+		}
+		else
+		{
+			length = ((uint32)dev->cmd[1] | ((uint32)dev->cmd[2]<<8)) + 1;
+			if(opcode & MPSSE_DATA_OUT_BIT)
+				dev->dataLeft = length;/* the data follows */
+			else
+				Emu_ClockBytes(dev,opcode,NULL,length);
+		}
+		return;
+	}
+
+	switch(opcode)
+	{
+		case MPSSE_CMD_SET_DATA_BITS_LOWBYTE:
+			dev->lowValue = dev->cmd[1];
+			dev->lowDirection = dev->cmd[2];
+			Emu_UpdateSelects(dev);
+			break;
+		case MPSSE_CMD_SET_DATA_BITS_HIGHBYTE:
+			dev->highValue = dev->cmd[1];
+			dev->highDirection = dev->cmd[2];
+			Emu_UpdateSelects(dev);
+			break;
+		case MPSSE_CMD_GET_DATA_BITS_LOWBYTE:
+			Emu_Produce(dev,Emu_LowPins(dev));
+			break;
+		case MPSSE_CMD_GET_DATA_BITS_HIGHBYTE:
+			Emu_Produce(dev,(uint8)((dev->highValue & dev->highDirection) | \
+				~dev->highDirection));
+			break;
+		case MID_TURN_ON_LOOPBACK_CMD:
+			dev->loopback = TRUE;
+			break;
+		case MID_TURN_OFF_LOOPBACK_CMD:
+			dev->loopback = FALSE;
+			break;
+		case MID_SET_CLOCK_FREQUENCY_CMD:
+			dev->divisor = (uint16)(dev->cmd[1] | (dev->cmd[2]<<8));
+			Emu_UpdateCycle(dev);
+			break;
+		case MPSSE_CMD_SEND_IMMEDIATE:
+			if(dev->rxPending > 0)
+			{
+				dev->stats.sendImmediates++;
+				Emu_SendPacket(dev);
+			}
+			break;
+		case DISABLE_CLOCK_DIVIDE:
+			dev->divideBy5 = FALSE;
+			Emu_UpdateCycle(dev);
+			break;
+		case ENABLE_CLOCK_DIVIDE:
+			dev->divideBy5 = TRUE;
+			Emu_UpdateCycle(dev);
+			break;
+		case MPSSE_CMD_ENABLE_3PHASE_CLOCKING:
+			dev->threePhase = TRUE;
+			Emu_UpdateCycle(dev);
+			break;
+		case MPSSE_CMD_DISABLE_3PHASE_CLOCKING:
+			dev->threePhase = FALSE;
+			Emu_UpdateCycle(dev);
+			break;
+		case MPSSE_CMD_CLOCK_N_BITS:
+			Emu_ClockIdle(dev,(uint32)dev->cmd[1]+1);
+			break;
+		case MPSSE_CMD_CLOCK_N_BYTES:
+			Emu_ClockIdle(dev,(((uint32)dev->cmd[1] | ((uint32)dev->cmd[2]<<8))+1)*8);
+			break;
+		case MPSSE_CMD_ENABLE_ADAPTIVE_CLOCKING:
+			dev->adaptive = TRUE;
+			break;
+		case MPSSE_CMD_DISABLE_ADAPTIVE_CLOCKING:
+			dev->adaptive = FALSE;
+			break;
+		case MPSSE_CMD_ENABLE_DRIVE_ONLY_ZERO:
+			break;
+		case MPSSE_CMD_WAIT_ON_IO_HIGH:
+			Emu_WaitOnIO(dev,TRUE);
+			break;
+		case MPSSE_CMD_WAIT_ON_IO_LOW:
+			Emu_WaitOnIO(dev,FALSE);
+			break;
+		default:
+			DBG(MSG_DEBUG,"bad command 0x%x\n",(unsigned)opcode);
+			dev->stats.badCommands++;
+			Emu_Produce(dev,MID_BAD_COMMAND_RESPONSE);
+			Emu_Produce(dev,opcode);
+	}
+}
+
+/*!
+ * \brief Clocks the bytes of a byte mode data command
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] opcode Data command
+ * \param[in] data Bytes to clock out, NULL if the command does not clock data out
+ * \param[in] noOfBytes Number of bytes to clock
+ * \return none
+ */
+void Emu_ClockBytes(EmuDevice *dev, uint8 opcode, const uint8 *data, uint32 noOfBytes)
+{
+	uint64 startTime = dev->chipTime;
+	uint32 i;
+	uint8 out=dev->dataOut,in;
+
+	for(i=0;i<noOfBytes;i++)
+	{
+		if(NULL != data)
+			out = (opcode & EMU_DATA_LSB_FIRST)?Emu_Reverse(data[i]):data[i];
+		else
+			out = dev->dataOut;
+		in = Emu_Wire(dev,out,8);
+		if(opcode & MPSSE_DATA_IN_BIT)
+		{
+			dev->chipTime = startTime + (uint64)(i+1)*8*dev->cyclePs/1000;
+			Emu_Produce(dev,(opcode & EMU_DATA_LSB_FIRST)?Emu_Reverse(in):in);
+		}
+	}
+	if(noOfBytes > 0)
+		dev->dataOut = (out & 0x01)?0xFF:0x00;
+	dev->chipTime = startTime + (uint64)noOfBytes*8*dev->cyclePs/1000;
+	dev->stats.sckCycles += (uint64)noOfBytes*8;
+}
+
+/*!
+ * \brief Clocks the bits of a bit mode data command
+ *
+ * For MSB first commands the bits are sent from bit 7 of data and received into bit 0 of
+ * the result, shifting up. For LSB first commands they are sent from bit 0 and received into
+ * bit 7, shifting down
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] opcode Data command
+ * \param[in] data Bits to clock out
+ * \param[in] noOfBits Number of bits to clock(1-8)
+ * \return none
+ */
+void Emu_ClockBits(EmuDevice *dev, uint8 opcode, uint8 data, uint8 noOfBits)
+{
+	uint8 out,in;
+
+	if(opcode & MPSSE_DATA_OUT_BIT)
+		out = (opcode & EMU_DATA_LSB_FIRST)?Emu_Reverse(data):data;
+	else
+		out = dev->dataOut;
+	in = Emu_Wire(dev,out,noOfBits);
+	dev->dataOut = ((out << (noOfBits-1)) & 0x80)?0xFF:0x00;
+	dev->chipTime += (uint64)noOfBits*dev->cyclePs/1000;
+	dev->stats.sckCycles += noOfBits;
+	if(opcode & EMU_DATA_LSB_FIRST)
+		in = (uint8)(Emu_Reverse(in) << (8-noOfBits));
+	else
+		in = (uint8)(in >> (8-noOfBits));
+	if(opcode & MPSSE_DATA_IN_BIT)
+		Emu_Produce(dev,in);
+}
+
+/*!
+ * \brief Clocks bits through the selected slaves
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] mosi Bits on MOSI, in the order they are on the wire
+ * \param[in] noOfBits Number of bits(1-8)
+ * \return The bits on MISO, in the order they are on the wire
+ */
+uint8 Emu_Wire(EmuDevice *dev, uint8 mosi, uint8 noOfBits)
+{
+	uint8 miso = 0xFF;
+	uint32 i;
+
+	for(i=0;i<dev->noOfSlaves;i++)
+	{
+		if(dev->selected[i])
+			miso &= dev->slaves[i].transfer(dev->slaves[i].context,mosi,noOfBits);
+	}
+	return dev->loopback?mosi:miso;
+}
+
+/*!
+ * \brief Generates clock cycles without data, MOSI keeps its level
+ *
+ * The cycles take time and are counted in EmuStats.sckCycles like those of the data commands
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] noOfBits Number of clock cycles
+ * \return none
+ */
+void Emu_ClockIdle(EmuDevice *dev, uint32 noOfBits)
+{
+	uint32 n;
+
+	dev->chipTime += (uint64)noOfBits*dev->cyclePs/1000;
+	dev->stats.sckCycles += noOfBits;
+	while(noOfBits > 0)
+	{
+		n = (noOfBits > 8)?8:noOfBits;
+		Emu_Wire(dev,dev->dataOut,(uint8)n);
+		noOfBits -= n;
+	}
+}
+
+/*!
+ * \brief Computes the length of a clock cycle from the clock settings
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ * \note The clock is master clock/((1+divisor)*2), a three phase cycle is 1.5 times longer.
+ *		With adaptive clocking the slaves are taken to return the clock at once
+ */
+void Emu_UpdateCycle(EmuDevice *dev)
+{
+	dev->cyclePs = ((uint32)dev->divisor+1)*2*1000000/\
+		(dev->divideBy5?EMU_MASTER_CLOCK_DIV5:EMU_MASTER_CLOCK);
+	if(dev->threePhase)
+		dev->cyclePs = dev->cyclePs*3/2;
+}
+
+/*!
+ * \brief Selects and deselects the slaves as per the state of their chip select pins
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ * \note Pins that are inputs are pulled up
+ */
+void Emu_UpdateSelects(EmuDevice *dev)
+{
+	uint16 pins;
+	bool selected;
+	uint32 i;
+
+	/* ADBUS7-ADBUS0 in the low and ACBUS7-ACBUS0 in the high 8 bits */
+	pins = (uint8)((dev->lowValue & dev->lowDirection) | ~dev->lowDirection);
+	pins |= (uint16)((uint8)((dev->highValue & dev->highDirection) | \
+		~dev->highDirection))<<8;
+	for(i=0;i<dev->noOfSlaves;i++)
+	{
+		selected = ((pins >> dev->slaves[i].csPin) & 1)?TRUE:FALSE;
+		if(dev->slaves[i].csActiveLow)
+			selected = !selected;
+		if(selected != dev->selected[i])
+		{
+			dev->selected[i] = selected;
+			if(NULL != dev->slaves[i].select)
+				dev->slaves[i].select(dev->slaves[i].context,selected);
+		}
+	}
+}
+
+/*!
+ * \brief Returns the levels of the pins of the low byte
+ *
+ * Inputs are pulled up, except GPIOL1 which is low while any slave is busy
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return Levels of ADBUS7-ADBUS0
+ */
+uint8 Emu_LowPins(EmuDevice *dev)
+{
+	uint8 pins = (uint8)((dev->lowValue & dev->lowDirection) | ~dev->lowDirection);
+	uint32 i;
+
+	for(i=0;(i<dev->noOfSlaves) && !(dev->lowDirection & EMU_GPIOL1);i++)
+	{
+		if((NULL != dev->slaves[i].busy) && dev->slaves[i].busy(dev->slaves[i].context))
+			pins &= (uint8)~EMU_GPIOL1;
+	}
+	return pins;
+}
+
+/*!
+ * \brief Executes a wait on I/O command
+ *
+ * The MPSSE looks at GPIOL1 every EMU_WAIT_POLL_TIME until it has the given level. If it
+ * does not get there in EMU_WAIT_MAX_POLLS looks the MPSSE stalls, as a real chip would
+ * wait forever
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] level TRUE to wait for GPIOL1 to be high, FALSE to wait for it to be low
+ * \return none
+ */
+void Emu_WaitOnIO(EmuDevice *dev, bool level)
+{
+	uint32 polls;
+
+	for(polls=0;polls<EMU_WAIT_MAX_POLLS;polls++)
+	{
+		if(((Emu_LowPins(dev) & EMU_GPIOL1)?TRUE:FALSE) == level)
+			return;
+		dev->chipTime += EMU_WAIT_POLL_TIME;
+	}
+	DBG(MSG_WARN,"GPIOL1 did not change, the MPSSE is stalled\n");
+	dev->stalled = TRUE;
+}
+
+/*!
+ * \brief Reverses the order of the bits of a byte
+ */
+uint8 Emu_Reverse(uint8 value)
+{
+	value = (uint8)(((value & 0xF0) >> 4) | ((value & 0x0F) << 4));
+	value = (uint8)(((value & 0xCC) >> 2) | ((value & 0x33) << 2));
+	value = (uint8)(((value & 0xAA) >> 1) | ((value & 0x55) << 1));
+	return value;
+}
+
+/*!
+ * \brief Queues a byte produced by the MPSSE for the host
+ *
+ * The byte waits in the chip until a packet is sent
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] value Byte to be sent to the host
+ * \return none
+ * \note The byte is dropped if the queue cannot grow
+ */
+void Emu_Produce(EmuDevice *dev, uint8 value)
+{
+	uint8 *buffer;
+	uint32 size;
+
+	if(dev->rxTail == dev->rxSize)
+	{
+		if(dev->rxHead > 0)
+		{/* Move the data to the start of the buffer */
+			memmove(dev->rxBuffer,&dev->rxBuffer[dev->rxHead],dev->rxTail-dev->rxHead);
+			dev->rxTail -= dev->rxHead;
+			dev->rxHead = 0;
+		}
+		else
+		{/* Grow the buffer */
+			size = (0 == dev->rxSize)?emuConfig.fifoSize:dev->rxSize*2;
+			buffer = (uint8*)INFRA_MALLOC(size);
+			if(NULL == buffer)
+			{
+				DBG(MSG_ERR,"data for the host dropped\n");
+				return;
+			}
+			if(NULL != dev->rxBuffer)
+			{
+				memcpy(buffer,dev->rxBuffer,dev->rxTail);
+				INFRA_FREE(dev->rxBuffer);
+			}
+			dev->rxBuffer = buffer;
+			dev->rxSize = size;
+		}
+	}
+	dev->rxBuffer[dev->rxTail++] = value;
+	dev->producedTime = dev->chipTime;
+	if(++dev->rxPending == (emuConfig.usbPacketSize - EMU_STATUS_BYTES))
+		Emu_SendPacket(dev);
+}
+
+/*!
+ * \brief Sends the bytes waiting in the chip to the host in one packet
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ */
+void Emu_SendPacket(EmuDevice *dev)
+{
+	uint64 sendTime = dev->chipTime;
+
+	if(sendTime < dev->rxReadyTime)
+		sendTime = dev->rxReadyTime;
+	dev->rxReadyTime = sendTime + (uint64)(dev->rxPending + EMU_STATUS_BYTES)*\
+		1000000000/emuConfig.usbBytesPerSecond;
+	Emu_QueuePacket(dev,dev->rxPending);
+	dev->rxPending = 0;
+	dev->stats.inPackets++;
+}
+
+/*!
+ * \brief Adds the packet just sent to the ring of packets on their way to the host
+ *
+ * \param[in] dev Emulated channel, locked by the caller, with rxReadyTime set for the packet
+ * \param[in] noOfBytes Data bytes of the packet
+ * \return none
+ * \note If the ring cannot grow the bytes are added to the last packet, which makes them
+ * wait for the newer ready time
+ */
+void Emu_QueuePacket(EmuDevice *dev, uint32 noOfBytes)
+{
+	EmuPacket *packets;
+	uint32 size,i;
+
+	if(dev->noOfQueuedPackets == dev->packetsSize)
+	{/* Grow the ring and move the packets to its start */
+		size = (0 == dev->packetsSize)?EMU_MAX_FIFO_PACKETS:dev->packetsSize*2;
+		packets = (EmuPacket*)INFRA_MALLOC(size*sizeof(EmuPacket));
+		if(NULL == packets)
+		{
+			DBG(MSG_ERR,"packet merged with the previous one\n");
+			if(dev->noOfQueuedPackets > 0)
+			{
+				i = (dev->packetHead + dev->noOfQueuedPackets - 1) % dev->packetsSize;
+				dev->packets[i].noOfBytes += noOfBytes;
+				dev->packets[i].readyTime = dev->rxReadyTime;
+			}
+			return;
+		}
+		for(i=0;i<dev->noOfQueuedPackets;i++)
+			packets[i] = dev->packets[(dev->packetHead + i) % dev->packetsSize];
+		if(NULL != dev->packets)
+		{
+			INFRA_FREE(dev->packets);
+		}
+		dev->packets = packets;
+		dev->packetsSize = size;
+		dev->packetHead = 0;
+	}
+	i = (dev->packetHead + dev->noOfQueuedPackets) % dev->packetsSize;
+	dev->packets[i].noOfBytes = noOfBytes;
+	dev->packets[i].readyTime = dev->rxReadyTime;
+	dev->noOfQueuedPackets++;
+}
+
+/*!
+ * \brief Counts the bytes of the packets that have reached the host
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return Bytes that can be read without waiting
+ */
+uint32 Emu_ArrivedBytes(EmuDevice *dev)
+{
+	uint32 i,noOfBytes=0;
+	EmuPacket *packet;
+
+	for(i=0;i<dev->noOfQueuedPackets;i++)
+	{
+		packet = &dev->packets[(dev->packetHead + i) % dev->packetsSize];
+		if(packet->readyTime > dev->now)
+			break;
+		noOfBytes += packet->noOfBytes;
+	}
+	return noOfBytes;
+}
+
+/*!
+ * \brief Removes the bytes read by the host from the ring of packets
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \param[in] noOfBytes Bytes read, 0 to only look at the oldest packet
+ * \return When the packet that holds the last byte read reaches the host
+ * \note Bytes that were not put in a packet are taken as ready at rxReadyTime
+ */
+uint64 Emu_ConsumePackets(EmuDevice *dev, uint32 noOfBytes)
+{
+	EmuPacket *packet;
+	uint64 readyTime = dev->rxReadyTime;
+
+	while(dev->noOfQueuedPackets > 0)
+	{
+		packet = &dev->packets[dev->packetHead];
+		readyTime = packet->readyTime;
+		if(noOfBytes < packet->noOfBytes)
+		{
+			packet->noOfBytes -= noOfBytes;
+			break;
+		}
+		noOfBytes -= packet->noOfBytes;
+		dev->packetHead = (dev->packetHead + 1) % dev->packetsSize;
+		dev->noOfQueuedPackets--;
+		if(0 == noOfBytes)
+			break;
+	}
+	if(noOfBytes > 0)
+		readyTime = dev->rxReadyTime;
+	return readyTime;
+}
+
+/*!
+ * \brief Sends the bytes waiting in the chip when the latency timer expires
+ *
+ * \param[in] dev Emulated channel, locked by the caller
+ * \return none
+ */
+void Emu_LatencyFlush(EmuDevice *dev)
+{
+	uint64 chipTime;
+
+	if(dev->rxPending > 0)
+	{
+		chipTime = dev->chipTime;
+		dev->chipTime = dev->producedTime + (uint64)dev->latencyTimer*1000000;
+		Emu_SendPacket(dev);
+		dev->chipTime = (chipTime > dev->chipTime)?chipTime:dev->chipTime;
+		dev->stats.latencyFlushes++;
+	}
+}
+
+/*!
+ * \brief Signals the event registered with FT_SetEventNotification for received data
+ *
+ * \param[in] dev Emulated channel, not locked
+ * \return none
+ */
+void Emu_SignalEvent(EmuDevice *dev)
+{
+	PVOID param = dev->eventParam;
+#ifndef _WIN32
+	EVENT_HANDLE *event;
+#endif
+
+	if((NULL == param) || !(dev->eventMask & FT_EVENT_RXCHAR))
+		return;
+#ifdef _WIN32
+	SetEvent((HANDLE)param);
+#else
+	event = (EVENT_HANDLE*)param;
+	pthread_mutex_lock(&event->eMutex);
+	pthread_cond_signal(&event->eCondVar);
+	pthread_mutex_unlock(&event->eMutex);
+#endif
+}
+
+/*!
+ * \brief Detaches and destroys the slaves of a channel
+ *
+ * \param[in] dev Emulated channel
+ * \return none
+ */
+void Emu_DetachSlaves(EmuDevice *dev)
+{
+	uint32 i;
+
+	for(i=0;i<dev->noOfSlaves;i++)
+	{
+		if(NULL != dev->slaves[i].destroy)
+			dev->slaves[i].destroy(dev->slaves[i].context);
+	}
+	dev->noOfSlaves = 0;
+}
+
+/*!
+ * \brief transfer function of the loopback slave
+ */
+uint8 Emu_LoopbackTransfer(void *context, uint8 mosi, uint8 noOfBits)
+{
+	return mosi;
+}
+
+/*!
+ * \brief select function of the flash slave
+ *
+ * A command starts when the flash is selected and programs or erases when it is deselected
+ */
+void Emu_FlashSelect(void *context, bool selected)
+{
+	EmuFlash *flash = (EmuFlash*)context;
+	uint32 start,size=0;
+
+	if(selected)
+	{
+		flash->opcode = 0;
+		flash->byteCount = 0;
+		flash->bitCount = 0;
+		return;
+	}
+	if(!(flash->status & EMU_FLASH_STATUS_WEL) || (flash->busyPolls > 0))
+		return;
+	switch(flash->opcode)
+	{
+		case EMU_FLASH_CMD_PAGE_PROGRAM:
+			if(flash->byteCount > 4)
+			{/* the data was written as it was received */
+				flash->status &= ~EMU_FLASH_STATUS_WEL;
+				flash->busyPolls = EMU_FLASH_PROGRAM_POLLS;
+			}
+			return;
+		case EMU_FLASH_CMD_SECTOR_ERASE:
+			size = EMU_FLASH_SECTOR_SIZE;
+			break;
+		case EMU_FLASH_CMD_BLOCK_ERASE:
+			size = EMU_FLASH_BLOCK_SIZE;
+			break;
+		case EMU_FLASH_CMD_CHIP_ERASE:
+		case EMU_FLASH_CMD_CHIP_ERASE_ALT:
+			size = flash->size;
+			break;
+		default:
+			return;
+	}
+	if((size < flash->size) && (flash->byteCount < 4))
+		return;/* the address is incomplete */
+	start = (flash->address & (flash->size-1)) & ~(size-1);
+	memset(&flash->memory[start],0xFF,size);
+	flash->status &= ~EMU_FLASH_STATUS_WEL;
+	flash->busyPolls = EMU_FLASH_ERASE_POLLS;
+}
+
+/*!
+ * \brief transfer function of the flash slave
+ */
+uint8 Emu_FlashTransfer(void *context, uint8 mosi, uint8 noOfBits)
+{
+	EmuFlash *flash = (EmuFlash*)context;
+	uint8 miso=0,bit;
+
+	if((0 == flash->bitCount) && (8 == noOfBits))
+	{/* Whole byte */
+		miso = Emu_FlashOutput(flash);
+		Emu_FlashInput(flash,mosi);
+		return miso;
+	}
+	for(bit=0;bit<noOfBits;bit++)
+	{
+		if(0 == flash->bitCount)
+			flash->outShift = Emu_FlashOutput(flash);
+		miso |= (uint8)(((flash->outShift << flash->bitCount) & 0x80) >> bit);
+		flash->inShift = (uint8)((flash->inShift << 1) | (((mosi << bit) & 0x80) >> 7));
+		if(8 == ++flash->bitCount)
+		{
+			flash->bitCount = 0;
+			Emu_FlashInput(flash,flash->inShift);
+		}
+	}
+	return miso;
+}
+
+/*!
+ * \brief destroy function of the flash slave
+ */
+void Emu_FlashDestroy(void *context)
+{
+	EmuFlash *flash = (EmuFlash*)context;
+
+	INFRA_FREE(flash->memory);
+	INFRA_FREE(flash);
+}
+
+/*!
+ * \brief busy function of the flash slave
+ *
+ * Each look at the busy line counts as a status read
+ */
+bool Emu_FlashBusy(void *context)
+{
+	EmuFlash *flash = (EmuFlash*)context;
+
+	if(0 == flash->busyPolls)
+		return FALSE;
+	flash->busyPolls--;
+	return TRUE;
+}
+
+/*!
+ * \brief Returns the byte the flash sends while it receives the next one
+ */
+uint8 Emu_FlashOutput(EmuFlash *flash)
+{
+	uint8 value=0xFF;
+	uint32 size;
+
+	if(0 == flash->byteCount)
+		return value;
+	switch(flash->opcode)
+	{
+		case EMU_FLASH_CMD_READ_STATUS:
+			value = flash->status;
+			if(flash->busyPolls > 0)
+			{
+				value |= EMU_FLASH_STATUS_WIP;
+				flash->busyPolls--;
+			}
+			break;
+		case EMU_FLASH_CMD_READ_JEDEC_ID:
+			if(1 == flash->byteCount)
+				value = EMU_FLASH_MANUFACTURER_ID;
+			else if(2 == flash->byteCount)
+				value = EMU_FLASH_MEMORY_TYPE;
+			else if(3 == flash->byteCount)
+			{/* capacity is log2 of the size */
+				for(value=0,size=flash->size;size>1;size>>=1)
+					value++;
+			}
+			break;
+		case EMU_FLASH_CMD_READ:
+			if(flash->byteCount >= 4)
+				value = flash->memory[(flash->address + flash->byteCount-4) & (flash->size-1)];
+			break;
+		case EMU_FLASH_CMD_FAST_READ:
+			/* one dummy byte follows the address */
+			if(flash->byteCount >= 5)
+				value = flash->memory[(flash->address + flash->byteCount-5) & (flash->size-1)];
+			break;
+		default:
+			break;
+	}
+	return value;
+}
+
+/*!
+ * \brief Takes a byte received by the flash
+ */
+void Emu_FlashInput(EmuFlash *flash, uint8 value)
+{
+	uint32 page,offset;
+
+	if(0 == flash->byteCount)
+	{
+		/* Only the status can be read while a program or an erase is in progress */
+		flash->opcode = ((flash->busyPolls > 0) && (EMU_FLASH_CMD_READ_STATUS != value))?\
+			0:value;
+		flash->address = 0;
+		if(EMU_FLASH_CMD_WRITE_ENABLE == flash->opcode)
+			flash->status |= EMU_FLASH_STATUS_WEL;
+		else if(EMU_FLASH_CMD_WRITE_DISABLE == flash->opcode)
+			flash->status &= ~EMU_FLASH_STATUS_WEL;
+	}
+	else if(flash->byteCount < 4)
+	{/* address, MSB first */
+		flash->address = (flash->address << 8) | value;
+	}
+	else if((EMU_FLASH_CMD_PAGE_PROGRAM == flash->opcode) && \
+		(flash->status & EMU_FLASH_STATUS_WEL))
+	{/* Programming can only clear bits, the address wraps within the page */
+		page = (flash->address & (flash->size-1)) & ~(EMU_FLASH_PAGE_SIZE-1);
+		offset = (flash->address + flash->byteCount-4) & (EMU_FLASH_PAGE_SIZE-1);
+		flash->memory[page + offset] &= value;
+	}
+	flash->byteCount++;
+}
@@ -27,6 +27,14 @@
  * 0.2  - 20110708 - added memory related macros
  * 0.3  - 20111103 - added 64bit linux support, cleaned up
  * 0.41 - 20140903 - fixed compile warnings
+ * 0.5  - 20261015 - added mutex abstraction(InfraMutex)
+ *				  added event abstraction(InfraEvent) & FT_SetEventNotification
+ *				  added FT_OpenEx
+ *				  added Infra_GetTickCount & Infra_GetNanoseconds
+ *				  added Infra_ReverseBits
+ *				  added read/write lock abstraction(InfraRWLock) & INFRA_ATOMIC_xxx
+ *				  added INFRA_ATOMIC_ADD32/64, INFRA_ATOMIC_LOAD32/64 &
+ *				  INFRA_ATOMIC_STORE32/64 for counters read without a lock
  *
  */
 
@@ -38,6 +46,9 @@
 /******************************************************************************/
 
 #ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600	/*for SRWLOCK*/
+#endif
 #include<windows.h>
 #endif
 
@@ -45,6 +56,8 @@
 #include<dlfcn.h>	/*for dlopen() & dlsym()*/
 #include<stdarg.h>	/*for va_start() & va_arg()*/
 #include<unistd.h>	/*for Sleep()*/
+#include<pthread.h>	/*for pthread_mutex_t & pthread_rwlock_t*/
+#include<time.h>	/*for clock_gettime()*/
 #endif
 
 #ifndef _MSC_VER
@@ -160,6 +173,83 @@ status=FT_INVALID_PARAMETER ; return(status);}else{;}};
 	#define INFRA_SLEEP(exp)			Sleep(exp);
 #endif
 
+/* mutex abstraction - an uncontended lock/unlock stays in user space on both platforms */
+#ifdef _WIN32
+	typedef CRITICAL_SECTION InfraMutex;
+	#define INFRA_MUTEX_INIT(exp)		InitializeCriticalSection(exp);
+	#define INFRA_MUTEX_DESTROY(exp)	DeleteCriticalSection(exp);
+	#define INFRA_MUTEX_LOCK(exp)		EnterCriticalSection(exp);
+	#define INFRA_MUTEX_UNLOCK(exp)		LeaveCriticalSection(exp);
+#else
+	typedef pthread_mutex_t InfraMutex;
+	#define INFRA_MUTEX_INIT(exp)		pthread_mutex_init(exp,NULL);
+	#define INFRA_MUTEX_DESTROY(exp)	pthread_mutex_destroy(exp);
+	#define INFRA_MUTEX_LOCK(exp)		pthread_mutex_lock(exp);
+	#define INFRA_MUTEX_UNLOCK(exp)		pthread_mutex_unlock(exp);
+#endif
+
+/* read/write lock abstraction - any number of readers or one writer, readers do not wait for
+each other */
+#ifdef _WIN32
+	typedef SRWLOCK InfraRWLock;
+	#define INFRA_RWLOCK_INIT(exp)			InitializeSRWLock(exp);
+	#define INFRA_RWLOCK_DESTROY(exp)		;
+	#define INFRA_RWLOCK_READ_LOCK(exp)		AcquireSRWLockShared(exp);
+	#define INFRA_RWLOCK_READ_UNLOCK(exp)	ReleaseSRWLockShared(exp);
+	#define INFRA_RWLOCK_WRITE_LOCK(exp)	AcquireSRWLockExclusive(exp);
+	#define INFRA_RWLOCK_WRITE_UNLOCK(exp)	ReleaseSRWLockExclusive(exp);
+#else
+	typedef pthread_rwlock_t InfraRWLock;
+	#define INFRA_RWLOCK_INIT(exp)			pthread_rwlock_init(exp,NULL);
+	#define INFRA_RWLOCK_DESTROY(exp)		pthread_rwlock_destroy(exp);
+	#define INFRA_RWLOCK_READ_LOCK(exp)		pthread_rwlock_rdlock(exp);
+	#define INFRA_RWLOCK_READ_UNLOCK(exp)	pthread_rwlock_unlock(exp);
+	#define INFRA_RWLOCK_WRITE_LOCK(exp)	pthread_rwlock_wrlock(exp);
+	#define INFRA_RWLOCK_WRITE_UNLOCK(exp)	pthread_rwlock_unlock(exp);
+#endif
+
+/* atomic abstraction - INFRA_ATOMIC_INC & INFRA_ATOMIC_DEC change a uint32 and return its new
+value, they order the memory accesses around them */
+#ifdef _MSC_VER
+	#define INFRA_ATOMIC_INC(exp)		((uint32)InterlockedIncrement((volatile LONG*)(exp)))
+	#define INFRA_ATOMIC_DEC(exp)		((uint32)InterlockedDecrement((volatile LONG*)(exp)))
+#else
+	#define INFRA_ATOMIC_INC(exp)		__atomic_add_fetch(exp,1,__ATOMIC_ACQ_REL)
+	#define INFRA_ATOMIC_DEC(exp)		__atomic_sub_fetch(exp,1,__ATOMIC_ACQ_REL)
+#endif
+
+/* Relaxed atomics for counters that are read while they are being changed. Each access is
+indivisible(a uint64 is not torn on 32 bit machines) but orders nothing around it */
+#ifdef _MSC_VER
+	#define INFRA_ATOMIC_ADD32(exp,val)	\
+		((void)InterlockedExchangeAdd((volatile LONG*)(exp),(LONG)(val)))
+	#define INFRA_ATOMIC_ADD64(exp,val)	\
+		((void)InterlockedExchangeAdd64((volatile LONGLONG*)(exp),(LONGLONG)(val)))
+	#define INFRA_ATOMIC_LOAD32(exp)		((uint32)*(volatile LONG*)(exp))
+	#define INFRA_ATOMIC_LOAD64(exp)		\
+		((uint64)InterlockedCompareExchange64((volatile LONGLONG*)(exp),0,0))
+	#define INFRA_ATOMIC_STORE32(exp,val)	((void)(*(volatile LONG*)(exp) = (LONG)(val)))
+	#define INFRA_ATOMIC_STORE64(exp,val)	\
+		((void)InterlockedExchange64((volatile LONGLONG*)(exp),(LONGLONG)(val)))
+#else
+	#define INFRA_ATOMIC_ADD32(exp,val)	((void)__atomic_fetch_add(exp,val,__ATOMIC_RELAXED))
+	#define INFRA_ATOMIC_ADD64(exp,val)	((void)__atomic_fetch_add(exp,val,__ATOMIC_RELAXED))
+	#define INFRA_ATOMIC_LOAD32(exp)		__atomic_load_n(exp,__ATOMIC_RELAXED)
+	#define INFRA_ATOMIC_LOAD64(exp)		__atomic_load_n(exp,__ATOMIC_RELAXED)
+	#define INFRA_ATOMIC_STORE32(exp,val)	__atomic_store_n(exp,val,__ATOMIC_RELAXED)
+	#define INFRA_ATOMIC_STORE64(exp,val)	__atomic_store_n(exp,val,__ATOMIC_RELAXED)
+#endif
+
+/* event abstraction - an event that D2XX signals through FT_SetEventNotification. On windows
+it is an auto reset event, on linux the condition variable & mutex pair of EVENT_HANDLE */
+#ifdef _WIN32
+	typedef HANDLE InfraEvent;
+	#define INFRA_EVENT_PARAM(exp)		((PVOID)*(exp))
+#else
+	typedef EVENT_HANDLE InfraEvent;
+	#define INFRA_EVENT_PARAM(exp)		((PVOID)(exp))
+#endif
+
 /* Memory allocating, freeing & copying macros -  */
 #define INFRA_MALLOC(exp)			malloc(exp); \
 	DBG(MSG_DEBUG,"INFRA_MALLOC %ubytes\n",exp);
@@ -207,6 +297,8 @@ status=FT_INVALID_PARAMETER ; return(status);}else{;}};
 		(FT_DEVICE_LIST_INFO_NODE *pDest, LPDWORD lpdwNumDevs);
 	typedef FT_STATUS (CAL_CONV *pfunc_FT_Open) (int iDevice, \
 		FT_HANDLE *ftHandle);
+	typedef FT_STATUS (CAL_CONV *pfunc_FT_OpenEx) (PVOID pArg1, DWORD Flags, \
+		FT_HANDLE *ftHandle);
 	typedef FT_STATUS (CAL_CONV *pfunc_FT_Close) (FT_HANDLE ftHandle);
 	typedef FT_STATUS (CAL_CONV *pfunc_FT_ResetDevice) (FT_HANDLE ftHandle);
 	typedef FT_STATUS (CAL_CONV *pfunc_FT_Purge) (FT_HANDLE ftHandle, \
@@ -230,6 +322,8 @@ status=FT_INVALID_PARAMETER ; return(status);}else{;}};
 	typedef FT_STATUS (CAL_CONV *pfunc_FT_GetDeviceInfo)(FT_HANDLE ftHandle, \
 		FT_DEVICE *lpftDevice, LPDWORD lpdwID, PCHAR SerialNumber, PCHAR \
 		Description, LPVOID Dummy);
+	typedef FT_STATUS (CAL_CONV *pfunc_FT_SetEventNotification)(FT_HANDLE \
+		ftHandle, DWORD dwEventMask, PVOID pvArg);
 
 typedef struct InfraFunctionPtrLst_t
 {
@@ -237,6 +331,7 @@ typedef struct InfraFunctionPtrLst_t
 	pfunc_FT_GetNumChannel p_FT_GetNumChannel;
 	pfunc_FT_GetDeviceInfoList p_FT_GetDeviceInfoList;
 	pfunc_FT_Open p_FT_Open;
+	pfunc_FT_OpenEx p_FT_OpenEx;
 	pfunc_FT_Close p_FT_Close;
 	pfunc_FT_ResetDevice p_FT_ResetDevice;
 	pfunc_FT_Purge p_FT_Purge;
@@ -249,6 +344,7 @@ typedef struct InfraFunctionPtrLst_t
 	pfunc_FT_Read p_FT_Read;
 	pfunc_FT_Write p_FT_Write;
 	pfunc_FT_GetDeviceInfo p_FT_GetDeviceInfo;
+	pfunc_FT_SetEventNotification p_FT_SetEventNotification;
 }InfraFunctionPtrLst;
 
 
@@ -273,6 +369,14 @@ extern InfraFunctionPtrLst varFunctionPtrLst;
 /******************************************************************************/
 FT_STATUS Infra_DbgPrintStatus(FT_STATUS status);
 FT_STATUS Infra_Delay(uint64 delay);
+FT_STATUS Infra_EventInit(InfraEvent *event);
+void Infra_EventDestroy(InfraEvent *event);
+void Infra_EventLock(InfraEvent *event);
+void Infra_EventUnlock(InfraEvent *event);
+bool Infra_EventWait(InfraEvent *event, uint32 milliSeconds);
+uint32 Infra_GetTickCount(void);
+uint64 Infra_GetNanoseconds(void);
+void Infra_ReverseBits(uint8 *buffer, uint32 size);
 
 
 
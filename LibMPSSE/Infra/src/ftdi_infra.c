@@ -24,6 +24,14 @@
  * 0.2  - 20110708 - exported Init_libMPSSE & Cleanup_libMPSSE for Microsoft toolchain support
  * 0.3  - 20111103 - commented & cleaned up
  * 0.41 - 20140903 - fixed compile warnings 
+ * 0.5  - 20261015 - Init_libMPSSE & Cleanup_libMPSSE call the middle layer and SPI module
+ *				  init & cleanup
+ *				  resolve FT_SetEventNotification, added Infra_Event* functions
+ *				  resolve FT_OpenEx
+ *				  added Infra_GetTickCount & Infra_GetNanoseconds
+ *				  Init_libMPSSE installs the emulator instead of loading D2XX when
+ *				  EMU_ENVIRONMENT_VARIABLE is set
+ *				  added Infra_ReverseBits
  */
 
 
@@ -31,6 +39,23 @@
 /*								Include files					  			  */
 /******************************************************************************/
 #include "ftdi_infra.h"		/*portable infrastructure(datatypes, libraries, etc)*/
+#include "ftdi_spi.h"		/*SPI module init & cleanup*/
+#include "ftdi_emu.h"		/*Emulated D2XX*/
+
+/* SIMD instructions used by Infra_ReverseBits, the widest that the compiler targets */
+#if defined(__AVX2__)
+	#include<immintrin.h>
+	#define INFRA_REVERSE_BITS_AVX2
+#elif defined(__SSSE3__)
+	#include<tmmintrin.h>
+	#define INFRA_REVERSE_BITS_SSSE3
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	#include<emmintrin.h>
+	#define INFRA_REVERSE_BITS_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#include<arm_neon.h>
+	#define INFRA_REVERSE_BITS_NEON
+#endif
 
 
 /******************************************************************************/
@@ -227,6 +252,264 @@ FT_STATUS Infra_Delay(uint64 delay)
 	return status;
 }
 
+/*!
+ * \brief Creates an event that D2XX can signal
+ *
+ * This function creates an event that can be passed to FT_SetEventNotification
+ *
+ * \param[in] event Pointer to the event
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Infra_EventDestroy
+ * \note
+ * \warning
+ */
+FT_STATUS Infra_EventInit(InfraEvent *event)
+{
+	FT_STATUS status=FT_OK;
+	FN_ENTER;
+#ifdef _WIN32
+	*event = CreateEvent(NULL,FALSE,FALSE,NULL);
+	if(NULL == *event)
+		status = FT_INSUFFICIENT_RESOURCES;
+#else
+	pthread_mutex_init(&event->eMutex,NULL);
+	pthread_cond_init(&event->eCondVar,NULL);
+	event->iVar = 0;
+#endif
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Destroys an event
+ *
+ * This function frees the resources of an event created by Infra_EventInit
+ *
+ * \param[in] event Pointer to the event
+ * \return none
+ * \sa Infra_EventInit
+ * \note
+ * \warning
+ */
+void Infra_EventDestroy(InfraEvent *event)
+{
+#ifdef _WIN32
+	CloseHandle(*event);
+#else
+	pthread_cond_destroy(&event->eCondVar);
+	pthread_mutex_destroy(&event->eMutex);
+#endif
+}
+
+/*!
+ * \brief Locks an event
+ *
+ * The condition being waited for must be checked between Infra_EventLock and
+ * Infra_EventWait, so that a signal that arrives in between is not lost
+ *
+ * \param[in] event Pointer to the event
+ * \return none
+ * \sa Infra_EventWait, Infra_EventUnlock
+ * \note Does nothing on windows, where the event stays signalled until it is waited for
+ * \warning
+ */
+void Infra_EventLock(InfraEvent *event)
+{
+#ifndef _WIN32
+	pthread_mutex_lock(&event->eMutex);
+#endif
+}
+
+/*!
+ * \brief Unlocks an event
+ *
+ * \param[in] event Pointer to the event
+ * \return none
+ * \sa Infra_EventLock
+ * \note
+ * \warning
+ */
+void Infra_EventUnlock(InfraEvent *event)
+{
+#ifndef _WIN32
+	pthread_mutex_unlock(&event->eMutex);
+#endif
+}
+
+/*!
+ * \brief Waits for an event to be signalled
+ *
+ * This function blocks the calling thread until the event is signalled or the timeout expires
+ *
+ * \param[in] event Pointer to the event, locked by Infra_EventLock
+ * \param[in] milliSeconds Timeout in milliseconds
+ * \return TRUE if the event was signalled, FALSE if the timeout expired
+ * \sa Infra_EventLock
+ * \note The event is still locked when the function returns
+ * \warning
+ */
+bool Infra_EventWait(InfraEvent *event, uint32 milliSeconds)
+{
+#ifdef _WIN32
+	return (WAIT_OBJECT_0 == WaitForSingleObject(*event,milliSeconds))?TRUE:FALSE;
+#else
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_REALTIME,&deadline);
+	deadline.tv_sec += milliSeconds/1000;
+	deadline.tv_nsec += (long)(milliSeconds%1000)*1000000;
+	if(deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+	return (0 == pthread_cond_timedwait(&event->eCondVar,&event->eMutex,&deadline))?\
+		TRUE:FALSE;
+#endif
+}
+
+/*!
+ * \brief Returns a millisecond counter
+ *
+ * This function returns the value of a monotonic clock in milliseconds, to be used for timeouts
+ *
+ * \return Value of the counter
+ * \sa
+ * \note The counter wraps around, so only the difference of two values is meaningful
+ * \warning
+ */
+uint32 Infra_GetTickCount(void)
+{
+#ifdef _WIN32
+	return (uint32)GetTickCount();
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint32)(now.tv_sec*1000 + now.tv_nsec/1000000);
+#endif
+}
+
+/*!
+ * \brief Returns a nanosecond counter
+ *
+ * This function returns the value of a monotonic clock in nanoseconds, to be used for
+ * measuring how long an operation took and for timestamps of trace events
+ *
+ * \return Value of the counter
+ * \sa Infra_GetTickCount
+ * \note
+ * \warning
+ */
+uint64 Infra_GetNanoseconds(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter,frequency;
+
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (uint64)(counter.QuadPart/frequency.QuadPart)*1000000000 + \
+		(uint64)((counter.QuadPart%frequency.QuadPart)*1000000000/frequency.QuadPart);
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64)now.tv_sec*1000000000 + (uint64)now.tv_nsec;
+#endif
+}
+
+/*!
+ * \brief Reverses the order of the bits of each byte of a buffer
+ *
+ * This function handles 32 bytes per step with AVX2, 16 bytes with SSSE3, SSE2 or NEON,
+ * whichever is the widest that the compiler targets(see INFRA_REVERSE_BITS_xxx), and the
+ * rest 8 bytes per step with 64 bit shifts and masks
+ *
+ * \param[in,out] buffer Data whose bytes are reversed in place
+ * \param[in] size Number of bytes in the buffer
+ * \return none
+ * \sa SPI_ReverseBits
+ * \note The SIMD instructions are chosen when the library is compiled(e.g. -march=native),
+ *		there is no detection of the CPU at run time
+ * \warning
+ */
+void Infra_ReverseBits(uint8 *buffer, uint32 size)
+{
+	uint32 i=0;
+	uint64 value;
+#if defined(INFRA_REVERSE_BITS_AVX2)
+	/* Reversal of each nibble, looked up 32 bytes at a time */
+	const __m256i table = _mm256_setr_epi8(0x0,0x8,0x4,0xC,0x2,0xA,0x6,0xE,\
+		0x1,0x9,0x5,0xD,0x3,0xB,0x7,0xF,0x0,0x8,0x4,0xC,0x2,0xA,0x6,0xE,\
+		0x1,0x9,0x5,0xD,0x3,0xB,0x7,0xF);
+	const __m256i mask = _mm256_set1_epi8(0x0F);
+	__m256i data;
+
+	for(;(i+32)<=size;i+=32)
+	{/* The reversed low nibble becomes the high nibble and the other way round */
+		data = _mm256_loadu_si256((const __m256i *)&buffer[i]);
+		data = _mm256_or_si256(\
+			_mm256_slli_epi16(_mm256_shuffle_epi8(table,_mm256_and_si256(data,mask)),4),\
+			_mm256_shuffle_epi8(table,_mm256_and_si256(_mm256_srli_epi16(data,4),mask)));
+		_mm256_storeu_si256((__m256i *)&buffer[i],data);
+	}
+#elif defined(INFRA_REVERSE_BITS_SSSE3)
+	/* Reversal of each nibble, looked up 16 bytes at a time */
+	const __m128i table = _mm_setr_epi8(0x0,0x8,0x4,0xC,0x2,0xA,0x6,0xE,\
+		0x1,0x9,0x5,0xD,0x3,0xB,0x7,0xF);
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	__m128i data;
+
+	for(;(i+16)<=size;i+=16)
+	{/* The reversed low nibble becomes the high nibble and the other way round */
+		data = _mm_loadu_si128((const __m128i *)&buffer[i]);
+		data = _mm_or_si128(\
+			_mm_slli_epi16(_mm_shuffle_epi8(table,_mm_and_si128(data,mask)),4),\
+			_mm_shuffle_epi8(table,_mm_and_si128(_mm_srli_epi16(data,4),mask)));
+		_mm_storeu_si128((__m128i *)&buffer[i],data);
+	}
+#elif defined(INFRA_REVERSE_BITS_SSE2)
+	const __m128i mask1 = _mm_set1_epi8(0x55);
+	const __m128i mask2 = _mm_set1_epi8(0x33);
+	const __m128i mask4 = _mm_set1_epi8(0x0F);
+	__m128i data;
+
+	for(;(i+16)<=size;i+=16)
+	{/* Swaps adjacent bits, pairs and nibbles. The masks keep the 16 bit shifts from moving
+	bits across bytes */
+		data = _mm_loadu_si128((const __m128i *)&buffer[i]);
+		data = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(data,1),mask1),\
+			_mm_slli_epi16(_mm_and_si128(data,mask1),1));
+		data = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(data,2),mask2),\
+			_mm_slli_epi16(_mm_and_si128(data,mask2),2));
+		data = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(data,4),mask4),\
+			_mm_slli_epi16(_mm_and_si128(data,mask4),4));
+		_mm_storeu_si128((__m128i *)&buffer[i],data);
+	}
+#elif defined(INFRA_REVERSE_BITS_NEON)
+	for(;(i+16)<=size;i+=16)
+		vst1q_u8(&buffer[i],vrbitq_u8(vld1q_u8(&buffer[i])));
+#endif
+
+	for(;(i+8)<=size;i+=8)
+	{/* Swaps adjacent bits, pairs and nibbles of 8 bytes at once */
+		memcpy(&value,&buffer[i],sizeof(value));
+		value = ((value >> 1) & 0x5555555555555555ULL) | \
+			((value & 0x5555555555555555ULL) << 1);
+		value = ((value >> 2) & 0x3333333333333333ULL) | \
+			((value & 0x3333333333333333ULL) << 2);
+		value = ((value >> 4) & 0x0F0F0F0F0F0F0F0FULL) | \
+			((value & 0x0F0F0F0F0F0F0F0FULL) << 4);
+		memcpy(&buffer[i],&value,sizeof(value));
+	}
+	for(;i<size;i++)
+	{
+		buffer[i] = (uint8)(((buffer[i] >> 1) & 0x55) | ((buffer[i] & 0x55) << 1));
+		buffer[i] = (uint8)(((buffer[i] >> 2) & 0x33) | ((buffer[i] & 0x33) << 2));
+		buffer[i] = (uint8)((buffer[i] >> 4) | (buffer[i] << 4));
+	}
+}
+
 /******************************************************************************/
 /*						Local function definitions						  */
 /******************************************************************************/
@@ -245,13 +528,33 @@ FT_STATUS Infra_Delay(uint64 delay)
  * \note May individually call Ftdi_I2C_Module_Init, Ftdi_SPI_Module_Init, Ftdi_Mid_Module_Init,
  * Ftdi_Common_Module_Init, etc if required. This function should be called by the OS specific
  * function(eg: DllMain for windows) that is called by the OS automatically during startup.
+ * If the environment variable EMU_ENVIRONMENT_VARIABLE is set, D2XX is not loaded and the
+ * library runs on emulated chips(see Emu_Install).
  * \warning
  */
 FTDI_API void Init_libMPSSE(void)
 {
 	//FT_STATUS status;
+	char *emulator;
+	EmuConfig config;
 	FN_ENTER;
 
+	emulator = getenv(EMU_ENVIRONMENT_VARIABLE);
+	if(NULL != emulator)
+	{
+		memset(&config,0,sizeof(config));
+		config.noOfChannels = (uint32)strtoul(emulator,NULL,10);
+		if(config.noOfChannels > EMU_MAX_CHANNELS)
+			config.noOfChannels = 0;
+		if(FT_OK == Emu_InstallFunctions(&config))
+		{
+			Ftdi_Mid_Module_Init();
+			Ftdi_SPI_Module_Init();
+			FN_EXIT;
+			return;
+		}
+	}
+
 /* Load D2XX dynamic library */
 #ifdef __linux
 	hdll_d2xx = dlopen("libftd2xx.so",RTLD_LAZY);
@@ -273,6 +576,9 @@ FTDI_API void Init_libMPSSE(void)
 	/*open*/
 	varFunctionPtrLst.p_FT_Open = (pfunc_FT_Open)GET_FUNC(hdll_d2xx,"FT_Open");
 	CHECK_SYMBOL(varFunctionPtrLst.p_FT_Open);
+	/*open by serial number, description or location*/
+	varFunctionPtrLst.p_FT_OpenEx = (pfunc_FT_OpenEx)GET_FUNC(hdll_d2xx,"FT_OpenEx");
+	CHECK_SYMBOL(varFunctionPtrLst.p_FT_OpenEx);
 	/*close*/
 	varFunctionPtrLst.p_FT_Close = (pfunc_FT_Close)GET_FUNC(hdll_d2xx,"FT_Close");
 	CHECK_SYMBOL(varFunctionPtrLst.p_FT_Close);
@@ -309,6 +615,10 @@ FTDI_API void Init_libMPSSE(void)
 	/*FT_GetDeviceInfo*/
 	varFunctionPtrLst.p_FT_GetDeviceInfo = (pfunc_FT_GetDeviceInfo)GET_FUNC(hdll_d2xx,"FT_GetDeviceInfo");
 	CHECK_SYMBOL(varFunctionPtrLst.p_FT_GetDeviceInfo);
+	/*FT_SetEventNotification*/
+	varFunctionPtrLst.p_FT_SetEventNotification = \
+		(pfunc_FT_SetEventNotification)GET_FUNC(hdll_d2xx,"FT_SetEventNotification");
+	CHECK_SYMBOL(varFunctionPtrLst.p_FT_SetEventNotification);
 
 	/*Call module specific initialization functions from here(if at all they are required)
 		Example:
@@ -317,6 +627,8 @@ FTDI_API void Init_libMPSSE(void)
 
 			Mid_Init();
 	*/
+	Ftdi_Mid_Module_Init();
+	Ftdi_SPI_Module_Init();
 	FN_EXIT;
 }
 
@@ -337,6 +649,9 @@ FTDI_API void Cleanup_libMPSSE(void)
 {
 	//FT_STATUS status=FT_OK;
 	FN_ENTER;
+	Ftdi_SPI_Module_Cleanup();
+	Ftdi_Mid_Module_Cleanup();
+	Emu_Cleanup();
 #ifdef _WIN32
 	if(NULL != hdll_d2xx)
 	{
@@ -356,7 +671,10 @@ FTDI_API void Cleanup_libMPSSE(void)
 #endif
 
 #ifdef __linux
-    dlclose(hdll_d2xx);
+	if(NULL != hdll_d2xx)
+	{
+		dlclose(hdll_d2xx);
+	}
 #endif
 
 	FN_EXIT;
@@ -25,6 +25,22 @@
  * 0.3  - 20111102	Added function Mid_GetFtDeviceType
  *				Modified function Mid_SetClock
  * 0.41 - 20140903	Added function Mid_GetQueueStatus
+ * 0.5  - 20261015	Added MPSSE command buffer (Mid_CmdBuffer*)
+ *				Added function Mid_GetFifoSize
+ *				Added functions Mid_SetRxEvent & Mid_ChannelReadEvent
+ *				Added function Mid_GetClockCmds, Mid_SetClock sends a single write
+ *				Channels are looked up in a cached channel list(MidChannelList),
+ *				added FT_RefreshChannelList & Ftdi_Mid_Module_Init/Cleanup
+ *				Added function FT_OpenChannelEx
+ *				Added MID_SCRATCH_BUF_SIZE & MID_SYNC_TIMEOUT
+ *				MidCmdBuffer counts the writes it issues
+ *				Added MID_WRITE_HOOK to MidCmdBuffer
+ *				Added function Mid_ChannelReadTimeout
+ *				Mid_GetClockCmds takes MID_CLOCK_3PHASE & MID_CLOCK_ADAPTIVE
+ *				Added MidClock & Mid_SolveClock, Mid_GetClockCmds only provides the
+ *				commands that change the clock settings of the chip
+ *				Added MidPins & Mid_GetPinCmds
+ *				Added MID_GPIO_HOOK & Mid_SetGPIOHook
  */
 
 #ifndef FTDI_MID_H
@@ -42,6 +58,10 @@
 #define MID_MPSSE_AVAILABLE				1
 
 #define MID_MAX_IN_BUF_SIZE         	4096
+/* Size of the buffer on the stack that the sync and purge helpers read into */
+#define MID_SCRATCH_BUF_SIZE			256
+/* Milliseconds to wait for the echo of a bad command */
+#define MID_SYNC_TIMEOUT				1000
 
 #define MID_ECHO_COMMAND_ONCE			0
 #define MID_ECHO_COMMAND_CONTINUOUSLY   1
@@ -62,9 +82,19 @@
 
 #define MID_6MHZ						6000000
 #define MID_30MHZ						30000000
+/* Largest value of the divisor of the clock command(0x86) */
+#define MID_MAX_CLOCK_DIVISOR			0xFFFF
+/* Clock base of the divisor when a cycle has three phases */
+#define MID_4MHZ						4000000
+#define MID_20MHZ						20000000
 
 #define DISABLE_CLOCK_DIVIDE			0x8A
 #define ENABLE_CLOCK_DIVIDE				0x8B
+/* Maximum number of bytes provided by Mid_GetClockCmds */
+#define MID_CLOCK_CMDS_SIZE				6
+/* clockOptions of Mid_GetClockCmds */
+#define MID_CLOCK_3PHASE				0x01	/* a cycle has three phases(1.5 periods) */
+#define MID_CLOCK_ADAPTIVE				0x02	/* edges wait for the return clock on GPIOL3 */
 
 #define MID_LOOPBACK_FALSE				0
 #define MID_LOOPBACK_TRUE				1
@@ -76,13 +106,86 @@
 #define MID_CHK_IN_BUF_OK(size)	{if(size > MID_MAX_IN_BUF_SIZE) \
 	{ return FT_INSUFFICIENT_RESOURCES;}}
 
+/* Size of the data FIFOs of a MPSSE channel */
+#define MID_FIFO_SIZE_FT2232D			128
+#define MID_FIFO_SIZE_FT232H			1024
+#define MID_FIFO_SIZE_FT2232H			4096
+#define MID_FIFO_SIZE_FT4232H			2048
+#define MID_FIFO_SIZE_UNKNOWN			MID_FIFO_SIZE_FT232H
+
+/* Size of the per-channel buffer in which MPSSE commands are assembled before they are sent to
+the chip. Anything larger than this is streamed to the chip in chunks of this size */
+#define MID_CMD_BUFFER_SIZE				USB_OUTPUT_BUFFER_SIZE
+
+/* Function that Mid_CmdBufferFlush calls after every write it issues */
+typedef void (*MID_WRITE_HOOK)(void *hookContext, FT_STATUS status, uint32 noOfBytes);
+
+/* Function that FT_WriteGPIO calls before it writes the high byte of a channel, so that the
+protocol layer can keep the pins that it drives itself and track the state of the others */
+typedef void (*MID_GPIO_HOOK)(FT_HANDLE handle, uint8 *dir, uint8 *value);
+
+/* MPSSE commands and data are collected in this buffer and sent to the chip using a single call
+to FT_Write, so that a complete transaction (chip select, command, length, data, chip deselect)
+takes one USB transfer instead of one per command */
+typedef struct MidCmdBuffer_t
+{
+	FT_LegacyProtocol	protocol;
+	FT_HANDLE			handle;
+	uint8				*buffer;
+	uint32				size;	/* capacity of buffer in bytes */
+	uint32				length;	/* number of bytes currently assembled in buffer */
+	uint32				noOfWrites;	/* USB writes issued by Mid_CmdBufferFlush, changed
+									and read with INFRA_ATOMIC_xxx */
+	uint64				noOfBytesWritten;	/* as noOfWrites */
+	MID_WRITE_HOOK		writeHook;	/* NULL if not needed */
+	void				*hookContext;	/* passed to writeHook */
+}MidCmdBuffer;
+
+/* Clock settings of a MPSSE channel, as found by Mid_SolveClock. A rate of 0 means that the
+settings of the chip are not known */
+typedef struct MidClock_t
+{
+	uint32	clockOptions;	/* MID_CLOCK_xxx */
+	bool	divideBy5;		/* master clock divided by 5(12MHz instead of 60MHz) */
+	uint16	divisor;		/* value of the clock command */
+	uint32	rate;			/* SCLK in Hz that the settings give */
+}MidClock;
+
+/* Last values and directions written to the low and high byte of a MPSSE channel(value in
+the upper and direction in the lower 8 bits), so that writes that change nothing can be left
+out. A byte that is not known is written the next time */
+typedef struct MidPins_t
+{
+	uint16	low;		/* ADBUS, MPSSE_CMD_SET_DATA_BITS_LOWBYTE */
+	uint16	high;		/* ACBUS, MPSSE_CMD_SET_DATA_BITS_HIGHBYTE */
+	bool	lowKnown;
+	bool	highKnown;
+}MidPins;
+
+/* Devices connected to the host system as found by the last enumeration. deviceIndex maps the
+index of each MPSSE channel(0 based) to its entry in devices. The list is rebuilt when it is
+not valid or when FT_RefreshChannelList is called */
+typedef struct MidChannelList_t
+{
+	InfraMutex					lock;
+	bool						valid;
+	uint32						capacity;	/* number of entries allocated */
+	uint32						numDevices;
+	uint32						numChannels;
+	FT_DEVICE_LIST_INFO_NODE	*devices;
+	uint32						*deviceIndex;
+}MidChannelList;
+
 FT_STATUS FT_GetNumChannels(FT_LegacyProtocol Protocol,uint32 *numChans);
 FT_STATUS FT_GetChannelInfo(FT_LegacyProtocol Protocol, uint32 index,
 			FT_DEVICE_LIST_INFO_NODE *chanInfo);
 FT_STATUS FT_OpenChannel(FT_LegacyProtocol Protocol, uint32 index,
 			FT_HANDLE *handle);
+FT_STATUS FT_OpenChannelEx(FT_LegacyProtocol Protocol, PVOID arg, DWORD flags,
+			FT_HANDLE *handle);
 FT_STATUS FT_InitChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle,...);
 FT_STATUS FT_CloseChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle);
+FT_STATUS FT_RefreshChannelList(FT_LegacyProtocol Protocol);
 FT_STATUS FT_Channel_Read(FT_LegacyProtocol Protocol, FT_HANDLE handle,
 				uint32 noOfBytes, uint8* buffer, uint32 *noOfBytesTransferred);
 FT_STATUS FT_Channel_Write(FT_LegacyProtocol Protocol, FT_HANDLE handle,
@@ -108,8 +211,15 @@ extern FT_STATUS Mid_SendReceiveCmdFromMPSSE(FT_HANDLE handle,UCHAR\
 	echoCmdFlag,UCHAR ecoCmd,UCHAR *cmdEchoed);
 extern FT_STATUS Mid_SetGPIOLow(FT_HANDLE handle, uint8 value, uint8 \
 	direction);
+extern void Mid_GetPinCmds(uint8 opcode, uint16 pinState, MidPins *current,
+	uint8 *buffer, uint32 *noOfBytes);
+extern void Mid_SetGPIOHook(MID_GPIO_HOOK hook);
 extern FT_STATUS Mid_SetClock(FT_HANDLE handle, FT_DEVICE ftDevice, uint32 \
 	clock);
+extern void Mid_SolveClock(FT_DEVICE ftDevice, uint32 clock, uint32 clockOptions,
+	MidClock *setting);
+extern void Mid_GetClockCmds(FT_DEVICE ftDevice, uint32 clock, uint32 clockOptions,
+	MidClock *current, uint8 *buffer, uint32 *noOfBytes);
 extern FT_STATUS Mid_GetFtDeviceType(FT_HANDLE handle,FT_DEVICE *ftDevice);
 extern FT_STATUS Mid_SetDeviceLoopbackState(FT_HANDLE handle,uint8 \
 	loopBackFlag);
@@ -117,6 +227,20 @@ extern FT_STATUS Mid_EmptyDeviceInputBuff(FT_HANDLE handle);
 FTDI_API FT_STATUS FT_WriteGPIO(FT_HANDLE handle, uint8 dir, uint8 value);
 FTDI_API FT_STATUS FT_ReadGPIO(FT_HANDLE handle,uint8 *value);
 extern FT_STATUS Mid_GetQueueStatus(FT_HANDLE handle, LPDWORD lpdwAmountInRxQueue);
+extern uint32 Mid_GetFifoSize(FT_DEVICE ftDevice);
+extern FT_STATUS Mid_SetRxEvent(FT_HANDLE handle, InfraEvent *event);
+extern FT_STATUS Mid_ChannelReadTimeout(FT_HANDLE handle, uint32 noOfBytes,
+	uint8 *buffer, uint32 *noOfBytesTransferred, uint32 timeout);
+extern FT_STATUS Mid_ChannelReadEvent(FT_HANDLE handle, InfraEvent *event,
+	uint32 noOfBytes, uint8 *buffer, uint32 *noOfBytesTransferred);
+extern FT_STATUS Mid_CmdBufferInit(MidCmdBuffer *cmdBuffer, FT_LegacyProtocol Protocol,
+	FT_HANDLE handle, uint32 size);
+extern void Mid_CmdBufferFree(MidCmdBuffer *cmdBuffer);
+extern FT_STATUS Mid_CmdBufferAppend(MidCmdBuffer *cmdBuffer, uint8 *data,
+	uint32 noOfBytes);
+extern FT_STATUS Mid_CmdBufferFlush(MidCmdBuffer *cmdBuffer);
+void Ftdi_Mid_Module_Init(void);
+void Ftdi_Mid_Module_Cleanup(void);
 
 #endif /* FTDI_MID_H */
 
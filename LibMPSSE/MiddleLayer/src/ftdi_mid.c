@@ -25,6 +25,21 @@
  * 0.21 - 20110708 - Added functions FT_ReadGPIO & FT_WriteGPIO
  * 0.3  - 20111103 - Added MPSSE_CMD_ENABLE_DRIVE_ONLY_ZERO
  * 0.41 - 20140903 - fixed compile warnings
+ * 0.5  - 20261015 - added MPSSE command buffer to coalesce commands into one USB transfer
+ *				  added event driven read(Mid_SetRxEvent & Mid_ChannelReadEvent)
+ *				  FT_InitChannel polls for the echo of a bad command instead of sleeping
+ *				  Mid_SendReceiveCmdFromMPSSE & Mid_EmptyDeviceInputBuff read into a buffer
+ *				  on the stack instead of allocating one, the sync gives up after
+ *				  MID_SYNC_TIMEOUT milliseconds instead of 4096 iterations
+ *				  Mid_CmdBufferFlush counts the writes and bytes it sends and calls the
+ *				  command buffer's writeHook
+ *				  added Mid_ChannelReadTimeout
+ *				  Mid_GetClockCmds selects three phase and adaptive clocking
+ *				  added Mid_SolveClock, the divisor is the nearest to the requested clock
+ *				  instead of a truncated one and FT2232D divides its 12MHz master clock
+ *				  added Mid_GetPinCmds
+ *				  added Mid_SetGPIOHook, FT_WriteGPIO lets the protocol layer keep its pins
+ *				  Mid_CmdBufferFlush counts with INFRA_ATOMIC_ADD32/64
  */
 
 
@@ -40,21 +55,30 @@
 /******************************************************************************/
 /*								Macro defines					  			  */
 /******************************************************************************/
-
+/*Read timeout that FT_InitChannel gives to the channels*/
+#ifdef FT800_HACK
+#define MID_READ_TIMEOUT	DEVICE_READ_TIMEOUT_INFINITE
+#else
+#define MID_READ_TIMEOUT	DEVICE_READ_TIMEOUT
+#endif
 
 
 
 /******************************************************************************/
 /*								Local function declarations					  */
 /******************************************************************************/
-
+FT_STATUS Mid_UpdateChannelList(bool refresh);
 
 
 
 /******************************************************************************/
 /*								Global variables							  */
 /******************************************************************************/
-
+/*Devices connected to the host and the MPSSE channels among them, as found by the last
+enumeration*/
+MidChannelList ChannelList;
+/*Called by FT_WriteGPIO before it writes the high byte, NULL if not set(Mid_SetGPIOHook)*/
+MID_GPIO_HOOK GPIOHook=NULL;
 
 
 /******************************************************************************/
@@ -80,66 +104,18 @@
  * \note FT2232H has 2 MPSSE ports
  * \note FT4232H has 4 ports but only 2 of them have MPSSEs
  * so a call to this function will return 2 if a FT4232 is connected to it.
+ * \note The channels are counted in the cached channel list(see FT_RefreshChannelList)
  * \warning
  */
 FT_STATUS FT_GetNumChannels(FT_LegacyProtocol Protocol, uint32 *numChans)
 {
-	DWORD tempNumChannels;
-	FT_DEVICE_LIST_INFO_NODE *pDeviceList;
-	FT_DEVICE_LIST_INFO_NODE deviceList;
-
 	FT_STATUS status;
-	uint32 devLoop = MID_NO_CHANNEL_FOUND;
-	//bool ret;
 
 	FN_ENTER;
-	/*initalize *numChansto 0 */
-	*numChans = MID_NO_CHANNEL_FOUND;
-	/*Get the number of devices connected to the system(FT_CreateDeviceInfoList)*/
-	status = varFunctionPtrLst.p_FT_GetNumChannel(&tempNumChannels);
-//	printf("\n status=0x%x     tempNumChannels=%d\n",status,tempNumChannels);
-	/*Check if the status is Ok */
-	if(status == FT_OK)
-	{
-
-		/*Check if No of channel is greater than 0*/
-		if(tempNumChannels > MID_NO_CHANNEL_FOUND)
-		{
-			/*Allocate space for getting the information about the device (based on
-			number of devices)*/
-			pDeviceList = INFRA_MALLOC(sizeof(FT_DEVICE_LIST_INFO_NODE)\
-				*tempNumChannels);
-			if(NULL == pDeviceList)
-			{
-				return FT_INSUFFICIENT_RESOURCES;
-			}
-			/*get the devices information(FT_GetDeviceInfoList)*/
-			status = varFunctionPtrLst.p_FT_GetDeviceInfoList(pDeviceList,\
-				&tempNumChannels);
-			while(devLoop < tempNumChannels)
-			{
-				deviceList = pDeviceList[devLoop];
-				/*check if device is I2C*/
-				//ret = midCheckI2C(deviceList);
-				if(Mid_CheckMPSSEAvailable(deviceList))
-				{
-					/*increment *numChans*/
-					*numChans = *numChans + 1;
-				}
-				devLoop++;
-			}
-			INFRA_FREE(pDeviceList);
-		}
-		else
-		{
-			*numChans = tempNumChannels;
-			//resource Not found		MID_T0DO
-        }
-	}
-	else
-	{
-		*numChans = tempNumChannels;
-	}
+	INFRA_MUTEX_LOCK(&ChannelList.lock);
+	status = Mid_UpdateChannelList(FALSE);
+	*numChans = (FT_OK == status)?ChannelList.numChannels:MID_NO_CHANNEL_FOUND;
+	INFRA_MUTEX_UNLOCK(&ChannelList.lock);
 	/*return status*/
 	FN_EXIT;
 	return status;
@@ -160,68 +136,30 @@ FT_STATUS FT_GetNumChannels(FT_LegacyProtocol Protocol, uint32 *numChans)
  * \return status
  * \sa
  * \note memory should be allocated and freed by caller
+ * \note The information comes from the cached channel list. The flags and handle are kept
+ * up to date for channels opened and closed through this library only
  * \warning
  */
 FT_STATUS FT_GetChannelInfo(FT_LegacyProtocol Protocol, uint32 index,
 			FT_DEVICE_LIST_INFO_NODE *chanInfo)
 {
-	DWORD tempNumChannels;
-	uint32 channelCount;
-	FT_DEVICE_LIST_INFO_NODE *pDeviceList;
-	FT_DEVICE_LIST_INFO_NODE deviceList;
-
 	FT_STATUS status;
-	uint32 devLoop = MID_NO_CHANNEL_FOUND;
 
 	FN_ENTER;
-
-	/*initalize *numChansto 0 */
-	channelCount = MID_NO_CHANNEL_FOUND;
-
-	/*Get the number of devices connected to the system(FT_CreateDeviceInfoList)*/
-	status = varFunctionPtrLst.p_FT_GetNumChannel(&tempNumChannels);
-	CHECK_STATUS(status);
-
-	/*Check if No of channel is greater than 0*/
-	if(tempNumChannels >= index)
+	INFRA_MUTEX_LOCK(&ChannelList.lock);
+	status = Mid_UpdateChannelList(FALSE);
+	if((FT_OK == status) && \
+		((index < 1) || (index > ChannelList.numChannels)))
 	{
-		/*Allocate space for getting the information about the device (based on
-		number of devices)*/
-		pDeviceList = INFRA_MALLOC(sizeof(FT_DEVICE_LIST_INFO_NODE)\
-			*tempNumChannels);
-		if(NULL == pDeviceList)
-		{
-			return FT_INSUFFICIENT_RESOURCES;
-		}
-
-		/*get the devices information(FT_GetDeviceInfoList)*/
-		status = varFunctionPtrLst.p_FT_GetDeviceInfoList(pDeviceList,\
-			&tempNumChannels);
-		CHECK_STATUS(status);
-
-		while(devLoop < tempNumChannels)
-		{
-			deviceList = pDeviceList[devLoop];
-			if(Mid_CheckMPSSEAvailable(deviceList))
-			{
-				/*increment *numChans*/
-				channelCount++;
-			}
-			/*check if the index matches the I2C channel count*/
-			if(channelCount == index)
-			{
-				INFRA_MEMCPY(chanInfo,&deviceList,sizeof(FT_DEVICE_LIST_INFO_NODE));
-				break;
-			}
-			devLoop++;
-		}
-		INFRA_FREE(pDeviceList);
+		/* The index of the device is greater than the max number of devices available */
+		status = FT_INVALID_HANDLE;
 	}
-	else
+	if(FT_OK == status)
 	{
-		/* The index of the device is greater than the max number of devices available */
-		return FT_INVALID_HANDLE;
+		INFRA_MEMCPY(chanInfo,&ChannelList.devices[ChannelList.deviceIndex[index-1]],\
+			sizeof(FT_DEVICE_LIST_INFO_NODE));
 	}
+	INFRA_MUTEX_UNLOCK(&ChannelList.lock);
 	FN_EXIT;
 
 	/*return status*/
@@ -240,75 +178,155 @@ FT_STATUS FT_GetChannelInfo(FT_LegacyProtocol Protocol, uint32 index,
  * \return status
  * \sa
  * \note Trying to open an already open channel will return an error code
+ * \note If the device of the channel cannot be opened the channel list is rebuilt, in case
+ * devices have been plugged or unplugged, and the open is retried once
  * \warning
  */
 FT_STATUS FT_OpenChannel(FT_LegacyProtocol Protocol, uint32 index,
 			FT_HANDLE *handle)
 {
 	/* Opens a channel and returns the pointer to its handle */
-	DWORD tempNumChannels;
-	uint32 channelCount;
-	FT_DEVICE_LIST_INFO_NODE *pDeviceList;
-	FT_DEVICE_LIST_INFO_NODE deviceList;
-
 	FT_STATUS status;
-	uint32 devLoop = MID_NO_CHANNEL_FOUND;
+	uint32 devIndex;
+	bool refresh=FALSE;
 	FN_ENTER;
 
-	/*initalize *numChansto 0 */
-	channelCount = MID_NO_CHANNEL_FOUND;
-
-	/*Get the number of devices connected to the system(FT_CreateDeviceInfoList)*/
-	status = varFunctionPtrLst.p_FT_GetNumChannel(&tempNumChannels);
-	CHECK_STATUS(status);
-
-	/*Check if No of channel is greater than 0*/
-	if(tempNumChannels >= index)
+	INFRA_MUTEX_LOCK(&ChannelList.lock);
+	do
 	{
-		/*Allocate space for getting the information about the device (based on
-		number of devices)*/
-		pDeviceList = INFRA_MALLOC(sizeof(FT_DEVICE_LIST_INFO_NODE)\
-			*tempNumChannels);
-		if(NULL == pDeviceList)
+		status = Mid_UpdateChannelList(refresh);
+		if((FT_OK == status) && \
+			((index < 1) || (index > ChannelList.numChannels)))
 		{
-			return FT_INSUFFICIENT_RESOURCES;
+			/* The index of the device is greater than the max number of devices available */
+			status = FT_INVALID_HANDLE;
 		}
-		/*get the devices information(FT_GetDeviceInfoList)*/
-		status = varFunctionPtrLst.p_FT_GetDeviceInfoList(pDeviceList,\
-			&tempNumChannels);
-		CHECK_STATUS(status);
-
-		/*loop until No of devices */
-		while(devLoop < tempNumChannels)
+		if(FT_OK == status)
 		{
-			deviceList = pDeviceList[devLoop];
-			/*check if device is I2C*/
-			if(Mid_CheckMPSSEAvailable(deviceList))
+			/*call FT_Open*/
+			devIndex = ChannelList.deviceIndex[index-1];
+			status = varFunctionPtrLst.p_FT_Open(devIndex,handle);
+			if(FT_OK == status)
 			{
-				/*increment *numChans*/
-				channelCount++;
+				ChannelList.devices[devIndex].Flags |= FT_FLAGS_OPENED;
+				ChannelList.devices[devIndex].ftHandle = *handle;
 			}
-			/*check if the index matches the I2C channel count*/
-			if(channelCount == index)
-			{
-				/*call FT_Open*/
-				status = varFunctionPtrLst.p_FT_Open(devLoop,handle);
+		}
+		refresh = !refresh;
+	}while((FT_OK != status) && refresh);
+	INFRA_MUTEX_UNLOCK(&ChannelList.lock);
+	FN_EXIT;
+	/*return status*/
+	return status;
+}
+
+/*!
+ * \brief Opens a channel by serial number, description or location
+ *
+ * This function opens the channel directly through FT_OpenEx, without enumerating the devices
+ * connected to the host system, and checks that the port that was opened has a MPSSE
+ *
+ * \param[in] Protocol Specifies the protocol type(I2C/SPI/JTAG)
+ * \param[in] arg Serial number or description string, or the location ID cast to PVOID
+ * \param[in] flags FT_OPEN_BY_SERIAL_NUMBER, FT_OPEN_BY_DESCRIPTION or FT_OPEN_BY_LOCATION
+ * \param[out] handle Pointer to the handle
+ * \return status. FT_NOT_SUPPORTED if the port has no MPSSE(eg: port C of a FT4232H)
+ * \sa FT_OpenChannel
+ * \note The port of a multi port chip is given by the last character(A-D) of its serial
+ * number. If the channel is in the cached channel list then its entry is marked as opened
+ * \warning
+ */
+FT_STATUS FT_OpenChannelEx(FT_LegacyProtocol Protocol, PVOID arg, DWORD flags,
+			FT_HANDLE *handle)
+{
+	FT_STATUS status;
+	FT_DEVICE ftDevice;
+	DWORD deviceID;
+	char serialNumber[64];
+	char description[64];
+	char port;
+	bool isMPSSEAvailable;
+	uint32 devLoop;
+	FN_ENTER;
+
+	status = varFunctionPtrLst.p_FT_OpenEx(arg,flags,handle);
+	CHECK_STATUS(status);
+	serialNumber[0] = '\0';
+	status = varFunctionPtrLst.p_FT_GetDeviceInfo(*handle,&ftDevice,&deviceID,\
+		(PCHAR)serialNumber,(PCHAR)description,NULL);
+	if(FT_OK == status)
+	{
+		/* Same rule as Mid_CheckMPSSEAvailable, with the port taken from the serial number
+		instead of the location ID */
+		port = ('\0' == serialNumber[0])?'A':serialNumber[strlen(serialNumber)-1];
+		switch(ftDevice)
+		{
+			case FT_DEVICE_2232C:
+				isMPSSEAvailable = ('A' == port)?MID_MPSSE_AVAILABLE:MID_NO_MPSSE;
+				break;
+			case FT_DEVICE_2232H:
+			case FT_DEVICE_4232H:
+				isMPSSEAvailable = (('A' == port) || ('B' == port))?\
+					MID_MPSSE_AVAILABLE:MID_NO_MPSSE;
+				break;
+			case FT_DEVICE_232H:
+				isMPSSEAvailable = MID_MPSSE_AVAILABLE;
+				break;
+			default:
+				isMPSSEAvailable = MID_NO_MPSSE;
 				break;
-			}
-			devLoop++;
 		}
-		INFRA_FREE(pDeviceList);
+		if(MID_NO_MPSSE == isMPSSEAvailable)
+		{
+			DBG(MSG_ERR,"%s(type 0x%x) has no MPSSE\n",serialNumber,(unsigned)ftDevice);
+			status = FT_NOT_SUPPORTED;
+		}
 	}
-	else
+	if(FT_OK != status)
 	{
-		/* The index of the device is greater than the max number of devices available */
-		return FT_INVALID_HANDLE;
+		varFunctionPtrLst.p_FT_Close(*handle);
+		*handle = NULL;
+		return status;
+	}
+
+	INFRA_MUTEX_LOCK(&ChannelList.lock);
+	for(devLoop=0;ChannelList.valid && (devLoop<ChannelList.numDevices);devLoop++)
+	{
+		if(0 == strcmp((char*)ChannelList.devices[devLoop].SerialNumber,serialNumber))
+		{
+			ChannelList.devices[devLoop].Flags |= FT_FLAGS_OPENED;
+			ChannelList.devices[devLoop].ftHandle = *handle;
+		}
 	}
+	INFRA_MUTEX_UNLOCK(&ChannelList.lock);
 	FN_EXIT;
-	/*return status*/
 	return status;
 }
 
+/*!
+ * \brief Rebuilds the channel list
+ *
+ * This function enumerates the devices connected to the host system again and rebuilds the
+ * cached list of MPSSE channels that FT_GetNumChannels, FT_GetChannelInfo and FT_OpenChannel
+ * work on
+ *
+ * \param[in] Protocol Specifies the protocol type(I2C/SPI/JTAG)
+ * \return status
+ * \sa Mid_UpdateChannelList
+ * \note Should be called when devices are plugged or unplugged, for example from the hotplug
+ * notification of the operating system
+ * \warning
+ */
+FT_STATUS FT_RefreshChannelList(FT_LegacyProtocol Protocol)
+{
+	FT_STATUS status;
+	FN_ENTER;
+	INFRA_MUTEX_LOCK(&ChannelList.lock);
+	status = Mid_UpdateChannelList(TRUE);
+	INFRA_MUTEX_UNLOCK(&ChannelList.lock);
+	FN_EXIT;
+	return status;
+}
 
 /*!
  * \brief Initializes a channel
@@ -338,6 +356,7 @@ FT_STATUS FT_InitChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle,...)
 	uint32	clockRate,latencyTimer,configOptions;
 	FT_STATUS status;
 	FT_DEVICE ftDevice;
+	UCHAR cmdEchoed;
 
 	FN_ENTER;
 
@@ -378,7 +397,7 @@ FT_STATUS FT_InitChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle,...)
 		/*DEVICE_READ_TIMEOUT_INFINITE*/,DEVICE_WRITE_TIMEOUT);
 	CHECK_STATUS(status);
 #else
-	status = Mid_SetDeviceTimeOut(handle, 5000 \
+	status = Mid_SetDeviceTimeOut(handle, DEVICE_READ_TIMEOUT \
 		/*DEVICE_READ_TIMEOUT_INFINITE*/,DEVICE_WRITE_TIMEOUT);
 	CHECK_STATUS(status);
 #endif
@@ -397,13 +416,19 @@ FT_STATUS FT_InitChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle,...)
 	/*Sync MPSSE */
 	status = Mid_SyncMPSSE(handle);
 	CHECK_STATUS(status);
-	/*wait for USB*/
-	INFRA_SLEEP(50);
 	/*set Clock frequency*/
 	status = Mid_SetClock(handle, ftDevice, clockRate);
 	CHECK_STATUS(status);
 	DBG(MSG_INFO, "Mid_SetClock Status Ok return 0x%x\n",(unsigned)status);
-	INFRA_SLEEP(20);
+	/*The MPSSE executes commands in order, so the echo of a bad command sent after the clock
+	command shows that the clock has been set. This replaces fixed sleeps of 70ms*/
+	status = Mid_SendReceiveCmdFromMPSSE(handle,MID_ECHO_COMMAND_ONCE,\
+		MID_ECHO_CMD_2,&cmdEchoed);
+	CHECK_STATUS(status);
+	if(cmdEchoed != MID_CMD_ECHOED)
+	{
+		return FT_OTHER_ERROR;
+	}
 	/*Stop Loop back*/
 	status = Mid_SetDeviceLoopbackState(handle,MID_LOOPBACK_FALSE);
 	CHECK_STATUS(status);
@@ -480,8 +505,22 @@ FT_STATUS FT_InitChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle,...)
 FT_STATUS FT_CloseChannel(FT_LegacyProtocol Protocol, FT_HANDLE handle)
 {
 	FT_STATUS status;
+	uint32 devLoop;
 	FN_ENTER;
 	status = varFunctionPtrLst.p_FT_Close(handle);
+	if(FT_OK == status)
+	{
+		INFRA_MUTEX_LOCK(&ChannelList.lock);
+		for(devLoop=0;devLoop<ChannelList.numDevices;devLoop++)
+		{
+			if(ChannelList.devices[devLoop].ftHandle == handle)
+			{
+				ChannelList.devices[devLoop].Flags &= ~FT_FLAGS_OPENED;
+				ChannelList.devices[devLoop].ftHandle = NULL;
+			}
+		}
+		INFRA_MUTEX_UNLOCK(&ChannelList.lock);
+	}
 	FN_EXIT;
 	return status;
 }
@@ -925,85 +964,80 @@ FT_STATUS Mid_SendReceiveCmdFromMPSSE(FT_HANDLE handle, UCHAR echoCmdFlag,UCHAR
 	DWORD bytesWritten;
 	DWORD byteCounter;
 	UCHAR cmdResponse = MID_CMD_NOT_ECHOED;
-	int loopCounter = 0;
-	UCHAR *readBuffer=NULL;
+	uint32 startTime;
+	UCHAR readBuffer[MID_SCRATCH_BUF_SIZE];
+	UCHAR cmd[2];
 
 	FN_ENTER;
-	readBuffer = (UCHAR*)INFRA_MALLOC(MID_MAX_IN_BUF_SIZE);
-	if(NULL == readBuffer)
-	{
-		return FT_INSUFFICIENT_RESOURCES;
-	}
 	/*initialize cmdEchoed to MID_CMD_NOT_ECHOED*/
 	*cmdEchoed = MID_CMD_NOT_ECHOED;
+	/*the response is sent back without waiting for the latency timer*/
+	cmd[0] = ecoCmd;
+	cmd[1] = MPSSE_CMD_SEND_IMMEDIATE;
 	/* check whether command has to be sent only once*/
 	if (echoCmdFlag == MID_ECHO_COMMAND_ONCE)
 	{
-		status = varFunctionPtrLst.p_FT_Write(handle,&ecoCmd,1,&bytesWritten);
+		status = varFunctionPtrLst.p_FT_Write(handle,cmd,2,&bytesWritten);
 		CHECK_STATUS(status);
 	}
 
+	startTime = Infra_GetTickCount();
 	do
 	{
-		DBG(MSG_DEBUG,"In Loop Mid_SendReceiveCmdFromMPSSE loopCounter = %d \n"\
-			,loopCounter);
 		/*check whether command has to be sent every time in the loop*/
 		if(echoCmdFlag == MID_ECHO_COMMAND_CONTINUOUSLY)
 		{
-		  status = varFunctionPtrLst.p_FT_Write(handle,&ecoCmd,1,&bytesWritten);
-		 CHECK_STATUS(status);
+			status = varFunctionPtrLst.p_FT_Write(handle,cmd,2,&bytesWritten);
+			CHECK_STATUS(status);
 		}
 		/*read the no of bytes available in Receive buffer*/
 		status = varFunctionPtrLst.p_FT_GetQueueStatus(handle,&bytesInInputBuf);
 		CHECK_STATUS(status);
-		INFRA_SLEEP(1);
 		DBG(MSG_DEBUG,"bytesInInputBuf size =  %d\n",bytesInInputBuf);
-		if(bytesInInputBuf >0)
+		if(0 == bytesInInputBuf)
 		{
-			MID_CHK_IN_BUF_OK(bytesInInputBuf);
-			status = varFunctionPtrLst.p_FT_Read(handle,readBuffer,bytesInInputBuf,&numOfBytesRead);
+			/*poll again after a while*/
+			INFRA_SLEEP(1);
+		}
+		/*scan what has arrived in pieces of the size of readBuffer, cmdResponse carries
+		a 0xFA at the end of one piece over to the next one*/
+		while((bytesInInputBuf > 0) && (*cmdEchoed == MID_CMD_NOT_ECHOED))
+		{
+			status = varFunctionPtrLst.p_FT_Read(handle,readBuffer,\
+				(bytesInInputBuf > MID_SCRATCH_BUF_SIZE)?MID_SCRATCH_BUF_SIZE:\
+				bytesInInputBuf,&numOfBytesRead);
 			CHECK_STATUS(status);
-			if(numOfBytesRead >0)
+			if(0 == numOfBytesRead)
+				break;
+			bytesInInputBuf -= numOfBytesRead;
+			for(byteCounter = 0; (byteCounter < numOfBytesRead) && \
+				(*cmdEchoed == MID_CMD_NOT_ECHOED); byteCounter++)
 			{
-				byteCounter = 0;
-				do
+				if(readBuffer[byteCounter]==MID_BAD_COMMAND_RESPONSE)
 				{
-					if(byteCounter <= (numOfBytesRead-1))
+					cmdResponse = MID_BAD_COMMAND_RESPONSE;
+				}
+				else
+				{
+					if((cmdResponse == MID_BAD_COMMAND_RESPONSE) && \
+						(readBuffer[byteCounter]==ecoCmd))
 					{
-						if(readBuffer[byteCounter]==MID_BAD_COMMAND_RESPONSE)
-						{
-							cmdResponse = MID_BAD_COMMAND_RESPONSE;
-						}
-						else
-						{
-							if(cmdResponse == MID_BAD_COMMAND_RESPONSE)
-							{
-								if(readBuffer[byteCounter]==ecoCmd)
-								{
-									*cmdEchoed = MID_CMD_ECHOED;
-								}
-							}
-							cmdResponse = MID_CMD_NOT_ECHOED;
-						}
+						*cmdEchoed = MID_CMD_ECHOED;
 					}
-					byteCounter++;
-				}while((byteCounter < bytesInInputBuf)&&(*cmdEchoed == MID_CMD_NOT_ECHOED));
+					cmdResponse = MID_CMD_NOT_ECHOED;
+				}
 			}
 		}
 
 		/*for breaking the loop */
-		loopCounter++;
-		if(loopCounter > MID_MAX_IN_BUF_SIZE)
+		if((*cmdEchoed == MID_CMD_NOT_ECHOED) && \
+			((uint32)(Infra_GetTickCount() - startTime) > MID_SYNC_TIMEOUT))
 		{
-			DBG(MSG_DEBUG,"Loop breaked after executing %u times\n",(unsigned)MID_MAX_IN_BUF_SIZE);
+			DBG(MSG_DEBUG,"No echo after %u milliseconds\n",(unsigned)MID_SYNC_TIMEOUT);
 			status = FT_OTHER_ERROR;
 			break;
 		}
 	}while((*cmdEchoed == MID_CMD_NOT_ECHOED) && (status == FT_OK));
-	if(NULL != readBuffer)
-	{
-		INFRA_FREE(readBuffer);//Bug12
-	}
 	FN_EXIT;
 	return status;
 }
@@ -1043,6 +1077,47 @@ FT_STATUS Mid_SetGPIOLow(FT_HANDLE handle, uint8 value, uint8 direction)
 
 }
 
+/*!
+ * \brief Provides the MPSSE command that sets the values and directions of a byte of pins
+ *
+ * This function provides the command that sets the low or the high byte of pins to the given
+ * state, unless the chip is known to have that state already, in which case no command is
+ * provided. The state that the chip will have is saved in *current
+ *
+ * \param[in] opcode MPSSE_CMD_SET_DATA_BITS_LOWBYTE or MPSSE_CMD_SET_DATA_BITS_HIGHBYTE
+ * \param[in] pinState Values in the upper and directions in the lower 8 bits
+ * \param[in,out] current Pin states of the chip, NULL if they are not known
+ * \param[out] buffer Buffer of at least 3 bytes to which the command is written
+ * \param[out] noOfBytes Pointer to variable in which the number of bytes written(0 or 3) is
+ *			returned
+ * \return none
+ * \sa Mid_GetClockCmds
+ * \note The values of the pins that are inputs are compared too, since the chip keeps them
+ *		for when the pins are made outputs
+ * \warning
+ */
+void Mid_GetPinCmds(uint8 opcode, uint16 pinState, MidPins *current,
+	uint8 *buffer, uint32 *noOfBytes)
+{
+	uint16 *state=NULL;
+	bool *known=NULL;
+
+	*noOfBytes = 0;
+	if(NULL != current)
+	{
+		state = (MPSSE_CMD_SET_DATA_BITS_HIGHBYTE == opcode)?&current->high:&current->low;
+		known = (MPSSE_CMD_SET_DATA_BITS_HIGHBYTE == opcode)?&current->highKnown:\
+			&current->lowKnown;
+		if(*known && (*state == pinState))
+			return;
+		*state = pinState;
+		*known = TRUE;
+	}
+	buffer[(*noOfBytes)++] = opcode;
+	buffer[(*noOfBytes)++] = (uint8)((pinState & 0xFF00)>>8);/*Val*/
+	buffer[(*noOfBytes)++] = (uint8)(pinState & 0x00FF);/*Dir*/
+}
+
 FT_STATUS Mid_GetFtDeviceType(FT_HANDLE handle, FT_DEVICE *ftDevice)
 {
 	FT_STATUS status = FT_OTHER_ERROR;
@@ -1102,65 +1177,143 @@ FT_STATUS Mid_GetFtDeviceType(FT_HANDLE handle, FT_DEVICE *ftDevice)
  * \param[in] handle Handle of the channel
  * \param[in] clock Clock value to be set
  * \return status
- * \sa
+ * \sa Mid_GetClockCmds
  * \note
  * \warning
  */
 FT_STATUS Mid_SetClock(FT_HANDLE handle, FT_DEVICE ftDevice, uint32 clock)
 {
-	UCHAR inputBuffer[10];
+	UCHAR inputBuffer[MID_CLOCK_CMDS_SIZE];
 	DWORD bytesWritten = 0;
-	DWORD bufIdx = 0;
-	uint8 valueH, valueL;
-	uint32 value;
-	FT_STATUS status;
+	uint32 bufIdx = 0;
 
 	FN_ENTER;
-	switch(ftDevice)
-	{
-		case FT_DEVICE_2232C:/* This is actually FT2232D but defined is FT_DEVICE_2232C
-			in D2XX. Also, it is the only FS device that supports MPSSE */
-			value = (MID_30MHZ/clock) - 1;
-			break;
+	Mid_GetClockCmds(ftDevice,clock,0,NULL,inputBuffer,&bufIdx);
+	DBG(MSG_DEBUG,"handle=0x%x clock=%u\n",(unsigned)handle,(unsigned)clock);
+	FN_EXIT;
+	return varFunctionPtrLst.p_FT_Write(handle,inputBuffer,bufIdx,&bytesWritten);
+}
 
-		default:/* Assuming all new chips will he HS MPSSE devices */
-			DBG(MSG_DEBUG,"Unknown device type(0x%x). Assuming high speed device",(unsigned)ftDevice);
-			/* Fall through */
-		case FT_DEVICE_2232H:
-		case FT_DEVICE_4232H:
-		case FT_DEVICE_232H:
-			if(clock <= MID_6MHZ)
-			{
-				DBG(MSG_DEBUG,"handle=0x%x value=0x%x ENABLE_CLOCK_DIVIDE\n",\
-					(unsigned)handle,(unsigned)value);
-				value = ENABLE_CLOCK_DIVIDE;
-				status = varFunctionPtrLst.p_FT_Write(handle,&value,1,\
-					&bytesWritten);
-				CHECK_STATUS(status);
-				value = (MID_6MHZ/clock) - 1;
-			}
-			else
+/*!
+ * \brief Finds the clock settings that come closest to a clock rate
+ *
+ * This function finds the divisor, and for high speed chips whether the master clock is
+ * divided by 5, whose SCLK is nearest to the requested one. SCLK is 60MHz or 12MHz/
+ * ((1+divisor)*2) on high speed chips, 1.5 times slower with three phase clocking, and
+ * 12MHz/((1+divisor)*2) on FT2232D
+ *
+ * \param[in] ftDevice Type of the chip
+ * \param[in] clock Clock rate requested in Hz
+ * \param[in] clockOptions MID_CLOCK_3PHASE and/or MID_CLOCK_ADAPTIVE, ignored for FT2232D
+ * \param[out] setting Settings found, setting->rate is the SCLK that they give
+ * \return none
+ * \sa Mid_GetClockCmds
+ * \note The rate found may be faster or slower than the one requested, whichever is
+ *		nearer. Of two settings that are as close, the faster one is taken, and the one that
+ *		does not divide the master clock
+ * \warning
+ */
+void Mid_SolveClock(FT_DEVICE ftDevice, uint32 clock, uint32 clockOptions,
+	MidClock *setting)
+{
+	uint32 base,steps,rate,error,bestError=0xFFFFFFFF;
+	uint32 i,j;
+
+	setting->rate = 0;
+	setting->clockOptions = (FT_DEVICE_2232C == ftDevice)?0:clockOptions;
+	for(i=0;i<2;i++)
+	{
+		if(FT_DEVICE_2232C == ftDevice)
+		{/* master clock of 12MHz, there is no divide by 5 to select */
+			if(i > 0)
+				break;
+			base = MID_6MHZ;
+		}
+		else if(clockOptions & MID_CLOCK_3PHASE)
+			base = (0 == i)?MID_20MHZ:MID_4MHZ;
+		else
+			base = (0 == i)?MID_30MHZ:MID_6MHZ;
+		/* The rate is base/steps, which is not linear in steps, so rounding the period to
+		the nearest step does not give the nearest rate. Try the number of base cycles per
+		SCLK cycle rounded down and rounded up */
+		for(j=0;j<2;j++)
+		{
+			steps = (clock > 0)?(base/clock + j):(MID_MAX_CLOCK_DIVISOR+1);
+			if(steps < 1)
+				steps = 1;
+			if(steps > (MID_MAX_CLOCK_DIVISOR+1))
+				steps = MID_MAX_CLOCK_DIVISOR+1;
+			rate = base/steps;
+			error = (rate > clock)?(rate - clock):(clock - rate);
+			if(error < bestError)
 			{
-				DBG(MSG_DEBUG,"handle=0x%x value=0x%x DISABLE_CLOCK_DIVIDE\n",\
-					(unsigned)handle,(unsigned)value);
-				value = DISABLE_CLOCK_DIVIDE;
-				status = varFunctionPtrLst.p_FT_Write(handle,&value,1,\
-					&bytesWritten);
-				CHECK_STATUS(status);
-				value = (MID_30MHZ/clock) - 1;
+				bestError = error;
+				setting->divideBy5 = (i > 0)?TRUE:FALSE;
+				setting->divisor = (uint16)(steps - 1);
+				setting->rate = rate;
 			}
-			break;
+		}
 	}
-	/*calculate valueH and ValueL*/
-	valueL = (uint8)value;
-	valueH = (uint8)(value>>8);
-	/*set the clock*/
-	inputBuffer[bufIdx++] = MID_SET_CLOCK_FREQUENCY_CMD;
-	DBG(MSG_DEBUG,"valueL=0x%x valueH=0x%x \n",valueL,valueH);
-	inputBuffer[bufIdx++] = valueL;
-	inputBuffer[bufIdx++] = valueH;
-	FN_EXIT;
-	return varFunctionPtrLst.p_FT_Write(handle,inputBuffer,bufIdx,&bytesWritten);
+	DBG(MSG_DEBUG,"clock=%u rate=%u divisor=%u divideBy5=%u\n",(unsigned)clock,\
+		(unsigned)setting->rate,(unsigned)setting->divisor,(unsigned)setting->divideBy5);
+}
+
+/*!
+ * \brief Provides the MPSSE commands that set the clock
+ *
+ * This function finds the settings for the clock requested for the given device type and
+ * provides the commands that set them, so that the clock can be changed in the middle of a
+ * stream of commands. When the current settings of the chip are given, only the commands
+ * for the settings that differ are provided, which may be none
+ *
+ * \param[in] ftDevice Type of the chip
+ * \param[in] clock Clock value to be set
+ * \param[in] clockOptions MID_CLOCK_3PHASE and/or MID_CLOCK_ADAPTIVE, ignored for FT2232D
+ * \param[in,out] current Settings of the chip, updated to the new ones. NULL or a rate of 0
+ *			if they are not known
+ * \param[out] buffer Buffer of at least MID_CLOCK_CMDS_SIZE bytes to which the commands are
+ *			written
+ * \param[out] noOfBytes Pointer to variable in which the number of bytes written is returned
+ * \return none
+ * \sa Mid_SetClock, Mid_SolveClock
+ * \note With three phase clocking the fastest clock is 20MHz
+ * \warning
+ */
+void Mid_GetClockCmds(FT_DEVICE ftDevice, uint32 clock, uint32 clockOptions,
+	MidClock *current, uint8 *buffer, uint32 *noOfBytes)
+{
+	uint32 bufIdx = 0;
+	MidClock setting;
+	bool known;
+
+	Mid_SolveClock(ftDevice,clock,clockOptions,&setting);
+	known = ((NULL != current) && (0 != current->rate))?TRUE:FALSE;
+	if(FT_DEVICE_2232C != ftDevice)
+	{/* FT2232D has no three phase or adaptive clocking and no divide by 5 command */
+		if(!known || ((current->clockOptions ^ setting.clockOptions) & MID_CLOCK_3PHASE))
+		{
+			buffer[bufIdx++] = (setting.clockOptions & MID_CLOCK_3PHASE)?\
+				MPSSE_CMD_ENABLE_3PHASE_CLOCKING:MPSSE_CMD_DISABLE_3PHASE_CLOCKING;
+		}
+		if(!known || ((current->clockOptions ^ setting.clockOptions) & MID_CLOCK_ADAPTIVE))
+		{
+			buffer[bufIdx++] = (setting.clockOptions & MID_CLOCK_ADAPTIVE)?\
+				MPSSE_CMD_ENABLE_ADAPTIVE_CLOCKING:MPSSE_CMD_DISABLE_ADAPTIVE_CLOCKING;
+		}
+		if(!known || (current->divideBy5 != setting.divideBy5))
+		{
+			buffer[bufIdx++] = setting.divideBy5?ENABLE_CLOCK_DIVIDE:DISABLE_CLOCK_DIVIDE;
+		}
+	}
+	if(!known || (current->divisor != setting.divisor))
+	{/*set the clock, valueL first*/
+		buffer[bufIdx++] = MID_SET_CLOCK_FREQUENCY_CMD;
+		buffer[bufIdx++] = (uint8)setting.divisor;
+		buffer[bufIdx++] = (uint8)(setting.divisor>>8);
+	}
+	if(NULL != current)
+		*current = setting;
+	*noOfBytes = bufIdx;
 }
 
 /*!
@@ -1208,45 +1361,25 @@ FT_STATUS Mid_SetDeviceLoopbackState(FT_HANDLE handle,uint8 loopBackFlag)
 FT_STATUS Mid_EmptyDeviceInputBuff(FT_HANDLE handle)
 {
 	FT_STATUS status;
-	UCHAR *readBuffer;
+	UCHAR readBuffer[MID_SCRATCH_BUF_SIZE];
 	DWORD bytesInInputBuf = 0;
 	DWORD numOfBytesRead = 0;
 
 	FN_ENTER;
-	readBuffer = (UCHAR*)INFRA_MALLOC(MID_MAX_IN_BUF_SIZE);
-	if(NULL == readBuffer)
-	{
-		return FT_INSUFFICIENT_RESOURCES;
-	}
 	status = varFunctionPtrLst.p_FT_GetQueueStatus(handle,&bytesInInputBuf);
 	CHECK_STATUS(status);
-	if(bytesInInputBuf > 0)
-	{
-		do
-		{
-			if(bytesInInputBuf >MID_MAX_IN_BUF_SIZE)
-			{
-				status = varFunctionPtrLst.p_FT_Read(handle,readBuffer,\
-					MID_MAX_IN_BUF_SIZE,&numOfBytesRead);
-				CHECK_STATUS(status);
-				bytesInInputBuf = bytesInInputBuf - numOfBytesRead;
-			}
-			else
-			{
-				status = varFunctionPtrLst.p_FT_Read(handle,readBuffer,\
-					bytesInInputBuf,&numOfBytesRead);
-				CHECK_STATUS(status);
-				bytesInInputBuf = bytesInInputBuf - numOfBytesRead;
-			}
-		}while((status == FT_OK)&&(bytesInInputBuf!=0));
-	}
-	if(NULL != readBuffer)
+	while((status == FT_OK)&&(bytesInInputBuf!=0))
 	{
-		INFRA_FREE(readBuffer);//Bug12
+		status = varFunctionPtrLst.p_FT_Read(handle,readBuffer,\
+			(bytesInInputBuf > MID_SCRATCH_BUF_SIZE)?MID_SCRATCH_BUF_SIZE:bytesInInputBuf,\
+			&numOfBytesRead);
+		CHECK_STATUS(status);
+		if(0 == numOfBytesRead)
+			break;
+		bytesInInputBuf = bytesInInputBuf - numOfBytesRead;
 	}
 	FN_EXIT;
 	return status;
-
 }
 
 
@@ -1259,8 +1392,8 @@ FT_STATUS Mid_EmptyDeviceInputBuff(FT_HANDLE handle)
  * \param[in] dir The direction of the 8 lines. 0 for in and 1 for out
  * \param[in] value Output state of the 8 GPIO lines
  * \return status
- * \sa
- * \note
+ * \sa Mid_SetGPIOHook
+ * \note Lines that the protocol layer uses, e.g. chip selects on ACBUS, are left as they are
  * \warning
  */
 FTDI_API FT_STATUS FT_WriteGPIO(FT_HANDLE handle, uint8 dir, uint8 value)
@@ -1271,6 +1404,8 @@ FTDI_API FT_STATUS FT_WriteGPIO(FT_HANDLE handle, uint8 dir, uint8 value)
 	uint32 bufIdx = 0;
 
 	FN_ENTER;
+	if(NULL != GPIOHook)
+		GPIOHook(handle,&dir,&value);
 #if 1 //def FT800_232HM
 	buffer[bufIdx++] = MPSSE_CMD_SET_DATA_BITS_HIGHBYTE;
 	buffer[bufIdx++] = value;
@@ -1334,6 +1469,20 @@ FTDI_API FT_STATUS FT_ReadGPIO(FT_HANDLE handle,uint8 *value)
 	return status;
 }
 
+/*!
+ * \brief Sets the function that FT_WriteGPIO calls before it writes the high byte
+ *
+ * \param[in] hook Function to be called, NULL for none
+ * \return none
+ * \sa FT_WriteGPIO
+ * \note Set by the protocol layer when the library is initialized
+ * \warning
+ */
+void Mid_SetGPIOHook(MID_GPIO_HOOK hook)
+{
+	GPIOHook = hook;
+}
+
 FT_STATUS Mid_GetQueueStatus(FT_HANDLE handle, LPDWORD lpdwAmountInRxQueue)
 {
 	FT_STATUS status;
@@ -1343,3 +1492,440 @@ FT_STATUS Mid_GetQueueStatus(FT_HANDLE handle, LPDWORD lpdwAmountInRxQueue)
 	return status;
 }
 
+/*!
+ * \brief Registers an event to be signalled when data is received
+ *
+ * This function asks D2XX to signal the event whenever data from the chip is queued in the
+ * driver for the channel
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] event Pointer to an event created with Infra_EventInit
+ * \return status
+ * \sa Mid_ChannelReadEvent
+ * \note
+ * \warning The event must not be destroyed while the channel is open
+ */
+FT_STATUS Mid_SetRxEvent(FT_HANDLE handle, InfraEvent *event)
+{
+	FT_STATUS status=FT_NOT_SUPPORTED;
+	FN_ENTER;
+	if(NULL != varFunctionPtrLst.p_FT_SetEventNotification)
+	{
+		status = varFunctionPtrLst.p_FT_SetEventNotification(handle,\
+			FT_EVENT_RXCHAR,INFRA_EVENT_PARAM(event));
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reads data from the channel with a read timeout of its own
+ *
+ * This function reads the specified number of bytes from the channel like FT_Channel_Read,
+ * but gives up after the given number of milliseconds instead of DEVICE_READ_TIMEOUT. The
+ * read timeout of the channel is restored before it returns
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] noOfBytes Number of bytes to be read
+ * \param[out] buffer Pointer to the buffer where data is to be read
+ * \param[out] noOfBytesTransferred The actual number of bytes read
+ * \param[in] timeout Read timeout in milliseconds
+ * \return status
+ * \sa FT_Channel_Read
+ * \note FT_OK is returned with less bytes read if the data does not arrive in time
+ * \warning
+ */
+FT_STATUS Mid_ChannelReadTimeout(FT_HANDLE handle, uint32 noOfBytes,
+	uint8 *buffer, uint32 *noOfBytesTransferred, uint32 timeout)
+{
+	FT_STATUS status;
+	FN_ENTER;
+	*noOfBytesTransferred = 0;
+	status = Mid_SetDeviceTimeOut(handle,timeout,DEVICE_WRITE_TIMEOUT);
+	CHECK_STATUS(status);
+	status = varFunctionPtrLst.p_FT_Read(handle,buffer,noOfBytes,\
+		(DWORD*)noOfBytesTransferred);
+	if(FT_OK == status)
+		status = Mid_SetDeviceTimeOut(handle,MID_READ_TIMEOUT,DEVICE_WRITE_TIMEOUT);
+	else
+		Mid_SetDeviceTimeOut(handle,MID_READ_TIMEOUT,DEVICE_WRITE_TIMEOUT);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reads data from the channel, sleeping on the receive event
+ *
+ * This function reads the specified number of bytes from the channel. Instead of blocking in
+ * FT_Read it reads only what is already queued in the driver and sleeps on the event
+ * registered with Mid_SetRxEvent while nothing is, so the caller wakes up as soon as the
+ * latency timer or SEND_IMMEDIATE delivers the data
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] event Pointer to the event registered with Mid_SetRxEvent
+ * \param[in] noOfBytes Number of bytes to be read
+ * \param[out] buffer Pointer to the buffer where data is to be read
+ * \param[out] noOfBytesTransferred The actual number of bytes read
+ * \return status
+ * \sa FT_Channel_Read
+ * \note Like FT_Channel_Read, FT_OK is returned with less bytes read if no data arrives for
+ *		DEVICE_READ_TIMEOUT milliseconds
+ * \warning
+ */
+FT_STATUS Mid_ChannelReadEvent(FT_HANDLE handle, InfraEvent *event,
+	uint32 noOfBytes, uint8 *buffer, uint32 *noOfBytesTransferred)
+{
+	FT_STATUS status=FT_OK;
+	DWORD available=0;
+	DWORD bytesRead;
+	bool signalled=TRUE;
+	FN_ENTER;
+
+	*noOfBytesTransferred = 0;
+	while((*noOfBytesTransferred < noOfBytes) && signalled)
+	{
+		/* The queue is checked with the event locked so that a signal is not lost */
+		Infra_EventLock(event);
+		status = varFunctionPtrLst.p_FT_GetQueueStatus(handle,&available);
+		if((FT_OK == status) && (0 == available))
+		{
+			signalled = Infra_EventWait(event,DEVICE_READ_TIMEOUT);
+			status = varFunctionPtrLst.p_FT_GetQueueStatus(handle,&available);
+		}
+		Infra_EventUnlock(event);
+		CHECK_STATUS(status);
+
+		if(available > (noOfBytes - *noOfBytesTransferred))
+			available = noOfBytes - *noOfBytesTransferred;
+		if(available > 0)
+		{
+			bytesRead = 0;
+			status = varFunctionPtrLst.p_FT_Read(handle,\
+				&buffer[*noOfBytesTransferred],available,&bytesRead);
+			CHECK_STATUS(status);
+			*noOfBytesTransferred += bytesRead;
+			signalled = TRUE;
+		}
+	}
+	DBG(MSG_DEBUG,"noOfBytes=%u noOfBytesTransferred=%u\n",(unsigned)noOfBytes,\
+		(unsigned)*noOfBytesTransferred);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Gets the size of the data FIFOs of a MPSSE channel
+ *
+ * This function returns the number of bytes the chip can buffer in each direction for one
+ * of its MPSSE channels. Upper layers use it to limit the amount of data in flight.
+ *
+ * \param[in] ftDevice Type of the chip
+ * \return Size of the FIFO in bytes
+ * \sa Mid_GetFtDeviceType
+ * \note A conservative size is returned for chips that are not known
+ * \warning
+ */
+uint32 Mid_GetFifoSize(FT_DEVICE ftDevice)
+{
+	uint32 size;
+	switch(ftDevice)
+	{
+		case FT_DEVICE_2232C:/* FT2232D */
+			size = MID_FIFO_SIZE_FT2232D;
+			break;
+		case FT_DEVICE_232H:
+			size = MID_FIFO_SIZE_FT232H;
+			break;
+		case FT_DEVICE_2232H:
+			size = MID_FIFO_SIZE_FT2232H;
+			break;
+		case FT_DEVICE_4232H:
+			size = MID_FIFO_SIZE_FT4232H;
+			break;
+		default:
+			size = MID_FIFO_SIZE_UNKNOWN;
+	}
+	return size;
+}
+
+/*!
+ * \brief Initializes a command buffer
+ *
+ * This function allocates the memory in which MPSSE commands for a channel are assembled
+ *
+ * \param[in] cmdBuffer Pointer to the command buffer
+ * \param[in] Protocol Specifies the protocol type(I2C/SPI/JTAG)
+ * \param[in] handle Handle of the channel to which the commands are to be sent
+ * \param[in] size Capacity of the buffer in bytes
+ * \return status
+ * \sa
+ * \note
+ * \warning
+ */
+FT_STATUS Mid_CmdBufferInit(MidCmdBuffer *cmdBuffer, FT_LegacyProtocol Protocol,
+	FT_HANDLE handle, uint32 size)
+{
+	FT_STATUS status=FT_OK;
+	FN_ENTER;
+	cmdBuffer->protocol = Protocol;
+	cmdBuffer->handle = handle;
+	cmdBuffer->length = 0;
+	cmdBuffer->size = size;
+	cmdBuffer->noOfWrites = 0;
+	cmdBuffer->noOfBytesWritten = 0;
+	cmdBuffer->writeHook = NULL;
+	cmdBuffer->hookContext = NULL;
+	cmdBuffer->buffer = (uint8*)INFRA_MALLOC(size);
+	if(NULL == cmdBuffer->buffer)
+	{
+		cmdBuffer->size = 0;
+		status = FT_INSUFFICIENT_RESOURCES;
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Frees a command buffer
+ *
+ * This function frees the memory allocated by Mid_CmdBufferInit. Commands that were not flushed
+ * are discarded.
+ *
+ * \param[in] cmdBuffer Pointer to the command buffer
+ * \return none
+ * \sa
+ * \note
+ * \warning
+ */
+void Mid_CmdBufferFree(MidCmdBuffer *cmdBuffer)
+{
+	if(NULL != cmdBuffer->buffer)
+	{
+		INFRA_FREE(cmdBuffer->buffer);
+	}
+	cmdBuffer->buffer = NULL;
+	cmdBuffer->size = 0;
+	cmdBuffer->length = 0;
+}
+
+/*!
+ * \brief Appends MPSSE commands or data to a command buffer
+ *
+ * This function copies the given bytes to the end of the command buffer. If the buffer fills up
+ * then its contents are sent to the chip and the copying continues from the start of the buffer,
+ * so any amount of data can be appended.
+ *
+ * \param[in] cmdBuffer Pointer to the command buffer
+ * \param[in] data Pointer to the bytes to be appended
+ * \param[in] noOfBytes Number of bytes to be appended
+ * \return status
+ * \sa Mid_CmdBufferFlush
+ * \note
+ * \warning
+ */
+FT_STATUS Mid_CmdBufferAppend(MidCmdBuffer *cmdBuffer, uint8 *data,
+	uint32 noOfBytes)
+{
+	FT_STATUS status=FT_OK;
+	uint32 space;
+
+	while(noOfBytes > 0)
+	{
+		space = cmdBuffer->size - cmdBuffer->length;
+		if(0 == space)
+		{
+			status = Mid_CmdBufferFlush(cmdBuffer);
+			CHECK_STATUS(status);
+			space = cmdBuffer->size;
+		}
+		if(space > noOfBytes)
+		{
+			space = noOfBytes;
+		}
+		memcpy(&cmdBuffer->buffer[cmdBuffer->length],data,space);
+		cmdBuffer->length += space;
+		data += space;
+		noOfBytes -= space;
+	}
+	return status;
+}
+
+/*!
+ * \brief Sends the contents of a command buffer to the chip
+ *
+ * This function writes all the bytes assembled in the command buffer to the channel using a
+ * single call to FT_Channel_Write and empties the buffer
+ *
+ * \param[in] cmdBuffer Pointer to the command buffer
+ * \return status
+ * \sa
+ * \note The buffer is emptied even if the write fails
+ * \warning
+ */
+FT_STATUS Mid_CmdBufferFlush(MidCmdBuffer *cmdBuffer)
+{
+	FT_STATUS status=FT_OK;
+	uint32 noOfBytesTransferred=0;
+	uint32 noOfBytes;
+
+	noOfBytes = cmdBuffer->length;
+	cmdBuffer->length = 0;
+	if(noOfBytes > 0)
+	{
+		status = FT_Channel_Write(cmdBuffer->protocol,cmdBuffer->handle,noOfBytes,
+			cmdBuffer->buffer,&noOfBytesTransferred);
+		/* The protocol layer may read the counters while they are changed */
+		INFRA_ATOMIC_ADD32(&cmdBuffer->noOfWrites,1);
+		INFRA_ATOMIC_ADD64(&cmdBuffer->noOfBytesWritten,noOfBytesTransferred);
+		if(NULL != cmdBuffer->writeHook)
+			cmdBuffer->writeHook(cmdBuffer->hookContext,status,noOfBytesTransferred);
+		CHECK_STATUS(status);
+		if(noOfBytesTransferred != noOfBytes)
+		{
+			DBG(MSG_ERR,"Timeout occured. RequestedTxLen=%u TxLen=%u \n",
+				(unsigned)noOfBytes,(unsigned)noOfBytesTransferred);
+			status = FT_IO_ERROR;
+		}
+	}
+	return status;
+}
+
+
+/*!
+ * \brief Initializes the middle layer
+ *
+ * This function creates the lock that protects the channel list. It is called by
+ * Init_libMPSSE when the library is loaded
+ *
+ * \param[in] none
+ * \return none
+ * \sa Ftdi_Mid_Module_Cleanup
+ * \note
+ * \warning
+ */
+void Ftdi_Mid_Module_Init(void)
+{
+	INFRA_MUTEX_INIT(&ChannelList.lock);
+	ChannelList.valid = FALSE;
+	ChannelList.devices = NULL;
+	ChannelList.deviceIndex = NULL;
+	ChannelList.capacity = 0;
+	ChannelList.numDevices = 0;
+	ChannelList.numChannels = 0;
+}
+
+/*!
+ * \brief Cleans up the middle layer
+ *
+ * This function frees the channel list and destroys its lock. It is called by
+ * Cleanup_libMPSSE when the library is unloaded
+ *
+ * \param[in] none
+ * \return none
+ * \sa Ftdi_Mid_Module_Init
+ * \note
+ * \warning
+ */
+void Ftdi_Mid_Module_Cleanup(void)
+{
+	if(NULL != ChannelList.devices)
+	{
+		INFRA_FREE(ChannelList.devices);
+		ChannelList.devices = NULL;
+	}
+	if(NULL != ChannelList.deviceIndex)
+	{
+		INFRA_FREE(ChannelList.deviceIndex);
+		ChannelList.deviceIndex = NULL;
+	}
+	ChannelList.valid = FALSE;
+	INFRA_MUTEX_DESTROY(&ChannelList.lock);
+}
+
+/******************************************************************************/
+/*						Local function definitions						  */
+/******************************************************************************/
+
+/*!
+ * \brief Enumerates the devices if the channel list is not valid
+ *
+ * This function gets the information list of the devices connected to the host system and
+ * records which of them are MPSSE channels, so that a channel index maps to its device without
+ * enumerating the USB bus again. Called with ChannelList.lock held
+ *
+ * \param[in] refresh If TRUE then the devices are enumerated even if the list is valid
+ * \return status
+ * \sa FT_RefreshChannelList
+ * \note The storage of the list is kept and only grows
+ * \warning
+ */
+FT_STATUS Mid_UpdateChannelList(bool refresh)
+{
+	FT_STATUS status;
+	DWORD numDevices;
+	uint32 devLoop;
+
+	FN_ENTER;
+	if(ChannelList.valid && !refresh)
+	{
+		FN_EXIT;
+		return FT_OK;
+	}
+	ChannelList.valid = FALSE;
+	ChannelList.numDevices = 0;
+	ChannelList.numChannels = MID_NO_CHANNEL_FOUND;
+	/*Get the number of devices connected to the system(FT_CreateDeviceInfoList)*/
+	status = varFunctionPtrLst.p_FT_GetNumChannel(&numDevices);
+	CHECK_STATUS(status);
+	if(numDevices > ChannelList.capacity)
+	{
+		if(NULL != ChannelList.devices)
+		{
+			INFRA_FREE(ChannelList.devices);
+		}
+		if(NULL != ChannelList.deviceIndex)
+		{
+			INFRA_FREE(ChannelList.deviceIndex);
+		}
+		ChannelList.capacity = 0;
+		ChannelList.devices = INFRA_MALLOC(sizeof(FT_DEVICE_LIST_INFO_NODE)*numDevices);
+		ChannelList.deviceIndex = INFRA_MALLOC(sizeof(uint32)*numDevices);
+		if((NULL == ChannelList.devices) || (NULL == ChannelList.deviceIndex))
+		{
+			if(NULL != ChannelList.devices)
+			{
+				INFRA_FREE(ChannelList.devices);
+				ChannelList.devices = NULL;
+			}
+			if(NULL != ChannelList.deviceIndex)
+			{
+				INFRA_FREE(ChannelList.deviceIndex);
+				ChannelList.deviceIndex = NULL;
+			}
+			return FT_INSUFFICIENT_RESOURCES;
+		}
+		ChannelList.capacity = numDevices;
+	}
+	if(numDevices > MID_NO_CHANNEL_FOUND)
+	{
+		/*get the devices information(FT_GetDeviceInfoList)*/
+		status = varFunctionPtrLst.p_FT_GetDeviceInfoList(ChannelList.devices,\
+			&numDevices);
+		CHECK_STATUS(status);
+	}
+	/*The list may have shrunk since it was sized*/
+	if(numDevices > ChannelList.capacity)
+		numDevices = ChannelList.capacity;
+	for(devLoop=0;devLoop<numDevices;devLoop++)
+	{
+		if(Mid_CheckMPSSEAvailable(ChannelList.devices[devLoop]))
+			ChannelList.deviceIndex[ChannelList.numChannels++] = devLoop;
+	}
+	ChannelList.numDevices = numDevices;
+	ChannelList.valid = TRUE;
+	DBG(MSG_DEBUG,"devices=%u MPSSE channels=%u\n",(unsigned)numDevices,\
+		(unsigned)ChannelList.numChannels);
+	FN_EXIT;
+	return status;
+}
+
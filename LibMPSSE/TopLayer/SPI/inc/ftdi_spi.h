@@ -24,12 +24,39 @@
  * 0.2  - 20110708 - added function SPI_ChangeCS, moved SPI_Read/WriteGPIO to middle layer
  * 0.3  - 20111103 - added SPI_ReadWrite
  * 0.41 - 20140903 - fixed compile warnings
+ * 0.5  - 20261015 - added per-channel MPSSE command buffer to ChannelContext
+ *				  added csHoldCycles to ChannelConfig
+ *				  channel contexts are kept in a hash table(SPI_CHANNEL_TABLE_SIZE)
+ *				  added per-channel lock to ChannelContext, Ftdi_SPI_Module_Init/Cleanup
+ *				  added asynchronous transfers(SPI_ReadAsync, SPI_WriteAsync,
+ *				  SPI_ReadWriteAsync, SPI_Wait & SPI_Poll)
+ *				  added SPI_CONFIG_OPTION_RX_EVENT
+ *				  added SPI_TransferList & SpiSegment
+ *				  added SPI_RefreshChannelList
+ *				  added SPI_OpenChannelBySerial, SPI_OpenChannelByLocation &
+ *				  SPI_OpenChannelByDescription
+ *				  added SPI_ReinitChannel, initialized flag to ChannelContext
+ *				  added SPI_GetStats, SPI_ResetStats & SpiStats
+ *				  added SPI_SetTraceLevel, SPI_GetTrace, SPI_DumpTrace & SPI_TRACE
+ *				  added SPI_WaitWhileBusy, SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY &
+ *				  SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH
+ *				  added SPI_CONFIG_OPTION_3PHASE_CLOCKING & SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING
+ *				  added SPI_GetClockRate, clock to ChannelContext
+ *				  added pins to ChannelContext
+ *				  added SPI_CONFIG_OPTION_CS_ACBUS0-7, currentPinStateHigh & csPinsHigh to
+ *				  ChannelContext
+ *				  added SPI_AttachDevice, SPI_DetachDevice, SPI_DeviceRead, SPI_DeviceWrite,
+ *				  SPI_DeviceReadWrite, SPI_DeviceTransferList & SpiDevice
+ *				  added SPI_CONFIG_OPTION_LSB_FIRST & SPI_ReverseBits
+ *				  added references & closed to ChannelContext
+ *				  added SPI_CONFIG_OPTION_CS_HOLD
  */
 
 #ifndef FTDI_SPI_H
 #define FTDI_SPI_H
 
 #include "ftdi_infra.h"
+#include "ftdi_mid.h"
 
 
 /******************************************************************************/
@@ -45,6 +72,9 @@
 #define	SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE		0x00000002
 /* transferOptions-Bit2: if BIT2 is 1 then CHIP_SELECT line will be disabled at end of transfer */
 #define SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE		0x00000004
+/* transferOptions-Bit3: if BIT3 is 1 then the chip waits for the slave to be ready(see
+SPI_WaitWhileBusy) before the transfer. Only honoured by SPI_TransferList */
+#define SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY		0x00000008
 
 /* Bit definition of the Options member of configOptions structure */
 #define SPI_CONFIG_OPTION_MODE_MASK		0x00000003
@@ -62,6 +92,127 @@
 
 #define SPI_CONFIG_OPTION_CS_ACTIVELOW	0x00000020
 
+/* If set, reads sleep on an event that D2XX signals when data arrives instead of blocking in
+FT_Read. Takes effect in SPI_InitChannel and stays for as long as the channel is open */
+#define SPI_CONFIG_OPTION_RX_EVENT		0x00000040
+
+/* If set, the busy line of the slave(GPIOL1) is high while the slave is busy, otherwise it is
+low while the slave is busy */
+#define SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH	0x00000080
+
+/* Pin of the low byte(ADBUS5/GPIOL1) that the MPSSE wait on I/O commands look at */
+#define SPI_BUSY_PIN					0x20
+
+/* If set, each SCLK cycle has three phases: data is put out on one edge, held for half a period
+and sampled on the next edge, so it is stable at both ends of long cables. A cycle lasts 1.5
+periods and the fastest clock is 20MHz. FT2232H, FT4232H & FT232H only */
+#define SPI_CONFIG_OPTION_3PHASE_CLOCKING	0x00000100
+/* If set, each SCLK edge waits for the slave to return the clock on GPIOL3(ADBUS7), which must
+then be an input. FT2232H, FT4232H & FT232H only */
+#define SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING	0x00000200
+#define SPI_CONFIG_OPTION_CLOCK_MASK		0x00000300
+
+/* If set, BIT4-BIT2 select ACBUS0-ACBUS7(the high byte of pins) as the chip select instead of
+ADBUS3-ADBUS7, so that a channel can have up to 13 slaves. FT2232H & FT232H, ACBUS0-ACBUS3 on
+FT2232D */
+#define SPI_CONFIG_OPTION_CS_ACBUS		0x00000400
+#define SPI_CONFIG_OPTION_CS_ACBUS0		0x00000400		/* 1 000 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS1		0x00000404		/* 1 001 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS2		0x00000408		/* 1 010 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS3		0x0000040C		/* 1 011 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS4		0x00000410		/* 1 100 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS5		0x00000414		/* 1 101 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS6		0x00000418		/* 1 110 00 */
+#define SPI_CONFIG_OPTION_CS_ACBUS7		0x0000041C		/* 1 111 00 */
+
+/* If set, data is clocked LSB first(the MPSSE data commands with bit 3 set), so that buffers
+in that order need not be bit reversed on the host. The bits of a transfer whose size is not a
+multiple of 8 are clocked from bit 0 of the last byte, and received into its top bits */
+#define SPI_CONFIG_OPTION_LSB_FIRST		0x00000800
+
+/* If set, CS is held inactive for ChannelConfig.csHoldCycles SCLK cycles after it is disabled.
+csHoldCycles is ignored otherwise, since callers built before it was added leave the padding
+it took uninitialized */
+#define SPI_CONFIG_OPTION_CS_HOLD		0x00001000
+
+/* Pin of the chip select of configOptions in the low byte, 0 if it is on the high byte */
+#define SPI_CS_LOW_PIN(configOptions)	\
+	((uint8)(((configOptions) & SPI_CONFIG_OPTION_CS_ACBUS)?0:\
+	((1<<(((configOptions) & SPI_CONFIG_OPTION_CS_MASK)>>2))<<3)))
+/* Pin of the chip select of configOptions in the high byte, 0 if it is on the low byte */
+#define SPI_CS_HIGH_PIN(configOptions)	\
+	((uint8)(((configOptions) & SPI_CONFIG_OPTION_CS_ACBUS)?\
+	(1<<(((configOptions) & SPI_CONFIG_OPTION_CS_MASK)>>2)):0))
+
+/* Size of the commands that set the low and the high byte of pins */
+#define SPI_PIN_CMDS_SIZE				6
+
+/* Pin of the low byte(ADBUS7/GPIOL3) on which adaptive clocking receives the return clock */
+#define SPI_RTCK_PIN					0x80
+
+/* clockOptions of Mid_GetClockCmds that the configOptions of a channel select */
+#define SPI_CLOCK_OPTIONS(configOptions)	\
+	((((configOptions) & SPI_CONFIG_OPTION_3PHASE_CLOCKING)?MID_CLOCK_3PHASE:0) | \
+	(((configOptions) & SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING)?MID_CLOCK_ADAPTIVE:0))
+
+/* Value of SpiSegment.mode that selects SPI mode SPI_CONFIG_OPTION_MODEx for the segment */
+#define SPI_SEGMENT_MODE(mode)	((uint8)(((mode) & SPI_CONFIG_OPTION_MODE_MASK)+1))
+
+/* Bits of configOptions that each slave attached with SPI_AttachDevice has of its own, the
+others are those of the channel */
+#define SPI_DEVICE_OPTIONS_MASK		(SPI_CONFIG_OPTION_MODE_MASK | SPI_CONFIG_OPTION_CS_MASK | \
+	SPI_CONFIG_OPTION_CS_ACTIVELOW | SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH | \
+	SPI_CONFIG_OPTION_CS_ACBUS | SPI_CONFIG_OPTION_LSB_FIRST)
+
+/* Number of buckets in the table that maps channel handles to their contexts(power of 2) */
+#define SPI_CHANNEL_TABLE_SIZE			64
+
+/* Maximum number of asynchronous transfers of a channel whose completion has not yet been
+reported. Submitting more waits for the oldest one to complete */
+#define SPI_ASYNC_QUEUE_SIZE			32
+/* Maximum number of bytes that the asynchronous transfers of a channel may have waiting to be
+read back. It matches the input buffer of the D2XX driver so the chip never stalls */
+#define SPI_ASYNC_MAX_READ_PENDING		65536
+
+/* Calls whose latency is recorded in SpiStats.latency */
+#define SPI_STATS_CALL_READ				0
+#define SPI_STATS_CALL_WRITE			1
+#define SPI_STATS_CALL_READWRITE		2
+#define SPI_STATS_CALL_ASYNC			3/* SPI_ReadAsync, SPI_WriteAsync & SPI_ReadWriteAsync */
+#define SPI_STATS_CALL_WAIT				4
+#define SPI_STATS_CALL_TRANSFER_LIST	5
+#define SPI_STATS_NO_OF_CALLS			6
+/* Number of bins of a latency histogram. Bins 0 to 3 count calls that took 0 to 3us, after
+that every power of 2 is split into 4 bins of equal width, so that the resolution is 25% of
+the latency. The last bin also counts anything longer than it */
+#define SPI_STATS_HISTOGRAM_BINS		96
+/* Lowest latency in microseconds counted by a bin of the histogram */
+#define SPI_STATS_BIN_LOWER_US(bin)	(((bin) < 4)?(uint64)(bin):\
+	((uint64)(4 + ((bin) & 3)) << (((bin) >> 2) - 1)))
+
+/* Levels of the trace of a channel(SPI_SetTraceLevel). Each level also records the events of
+the levels below it */
+#define SPI_TRACE_LEVEL_OFF				0
+#define SPI_TRACE_LEVEL_API				1/* entry to and exit from the transfer functions */
+#define SPI_TRACE_LEVEL_USB				2/* USB writes and reads */
+#define SPI_TRACE_LEVEL_CMDS			3/* MPSSE commands */
+/* Number of events kept by the trace of a channel(power of 2). Older events are overwritten */
+#define SPI_TRACE_BUFFER_SIZE			4096
+/* Types of trace events(SpiTraceEvent.type) and the meaning of their code and value */
+#define SPI_TRACE_EVENT_ENTER			1/* SPI_STATS_CALL_xxx, size to transfer or ticket */
+#define SPI_TRACE_EVENT_EXIT			2/* SPI_STATS_CALL_xxx, status */
+#define SPI_TRACE_EVENT_USB_WRITE		3/* status, number of bytes written */
+#define SPI_TRACE_EVENT_USB_READ		4/* status, number of bytes read */
+#define SPI_TRACE_EVENT_CMD				5/* MPSSE opcode, length of data in bytes or bits,
+										SCLK cycles or value and direction of pins */
+/* Start of a file written by SPI_DumpTrace */
+#define SPI_TRACE_FILE_MAGIC			"MPSSETRC"
+#define SPI_TRACE_FILE_VERSION			1
+
+/* Records an event in the trace of a channel if its trace level is at least level */
+#define SPI_TRACE(context,level,type,code,value)	{if((context)->traceLevel >= (level))\
+	SPI_TraceEvent((context),(uint8)(type),(uint8)(code),(uint32)(value));}
+
 
 /******************************************************************************/
 /*								Type defines								  */
@@ -87,7 +238,14 @@ typedef struct ChannelConfig_t
  			 : 011 - A/B/C/D_DBUS6=ChipSelect
  			 : 100 - A/B/C/D_DBUS7=ChipSelect
  	BIT5: ChipSelect is active high if this bit is 0
-	BIT6 -BIT31		: Reserved
+	BIT6: Wait for received data on an event(SPI_CONFIG_OPTION_RX_EVENT)
+	BIT7: Busy line is high while the slave is busy(SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH)
+	BIT8: Three phase clocking(SPI_CONFIG_OPTION_3PHASE_CLOCKING)
+	BIT9: Adaptive clocking(SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING)
+	BIT10: BIT4-BIT2 select ACBUS0-ACBUS7 as ChipSelect(SPI_CONFIG_OPTION_CS_ACBUS)
+	BIT11: Data is clocked LSB first(SPI_CONFIG_OPTION_LSB_FIRST)
+	BIT12: CS is held inactive for csHoldCycles(SPI_CONFIG_OPTION_CS_HOLD)
+	BIT13 -BIT31	: Reserved
 	*/
 	uint32		Pin;/* BIT7   -BIT0:   Initial direction of the pins	*/
 					/* BIT15 -BIT8:   Initial values of the pins		*/
@@ -95,14 +253,125 @@ typedef struct ChannelConfig_t
 					/* BIT31 -BIT24: Final values of the pins		*/
 	uint16		currentPinState;/* BIT7   -BIT0:   Current direction of the pins	*/
 								/* BIT15 -BIT8:   Current values of the pins	*/
+	uint16		csHoldCycles;/* Number of SCLK cycles for which CS is held inactive
+							after it is disabled, before any further command is
+							executed by the chip. 0 = no hold. Only used if
+							SPI_CONFIG_OPTION_CS_HOLD is set. Approximate on
+							FT2232D, see SPI_AppendIdleCycles */
 }ChannelConfig;
 
-/* This structure associates the channel configuration information to a handle stores them in the
-form of a linked list */
+/* One transfer of the list passed to SPI_TransferList, on the lines of the spi_ioc_transfer
+structure of Linux spidev. Members that are 0 leave the settings of the channel unchanged */
+typedef struct SpiSegment_t
+{
+	uint8	*txBuffer;/* data to be clocked out, NULL if the segment only reads */
+	uint8	*rxBuffer;/* where the data clocked in is stored, NULL if the segment only writes */
+	uint32	length;/* size of the data, in bytes or bits as per transferOptions */
+	uint32	transferOptions;/* SPI_TRANSFER_OPTIONS_xxx, as in SPI_ReadWrite */
+	uint32	delayCycles;/* SCLK cycles to wait after the segment, before the next one */
+	uint32	clockRate;/* clock rate of the segment, 0 = clock rate of the channel */
+	uint8	mode;/* SPI_SEGMENT_MODE(x) to use SPI mode x, 0 = mode of the channel */
+}SpiSegment;
+
+/* Handle of a slave attached to a channel with SPI_AttachDevice */
+typedef void *SPI_DEVICE;
+
+/* A slave attached to a channel. An SPI_DEVICE points to one of these */
+typedef struct SpiDevice_t
+{
+	FT_HANDLE	handle;/* channel the slave is connected to */
+	uint32		configOptions;/* mode, chip select and polarities, see SPI_DEVICE_OPTIONS_MASK */
+	uint32		clockRate;/* SPI clock rate of the slave */
+}SpiDevice;
+
+/* Statistics of a channel, returned by SPI_GetStats */
+typedef struct SpiStats_t
+{
+	uint64	bytesOut;/* data bytes clocked out to the slave */
+	uint64	bytesIn;/* data bytes clocked in from the slave */
+	uint64	usbBytesWritten;/* bytes of commands and data written to the chip */
+	uint64	usbBytesRead;/* bytes read back from the chip */
+	uint32	usbWrites;/* USB writes issued */
+	uint32	usbReads;/* reads of data from the chip */
+	uint32	transactions;/* calls that transferred data, see SPI_STATS_CALL_xxx */
+	uint32	csToggles;/* times the CS line was enabled or disabled */
+	uint32	timeouts;/* reads that ended because the read timeout expired */
+	uint32	shortReads;/* reads that returned fewer bytes than asked for, for any reason */
+	uint32	latency[SPI_STATS_NO_OF_CALLS][SPI_STATS_HISTOGRAM_BINS];/* histogram of the
+			time taken by each call, see SPI_STATS_BIN_LOWER_US */
+}SpiStats;
+
+/* An event recorded in the trace of a channel */
+typedef struct SpiTraceEvent_t
+{
+	uint64	timestamp;/* nanoseconds, from a monotonic clock */
+	uint32	value;
+	uint8	type;/* SPI_TRACE_EVENT_xxx */
+	uint8	code;
+	uint16	reserved;
+}SpiTraceEvent;
+
+/* Header of a file written by SPI_DumpTrace. It is followed by noOfEvents events, oldest
+first, in the byte order of the host that wrote the file */
+typedef struct SpiTraceFileHeader_t
+{
+	char	magic[8];/* SPI_TRACE_FILE_MAGIC, not terminated */
+	uint32	version;/* SPI_TRACE_FILE_VERSION */
+	uint32	noOfEvents;
+}SpiTraceFileHeader;
+
+/* Function called when an asynchronous transfer completes. It is called without the channel
+locked, from within whichever SPI function of the channel noticed the completion */
+typedef void (*SPI_CALLBACK)(FT_HANDLE handle, uint32 ticket, FT_STATUS status,
+	uint32 sizeTransferred, void *userData);
+
+/* An asynchronous transfer that has been sent to the chip */
+typedef struct SpiAsyncEntry_t
+{
+	uint32			ticket;/* 0 if the entry was never used */
+	uint8			*inBuffer;/* where the data read back is stored */
+	uint32			readLength;/* number of bytes to be read back, 0 for writes */
+	uint32			sizeToTransfer;
+	uint32			transferOptions;
+	SPI_CALLBACK	callback;
+	void			*userData;
+	FT_STATUS		status;/* valid once the transfer has completed */
+	uint32			sizeTransferred;/* valid once the transfer has completed */
+}SpiAsyncEntry;
+
+/* This structure associates the channel configuration information to a handle. The structures
+are kept in a hash table keyed by the handle; next links the structures of the same bucket. A
+structure is freed when its last reference is dropped, the table holds one reference and each
+function that looked the handle up holds another until it returns */
 typedef struct ChannelContext_t
 {
 	FT_HANDLE 		handle;
 	ChannelConfig	config;
+	FT_DEVICE		ftDevice;/* type of the chip the channel belongs to */
+	MidCmdBuffer	cmdBuffer;/* MPSSE commands of a transaction are assembled here */
+	InfraMutex		lock;/* held by LOCK_CHANNEL for the duration of a transaction */
+	uint32			references;/* changed with INFRA_ATOMIC_INC & INFRA_ATOMIC_DEC */
+	bool			closed;/* set by SPI_CloseChannel with the channel locked */
+	/* Asynchronous transfers are kept in asyncQueue[ticket%SPI_ASYNC_QUEUE_SIZE]. Tickets
+	from asyncDelivered to asyncCompleted-1 have completed but their callbacks have not been
+	called yet, tickets from asyncCompleted to asyncNext-1 are still in the chip */
+	SpiAsyncEntry	asyncQueue[SPI_ASYNC_QUEUE_SIZE];
+	uint32			asyncNext;
+	uint32			asyncCompleted;
+	uint32			asyncDelivered;
+	uint32			asyncReadPending;/* bytes still to be read back for the transfers */
+	bool			rxEventEnabled;/* reads wait on rxEvent(SPI_CONFIG_OPTION_RX_EVENT) */
+	InfraEvent		rxEvent;
+	bool			initialized;/* SPI_InitChannel has synchronized the MPSSE */
+	MidClock		clock;/* clock settings last sent to the chip, rate is 0 if not known */
+	MidPins			pins;/* pin states last sent to the chip */
+	uint16			currentPinStateHigh;/* as currentPinState, for the high byte(ACBUS) */
+	uint8			csPinsHigh;/* pins of the high byte used as chip selects since init */
+	SpiStats		stats;/* USB writes are counted by cmdBuffer instead. Changed and read
+							with INFRA_ATOMIC_xxx, SPI_GetStats does not lock the channel */
+	uint32			traceLevel;/* SPI_TRACE_LEVEL_xxx */
+	SpiTraceEvent	*trace;/* allocated when the trace is first enabled */
+	uint32			traceNext;/* number of events recorded, trace wraps around */
 	struct ChannelContext_t *next;
 }ChannelContext;
 
@@ -121,8 +390,16 @@ typedef struct ChannelContext_t
 FTDI_API FT_STATUS SPI_GetNumChannels(uint32 *numChannels);
 FTDI_API FT_STATUS SPI_GetChannelInfo(uint32 index,
 	FT_DEVICE_LIST_INFO_NODE *chanInfo);
+FTDI_API FT_STATUS SPI_RefreshChannelList(void);
 FTDI_API FT_STATUS SPI_OpenChannel(uint32 index, FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelBySerial(const char *serialNumber,
+	FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelByLocation(uint32 locationId, FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelByDescription(const char *description,
+	FT_HANDLE *handle);
 FTDI_API FT_STATUS SPI_InitChannel(FT_HANDLE handle, ChannelConfig *config);
+FTDI_API FT_STATUS SPI_ReinitChannel(FT_HANDLE handle, ChannelConfig *config);
+FTDI_API FT_STATUS SPI_GetClockRate(FT_HANDLE handle, uint32 *clockRate);
 FTDI_API FT_STATUS SPI_CloseChannel(FT_HANDLE handle);
 FTDI_API FT_STATUS SPI_Read(FT_HANDLE handle, uint8 *buffer,
 	uint32 sizeToTransfer, uint32 *sizeTransfered, uint32 options);
@@ -132,10 +409,46 @@ FTDI_API FT_STATUS SPI_ReadWrite(FT_HANDLE handle, uint8 *inBuffer,
 	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
 	uint32 transferOptions);
 FTDI_API FT_STATUS SPI_IsBusy(FT_HANDLE handle, bool *state);
+FTDI_API FT_STATUS SPI_WaitWhileBusy(FT_HANDLE handle, uint32 timeout);
 FTDI_API void Init_libMPSSE(void);
 FTDI_API void Cleanup_libMPSSE(void);
 FTDI_API FT_STATUS SPI_ChangeCS(FT_HANDLE handle, uint32 configOptions);
 FTDI_API FT_STATUS SPI_ToggleCS(FT_HANDLE handle, bool state);
+FTDI_API FT_STATUS SPI_ReadAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_WriteAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_ReadWriteAsync(FT_HANDLE handle, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 transferOptions,
+	SPI_CALLBACK callback, void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_Wait(FT_HANDLE handle, uint32 ticket,
+	uint32 *sizeTransferred);
+FTDI_API FT_STATUS SPI_Poll(FT_HANDLE handle, uint32 *noOfPending);
+FTDI_API FT_STATUS SPI_TransferList(FT_HANDLE handle, const SpiSegment *segments,
+	uint32 noOfSegments);
+FTDI_API FT_STATUS SPI_AttachDevice(FT_HANDLE handle, uint32 configOptions,
+	uint32 clockRate, SPI_DEVICE *device);
+FTDI_API FT_STATUS SPI_DetachDevice(SPI_DEVICE device);
+FTDI_API FT_STATUS SPI_DeviceRead(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceWrite(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceReadWrite(SPI_DEVICE device, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
+	uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceTransferList(SPI_DEVICE device, const SpiSegment *segments,
+	uint32 noOfSegments);
+FTDI_API FT_STATUS SPI_ReverseBits(uint8 *buffer, uint32 size);
+FTDI_API FT_STATUS SPI_GetStats(FT_HANDLE handle, SpiStats *stats);
+FTDI_API FT_STATUS SPI_ResetStats(FT_HANDLE handle);
+FTDI_API FT_STATUS SPI_SetTraceLevel(FT_HANDLE handle, uint32 level);
+FTDI_API FT_STATUS SPI_GetTrace(FT_HANDLE handle, SpiTraceEvent *events,
+	uint32 maxEvents, uint32 *noOfEvents);
+FTDI_API FT_STATUS SPI_DumpTrace(FT_HANDLE handle, const char *fileName);
+void Ftdi_SPI_Module_Init(void);
+void Ftdi_SPI_Module_Cleanup(void);
 
 /******************************************************************************/
 
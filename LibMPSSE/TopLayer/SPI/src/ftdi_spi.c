@@ -26,6 +26,50 @@
  *				  ENABLE_MULTI_BYTE_TRANSFER - transfer multiple bytes per USB frame
  *				  added function SPI_ReadWrite
  * 0.41 - 20140903 - fixed compile warnings
+ * 0.5  - 20261015 - SPI_Read, SPI_Write & SPI_ReadWrite assemble chip select, command, length,
+ *				  data and chip deselect in the channel's command buffer and send them to
+ *				  the chip in one USB transfer
+ *				  CS hold is done by the chip(csHoldCycles) instead of a 2ms host sleep
+ *				  byte mode transfers larger than 64KB are split into multiple MPSSE
+ *				  commands that are sent back to back with CS held
+ *				  byte mode SPI_ReadWrite overlaps writing and reading of data
+ *				  bit mode transfers are sent as one command stream with a single read,
+ *				  removed SPI_Write8bits & SPI_Read8bits
+ *				  channel contexts are kept in a hash table keyed by handle
+ *				  transfers on a channel are serialized by a per-channel lock and the
+ *				  channel table by ChannelTableLock(Ftdi_SPI_Module_Init)
+ *				  added SPI_ReadAsync, SPI_WriteAsync, SPI_ReadWriteAsync, SPI_Wait & SPI_Poll
+ *				  reads may wait on a D2XX receive event(SPI_CONFIG_OPTION_RX_EVENT)
+ *				  added SPI_TransferList
+ *				  added SPI_RefreshChannelList, channels are enumerated once and cached
+ *				  added SPI_OpenChannelBySerial, SPI_OpenChannelByLocation &
+ *				  SPI_OpenChannelByDescription
+ *				  added SPI_ReinitChannel
+ *				  added SPI_GetStats & SPI_ResetStats, each channel counts its traffic and
+ *				  keeps histograms of the latency of the transfer functions
+ *				  added SPI_SetTraceLevel, SPI_GetTrace & SPI_DumpTrace, each channel can
+ *				  record the transfer calls, USB transfers and MPSSE commands in a ring buffer
+ *				  added SPI_WaitWhileBusy and SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY, the chip
+ *				  waits for the busy line of the slave(MPSSE_CMD_WAIT_ON_IO_HIGH/LOW)
+ *				  three phase and adaptive clocking are selected by configOptions
+ *				  added SPI_GetClockRate, the clock settings last sent to the chip are kept
+ *				  in the channel's context and clock commands are only sent when they change
+ *				  the pin states last sent are kept in the channel's context, commands that
+ *				  would not change the pins(e.g. asserting a CS that is asserted) are left out
+ *				  chip selects may be on ACBUS0-ACBUS7(SPI_CONFIG_OPTION_CS_ACBUS), the state
+ *				  of the high byte is kept in the channel's context and FT_WriteGPIO leaves
+ *				  the chip selects as they are(SPI_GPIOHook)
+ *				  added SPI_AttachDevice, SPI_DetachDevice, SPI_DeviceRead, SPI_DeviceWrite,
+ *				  SPI_DeviceReadWrite & SPI_DeviceTransferList, a transfer on a slave only
+ *				  appends the commands of the settings that differ from the last slave's
+ *				  data may be clocked LSB first(SPI_CONFIG_OPTION_LSB_FIRST), added
+ *				  SPI_ReverseBits
+ *				  channel contexts are reference counted and freed by the last function
+ *				  that uses them, SPI_CloseChannel marks them closed with the channel
+ *				  locked, lookups take ChannelTableLock for reading
+ *				  csHoldCycles is only used if SPI_CONFIG_OPTION_CS_HOLD is set
+ *				  the statistics are counted with relaxed atomics and SPI_GetStats reads
+ *				  them without locking the channel
  */
 
 
@@ -52,25 +96,106 @@
 /*Enable to for no linked list implimentation(only 1 fixed channel)*/
 /* #define NO_LINKED_LIST		1 */
 
+/*Index of the bucket of the channel table in which the context of a handle is kept*/
+#define SPI_CHANNEL_HASH(handle)	((uint32)(((size_t)(handle)) ^ \
+	(((size_t)(handle))>>4) ^ (((size_t)(handle))>>12)) & (SPI_CHANNEL_TABLE_SIZE-1))
+
 /* The early implimentation allowed only one byte data transfer per USB frame.
 This macro enables the code to transfer multiple bytes per frame when
 SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES bit is set in the transferOptions parameter when
 calling SPI_Read or SPI_Write */
 #define ENABLE_MULTI_BYTE_TRANSFER	1
 
+/* Command bytes that SPI_ReadWritePipelined adds to the data of a chunk: the byte mode
+command with its length(3), the bit mode command with its length and data(3) and
+SEND_IMMEDIATE(1) */
+#define SPI_PIPELINE_CMD_BYTES		7
+
+/* The FT2232D has no command to clock without data. SPI_AppendIdleCycles writes the pins
+again instead, counting one write for each cycle of its fastest SCLK(6MHz, divisor 0), and
+at most this many times so that long holds at slow clocks do not fill the command buffer */
+#define SPI_FT2232D_MAX_IDLE_WRITES	256
+
 
 /******************************************************************************/
 /*								Local function declarations					  */
 /******************************************************************************/
 /* List management functions */
 FT_STATUS SPI_AddChannelConfig(FT_HANDLE handle);
+FT_STATUS SPI_OpenChannelEx(PVOID arg, DWORD flags, FT_HANDLE *handle);
 FT_STATUS SPI_DelChannelConfig(FT_HANDLE handle);
 FT_STATUS SPI_SaveChannelConfig(FT_HANDLE handle, ChannelConfig *config);
 FT_STATUS SPI_GetChannelConfig(FT_HANDLE handle, ChannelConfig **config);
+FT_STATUS SPI_GetChannelContext(FT_HANDLE handle, ChannelContext **context);
+void SPI_ReleaseChannelContext(ChannelContext *context);
+FT_STATUS SPI_LockChannelContext(FT_HANDLE handle, ChannelContext **context);
+void SPI_UnlockChannelContext(ChannelContext *context);
 FT_STATUS SPI_DisplayList(void);
 /* Read/Write functions */
-FT_STATUS SPI_Write8bits(FT_HANDLE handle,uint8 byte, uint8 len);
-FT_STATUS SPI_Read8bits(FT_HANDLE handle,uint8 *byte, uint8 len);
+FT_STATUS SPI_AppendToggleCS(ChannelContext *context, bool state);
+FT_STATUS SPI_AppendPins(ChannelContext *context);
+FT_STATUS SPI_AppendCSHold(ChannelContext *context);
+FT_STATUS SPI_AppendIdleCycles(ChannelContext *context, uint32 cycles);
+FT_STATUS SPI_AppendByteCmds(ChannelContext *context, uint8 opcode, uint8 *data,
+	uint32 size);
+FT_STATUS SPI_AppendBitCmds(ChannelContext *context, uint8 byteOpcode,
+	uint8 bitOpcode, uint8 *data, uint32 sizeInBits);
+FT_STATUS SPI_ReadWritePipelined(ChannelContext *context, uint8 byteOpcode,
+	uint8 bitOpcode, uint8 *inBuffer, uint8 *outBuffer, uint32 noOfBytes,
+	uint8 noOfBits, uint32 *sizeTransferred, bool disableCS);
+void SPI_SelectDataCmds(ChannelContext *context, bool in, bool out,
+	uint8 *byteCmd, uint8 *bitCmd);
+/* Bodies of the public functions, called with the channel locked */
+FT_STATUS SPI_ReadLocked(ChannelContext *context, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FT_STATUS SPI_WriteLocked(ChannelContext *context, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FT_STATUS SPI_ReadWriteLocked(ChannelContext *context, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
+	uint32 transferOptions);
+FT_STATUS SPI_IsBusyLocked(ChannelContext *context, bool *state);
+FT_STATUS SPI_WaitWhileBusyLocked(ChannelContext *context, uint32 timeout);
+FT_STATUS SPI_CheckBusyPin(ChannelContext *context);
+FT_STATUS SPI_AppendWaitWhileBusy(ChannelContext *context);
+FT_STATUS SPI_ResyncLocked(ChannelContext *context);
+FT_STATUS SPI_ChannelRead(ChannelContext *context, uint32 noOfBytes,
+	uint8 *buffer, uint32 *noOfBytesTransferred);
+/* Asynchronous transfer functions */
+FT_STATUS SPI_AsyncSubmit(FT_HANDLE handle, uint8 *inBuffer, uint8 *outBuffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket);
+FT_STATUS SPI_AsyncSubmitLocked(ChannelContext *context, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 transferOptions,
+	SPI_CALLBACK callback, void *userData, uint32 *ticket, bool *queued);
+FT_STATUS SPI_AsyncCompleteLocked(ChannelContext *context, uint32 ticket,
+	bool block);
+void SPI_AsyncDeliver(ChannelContext *context);
+FT_STATUS SPI_WaitLocked(ChannelContext *context, uint32 ticket,
+	uint32 *sizeTransferred);
+/* Transfer list functions */
+FT_STATUS SPI_TransferListLocked(ChannelContext *context,
+	const SpiSegment *segments, uint32 noOfSegments);
+FT_STATUS SPI_TransferListRead(ChannelContext *context,
+	const SpiSegment *segments, uint32 noOfSegments);
+FT_STATUS SPI_AppendMode(ChannelContext *context, uint32 mode);
+/* Functions of the slaves attached with SPI_AttachDevice */
+FT_STATUS SPI_SelectDeviceLocked(ChannelContext *context, SpiDevice *device);
+/* Initialization functions */
+FT_STATUS SPI_InitChannelLocked(ChannelContext *context, ChannelConfig *config);
+void SPI_PrepareConfig(ChannelConfig *config);
+FT_STATUS SPI_EnableRxEvent(ChannelContext *context, ChannelConfig *config);
+FT_STATUS SPI_CheckClockOptions(FT_DEVICE ftDevice, ChannelConfig *config);
+FT_STATUS SPI_CheckCSPin(FT_DEVICE ftDevice, uint32 configOptions);
+void SPI_PrepareCSHigh(ChannelContext *context, uint32 configOptions);
+void SPI_GetPinCmds(ChannelContext *context, uint16 pinState, uint8 *buffer,
+	uint32 *noOfBytes);
+void SPI_GPIOHook(FT_HANDLE handle, uint8 *dir, uint8 *value);
+FT_STATUS SPI_ReinitChannelLocked(ChannelContext *context, ChannelConfig *config);
+/* Statistics */
+void SPI_StatsRecord(ChannelContext *context, uint32 call, uint64 startTime);
+/* Trace */
+void SPI_TraceEvent(ChannelContext *context, uint8 type, uint8 code, uint32 value);
+void SPI_TraceWriteHook(void *hookContext, FT_STATUS status, uint32 noOfBytes);
 //FT_STATUS SPI_ToggleCS(FT_HANDLE handle, bool state);
 
 
@@ -82,9 +207,14 @@ FT_STATUS SPI_Read8bits(FT_HANDLE handle,uint8 *byte, uint8 len);
 #ifdef NO_LINKED_LIST
 	ChannelContext channelContext;
 #else
-/*Root of the linked list that holds channel configurations*/
-	ChannelContext *ListHead=NULL;
+/*Hash table that holds channel configurations. Contexts of handles that fall in the same
+bucket are linked through ChannelContext.next*/
+	ChannelContext *ChannelTable[SPI_CHANNEL_TABLE_SIZE];
 #endif
+/*Serializes insertion and removal of channel contexts, lookups take it for reading so they do
+not wait for each other. It is held only while the table is walked, the transfers themselves
+are serialized by the lock of each channel*/
+InfraRWLock ChannelTableLock;
 
 
 /******************************************************************************/
@@ -149,6 +279,31 @@ FTDI_API FT_STATUS SPI_GetChannelInfo(uint32 index,
 	return status;
 }
 
+/*!
+ * \brief Enumerates the SPI channels connected to the host again
+ *
+ * SPI_GetNumChannels, SPI_GetChannelInfo and SPI_OpenChannel work on a list of the channels
+ * that is built the first time one of them is called, so that the USB bus is not enumerated
+ * on every call. This function rebuilds the list
+ *
+ * \param[in] none
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_GetNumChannels
+ * \note Should be called when adapters are plugged or unplugged, for example on the hotplug
+ * notification of the operating system(WM_DEVICECHANGE, udev). SPI_OpenChannel also rebuilds
+ * the list by itself if the device of the channel cannot be opened
+ * \warning The indices of the channels may change when the list is rebuilt
+ */
+FTDI_API FT_STATUS SPI_RefreshChannelList(void)
+{
+	FT_STATUS status;
+	FN_ENTER;
+	status = FT_RefreshChannelList(SPI);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
 /*!
  * \brief Opens a channel and returns a handle to it
  *
@@ -181,6 +336,93 @@ FTDI_API FT_STATUS SPI_OpenChannel(uint32 index, FT_HANDLE *handle)
 	return status;
 }
 
+/*!
+ * \brief Opens the channel with the given serial number and returns a handle to it
+ *
+ * This function opens the channel through FT_OpenEx, without enumerating the devices
+ * connected to the host. Unlike the index, the serial number of a port does not change when
+ * adapters are plugged or unplugged
+ *
+ * \param[in] serialNumber Serial number of the port, eg: "FT123456A" for port A of a dual or
+ *			quad port chip
+ * \param[out] handle Pointer to the handle of the opened channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide). FT_NOT_SUPPORTED
+ * if the port has no MPSSE
+ * \sa SPI_OpenChannel
+ * \note Trying to open an already open channel will return an error code
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_OpenChannelBySerial(const char *serialNumber, FT_HANDLE *handle)
+{
+	FT_STATUS status;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(serialNumber);
+	CHECK_NULL_RET(handle);
+#endif
+	status = SPI_OpenChannelEx((PVOID)serialNumber,FT_OPEN_BY_SERIAL_NUMBER,handle);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Opens the channel with the given location ID and returns a handle to it
+ *
+ * This function opens the channel through FT_OpenEx, without enumerating the devices
+ * connected to the host. The location ID identifies the USB port the adapter is plugged
+ * into, so it stays the same when the adapter is replaced by another one
+ *
+ * \param[in] locationId Location ID of the port(see FT_DEVICE_LIST_INFO_NODE.LocId)
+ * \param[out] handle Pointer to the handle of the opened channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide). FT_NOT_SUPPORTED
+ * if the port has no MPSSE
+ * \sa SPI_OpenChannel
+ * \note Trying to open an already open channel will return an error code
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_OpenChannelByLocation(uint32 locationId, FT_HANDLE *handle)
+{
+	FT_STATUS status;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+#endif
+	status = SPI_OpenChannelEx((PVOID)(size_t)locationId,FT_OPEN_BY_LOCATION,handle);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Opens the channel with the given description and returns a handle to it
+ *
+ * This function opens the channel through FT_OpenEx, without enumerating the devices
+ * connected to the host. The first port whose description matches is opened
+ *
+ * \param[in] description Description of the port, eg: "Dual RS232-HS A"
+ * \param[out] handle Pointer to the handle of the opened channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide). FT_NOT_SUPPORTED
+ * if the port has no MPSSE
+ * \sa SPI_OpenChannel
+ * \note Trying to open an already open channel will return an error code
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_OpenChannelByDescription(const char *description,
+	FT_HANDLE *handle)
+{
+	FT_STATUS status;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(description);
+	CHECK_NULL_RET(handle);
+#endif
+	status = SPI_OpenChannelEx((PVOID)description,FT_OPEN_BY_DESCRIPTION,handle);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
 
 /*!
  * \brief Initializes a channel
@@ -197,75 +439,97 @@ FTDI_API FT_STATUS SPI_OpenChannel(uint32 index, FT_HANDLE *handle)
 FTDI_API FT_STATUS SPI_InitChannel(FT_HANDLE handle, ChannelConfig *config)
 {
 	FT_STATUS status;
-	uint8 buffer[5];
-	uint32 noOfBytes=0;
-	uint32 noOfBytesTransferred;
-	uint8 mode;
+	ChannelContext *context=NULL;
 	FN_ENTER;
 #ifdef ENABLE_PARAMETER_CHECKING
 	CHECK_NULL_RET(config);
 	CHECK_NULL_RET(handle);
 #endif
-	/*This is to ensure that the library puts the lines to correct directions
-	even if wrong values are passed by the user */
-	/* Set initial direction of line SCLK  as OUT */
-	config->Pin |= 0x00000001;/*Note: Direction is out if bit is 1!!! */
-	/* Set initial direction of  MOSI line as OUT */
-	config->Pin |= 0x00000002;
-	/* Set initial direction of MISO line as IN */
-	config->Pin &= 0xFFFFFFFB;
-	/* Set initial direction of CS line as OUT */
-	config->Pin |= \
-		((1<<((config->configOptions & SPI_CONFIG_OPTION_CS_MASK)>>2))<<3);
-
-	/*Set initial state of clock line*/
-	mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-	switch(mode)
-	{
-		case 0:
-		case 1:
-			/* clock idle low */
-			config->Pin &= 0xFFFFFEFF;
-			break;
-
-		case 2:
-		case 3:
-			/* clock idle high */
-			config->Pin |= 0x00000100;
-			break;
-		default:
-			DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
-	}
+	SPI_PrepareConfig(config);
 
+	DBG(MSG_DEBUG,"handle=0x%x ClockRate=%u LatencyTimer=%u Options=0x%x\n",\
+		(unsigned)handle,(unsigned)config->ClockRate,	\
+		(unsigned)config->LatencyTimer,(unsigned)config->configOptions);
 
-	/* Copy initial state values to present state variable */
-	config->currentPinState = (uint16)config->Pin;
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	status = SPI_InitChannelLocked(context,config);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
 
+/*!
+ * \brief Changes the configuration of an initialized channel
+ *
+ * This function applies a new configuration to a channel that has already been initialized by
+ * SPI_InitChannel. Since the MPSSE of the channel is already synchronized, only the latency
+ * timer, clock rate, mode and pin states are changed, with a single USB write, instead of
+ * resetting and synchronizing the chip again
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] config Pointer to ChannelConfig structure with the new configuration
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_InitChannel
+ * \note A channel that has not been initialized yet is initialized by SPI_InitChannel
+ * \note SPI_CONFIG_OPTION_RX_EVENT can be enabled but not disabled this way
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_ReinitChannel(FT_HANDLE handle, ChannelConfig *config)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(config);
+	CHECK_NULL_RET(handle);
+#endif
+	if((config->ClockRate <= MIN_CLOCK_RATE) || (config->ClockRate > MAX_CLOCK_RATE))
+		return FT_INVALID_PARAMETER;
+	SPI_PrepareConfig(config);
 	DBG(MSG_DEBUG,"handle=0x%x ClockRate=%u LatencyTimer=%u Options=0x%x\n",\
 		(unsigned)handle,(unsigned)config->ClockRate,	\
 		(unsigned)config->LatencyTimer,(unsigned)config->configOptions);
-
-	status = FT_InitChannel(SPI,handle,(uint32)config->ClockRate,	\
-		(uint32)config->LatencyTimer,(uint32)config->configOptions,
-		(uint32)config->Pin);
+	status = SPI_LockChannelContext(handle,&context);
 	CHECK_STATUS(status);
-	if(FT_OK == status)
-	{
-		/* Set the directions and values to the lines */
-		buffer[noOfBytes++] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;/*MPSSE command*/
-		buffer[noOfBytes++] = (uint8)((config->currentPinState & 0xFF00)>>8);
-		buffer[noOfBytes++] = (uint8)(config->currentPinState & 0x00FF); /*Dir*/
-		status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-			&noOfBytesTransferred);
-		CHECK_STATUS(status);
+	if(!context->initialized)
+		status = SPI_InitChannelLocked(context,config);
+	else
+		status = SPI_ReinitChannelLocked(context,config);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
 
-		if(FT_OK == status)
-		{
-			DBG(MSG_DEBUG,"line %u handle=0x%x\n",__LINE__,(unsigned)handle);
-			status=SPI_SaveChannelConfig(handle,config);
-			CHECK_STATUS(status);
-		}
-	}
+/*!
+ * \brief Returns the clock rate of a channel
+ *
+ * The MPSSE divides its master clock by an integer, so the SCLK it generates is the nearest
+ * one that it can make to the ClockRate of the configuration(or to the clockRate of the
+ * segment of SPI_TransferList that ran last)
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] clockRate SCLK in Hz that the channel generates, 0 if not initialized
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_InitChannel, SPI_TransferList
+ * \note
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_GetClockRate(FT_HANDLE handle, uint32 *clockRate)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(clockRate);
+#endif
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	*clockRate = context->clock.rate;
+	SPI_UnlockChannelContext(context);
 	FN_EXIT;
 	return status;
 }
@@ -279,12 +543,15 @@ FTDI_API FT_STATUS SPI_InitChannel(FT_HANDLE handle, ChannelConfig *config)
  * \param[out] none
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
  * \sa
- * \note
+ * \note May be called while other threads use the channel. Their calls either complete
+ *		before the channel is closed or return FT_OTHER_ERROR, the resources are freed when
+ *		the last of them returns
  * \warning
  */
 FTDI_API FT_STATUS SPI_CloseChannel(FT_HANDLE handle)
 {
 	FT_STATUS status;
+	ChannelContext *context=NULL;
 	ChannelConfig *config=NULL;
 	uint8 dir,val;
 	uint8 buffer[5];
@@ -294,27 +561,38 @@ FTDI_API FT_STATUS SPI_CloseChannel(FT_HANDLE handle)
 #ifdef ENABLE_PARAMETER_CHECKING
 		CHECK_NULL_RET(handle);
 #endif
-	/* Retrieve final state values for the lines */
-	status = SPI_GetChannelConfig(handle,&config);
-	CHECK_STATUS(status);
-	dir = (uint8)((config->Pin & 0x00FF0000)>>16);
-	val = (config->Pin & 0xFF000000)>>24;
-
-	/* Set lines to final state */
-	buffer[noOfBytes++] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;/* MPSSE command */
-	buffer[noOfBytes++] = val; /*Value*/
-	buffer[noOfBytes++] = dir; /*Direction*/
-	status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-		&noOfBytesTransferred);
+	status = SPI_LockChannelContext(handle,&context);
 	CHECK_STATUS(status);
+	/* Complete the asynchronous transfers that are still in the chip */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	if(FT_OK == status)
+	{
+		/* Retrieve final state values for the lines */
+		config = &context->config;
+		dir = (uint8)((config->Pin & 0x00FF0000)>>16);
+		val = (config->Pin & 0xFF000000)>>24;
 
-	status = FT_CloseChannel(SPI,handle);
-	CHECK_STATUS(status);
+		/* Set lines to final state */
+		buffer[noOfBytes++] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;/* MPSSE command */
+		buffer[noOfBytes++] = val; /*Value*/
+		buffer[noOfBytes++] = dir; /*Direction*/
+		status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
+			&noOfBytesTransferred);
+	}
+	/* Functions that looked the handle up before this point find the channel closed once
+	they get the lock, the context is freed when the last of them returns */
+	if(FT_OK == status)
+		context->closed = TRUE;
+	UNLOCK_CHANNEL(context);
+	SPI_AsyncDeliver(context);
 	if(FT_OK == status)
 	{
-		status=SPI_DelChannelConfig(handle);
-		CHECK_STATUS(status);
+		/* Removed before the handle is closed, as D2XX may hand it out again */
+		SPI_DelChannelConfig(handle);
+		status = FT_CloseChannel(SPI,handle);
 	}
+	SPI_ReleaseChannelContext(context);
+	CHECK_STATUS(status);
 	FN_EXIT;
 	return status;
 }
@@ -336,108 +614,37 @@ FTDI_API FT_STATUS SPI_CloseChannel(FT_HANDLE handle)
  *
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
  * \sa
- * \note
+ * \note May be called from multiple threads. Transfers on the same channel are
+ *		serialized, transfers on different channels proceed in parallel.
+ *		With SPI_CONFIG_OPTION_LSB_FIRST, the bits of a transfer in bits whose size is not a
+ *		multiple of 8 are received into the top bits of the last byte(e.g. bits 7-5 for 3
+ *		bits), not into its bottom bits as when MSB first
  * \warning
  */
 FTDI_API FT_STATUS SPI_Read(FT_HANDLE handle, uint8 *buffer,
 	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
 {
 	FT_STATUS status;
-	//uint32 i;
-	uint8 byte = 0;
-	uint8 bitsToTransfer=0;
+	ChannelContext *context=NULL;
+	uint64 startTime;
 	FN_ENTER;
 #ifdef ENABLE_PARAMETER_CHECKING
 	CHECK_NULL_RET(handle);
 	CHECK_NULL_RET(buffer);
 	CHECK_NULL_RET(sizeTransferred);
 #endif
-	LOCK_CHANNEL(handle);
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
-	{
-		/* Enable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,TRUE);
-		CHECK_STATUS(status);
-	}
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
-	{/*sizeToTransfer is in bits*/
-		*sizeTransferred=0;
-		while(*sizeTransferred<sizeToTransfer)
-		{
-			if((sizeToTransfer - *sizeTransferred)>=8)
-				bitsToTransfer = 8;
-			else
-				bitsToTransfer = (uint8)(sizeToTransfer - *sizeTransferred);
-			status = SPI_Read8bits(handle,&byte, bitsToTransfer);
-			buffer[(*sizeTransferred+1)/8] = byte;
-			CHECK_STATUS(status);
-			if(FT_OK == status)
-				*sizeTransferred += bitsToTransfer;
-		}
-	}
-	else
-	{/*sizeToTransfer is in bytes*/
-		uint32 noOfBytes=0,noOfBytesTransferred=0;
-		uint8 cmdBuffer[10];
-		ChannelConfig *config=NULL;
-		uint8 mode;
-
-		status = SPI_GetChannelConfig(handle,&config);
-		CHECK_STATUS(status);
-		/*mode is given by bit1-bit0 of ChannelConfig.Options*/
-		mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-		/* Command to write 8bits */
-		switch(mode)
-		{
-			case 0:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BYTES_POS_EDGE;
-				break;
-			case 1:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BYTES_NEG_EDGE;
-				break;
-			case 2:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BYTES_NEG_EDGE;
-				break;
-			case 3:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BYTES_POS_EDGE;
-				break;
-			default:
-				DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
-		}
-		/* length LSB */
-		cmdBuffer[noOfBytes++] = (uint8)((sizeToTransfer-1) & 0x000000FF) ;
-		/* length MSB */
-		cmdBuffer[noOfBytes++] = (uint8)(((sizeToTransfer-1) & 0x0000FF00)>>8);
-
-		/*Command MPSSE to send data to PC immediately */
-		cmdBuffer[noOfBytes++] = MPSSE_CMD_SEND_IMMEDIATE;
-		status = FT_Channel_Write(SPI,handle,noOfBytes,cmdBuffer,
-			&noOfBytesTransferred);
-		CHECK_STATUS(status);
-
-		status = FT_Channel_Read(SPI,handle,sizeToTransfer,buffer,
-			sizeTransferred);
-		CHECK_STATUS(status);
-		DBG(MSG_DEBUG,"sizeToTransfer=%u sizeTransferred=%u cmdBuffer[0]=0x%x  \
-			cmdBuffer[1]=0x%x cmdBuffer[2]=0x%x buffer[0]=0x%x buffer[1]=0x%x\n"
-			,sizeToTransfer,sizeTransferred,cmdBuffer[0],cmdBuffer[1],
-			cmdBuffer[2],buffer[0],buffer[1]);
-	}
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
-	{
-		/* Disable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,FALSE);
-		CHECK_STATUS(status);
-	}
-	UNLOCK_CHANNEL(handle);
-	DBG(MSG_DEBUG,"sizeToTransfer=%u  sizeTransferred=%u BitMode=%u \
-		CS_Enable=%u CS_Disable=%u\n", sizeToTransfer,*sizeTransferred,
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS),
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE),
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE));
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_READ,\
+		sizeToTransfer);
+	status = SPI_ReadLocked(context,buffer,sizeToTransfer,sizeTransferred,\
+		transferOptions);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_READ,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_READ,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
 	FN_EXIT;
 	return status;
 }
@@ -459,108 +666,37 @@ FTDI_API FT_STATUS SPI_Read(FT_HANDLE handle, uint8 *buffer,
  *
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
  * \sa
- * \note
+ * \note May be called from multiple threads. Transfers on the same channel are
+ *		serialized, transfers on different channels proceed in parallel.
+ *		With SPI_CONFIG_OPTION_LSB_FIRST, the bits of a transfer in bits whose size is not a
+ *		multiple of 8 are clocked out of the last byte from bit 0 upwards, not from bit 7
+ *		downwards as when MSB first
  * \warning
  */
 FTDI_API FT_STATUS SPI_Write(FT_HANDLE handle, uint8 *buffer,
 	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
 {
 	FT_STATUS status;
-	ChannelConfig *config=NULL;
-	uint8 byte;
-	uint8 bitsToTransfer=0;
+	ChannelContext *context=NULL;
+	uint64 startTime;
 	FN_ENTER;
-
 #ifdef ENABLE_PARAMETER_CHECKING
 	CHECK_NULL_RET(handle);
 	CHECK_NULL_RET(buffer);
 	CHECK_NULL_RET(sizeTransferred);
 #endif
-	LOCK_CHANNEL(handle);
-	status = SPI_GetChannelConfig(handle,&config);
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_WRITE,\
+		sizeToTransfer);
+	status = SPI_WriteLocked(context,buffer,sizeToTransfer,sizeTransferred,\
+		transferOptions);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_WRITE,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_WRITE,startTime);
+	SPI_UnlockChannelContext(context);
 	CHECK_STATUS(status);
-	/* Mode is given by bit1-bit0 of ChannelConfig.Options */
-	DBG(MSG_DEBUG,"configOptions=0x%x\n",(unsigned)config->configOptions);
-	DBG(MSG_DEBUG,"LatencyTimer=%u\n",(unsigned)config->LatencyTimer);
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
-	{
-		/* enable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,TRUE);
-		CHECK_STATUS(status);
-	}
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
-	{/* sizeToTransfer is in bits */
-		*sizeTransferred=0;
-		/* loop until all the bits are transferred */
-		while(*sizeTransferred<sizeToTransfer)
-		{
-			if((sizeToTransfer - *sizeTransferred)>=8)
-				bitsToTransfer = 8;
-			else
-				bitsToTransfer = (uint8)(sizeToTransfer - *sizeTransferred);
-			byte = buffer[(*sizeTransferred+1)/8];
-			status = SPI_Write8bits(handle,byte,bitsToTransfer);
-			CHECK_STATUS(status);
-			if(FT_OK == status)
-				*sizeTransferred += bitsToTransfer;
-		}
-	}
-	else
-	{/* sizeToTransfer is in bytes */
-		uint32 noOfBytes=0,noOfBytesTransferred=0;
-		uint8 cmdBuffer[3];
-		ChannelConfig *config=NULL;
-		uint8 mode;
-
-		status = SPI_GetChannelConfig(handle,&config);
-		CHECK_STATUS(status);
-		/*mode is given by bit1-bit0 of ChannelConfig.Options*/
-		mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-		/* Command to write 8bits */
-		switch(mode)
-		{
-			case SPI_CONFIG_OPTION_MODE0:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BYTES_NEG_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE1:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BYTES_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE2:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BYTES_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE3:
-				cmdBuffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BYTES_NEG_EDGE;
-				break;
-			default:
-				DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
-		}
-		/* length low byte */
-		cmdBuffer[noOfBytes++] = (uint8)((sizeToTransfer-1) & 0x000000FF);
-		/* length high byte */
-		cmdBuffer[noOfBytes++] = (uint8)(((sizeToTransfer-1) & 0x0000FF00)>>8);
-		/* write command */
-		status = FT_Channel_Write(SPI,handle,noOfBytes,cmdBuffer,\
-			&noOfBytesTransferred);
-		CHECK_STATUS(status);
-		/* write data */
-		status = FT_Channel_Write(SPI,handle,sizeToTransfer,buffer,\
-			sizeTransferred);
-		CHECK_STATUS(status);
-	}
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
-	{
-		/* disable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,FALSE);
-		CHECK_STATUS(status);
-	}
-	UNLOCK_CHANNEL(handle);
-	DBG(MSG_DEBUG,"sizeToTransfer=%u  sizeTransferred=%u BitMode=%u \
-		CS_Enable=%u CS_Disable=%u\n",sizeToTransfer,*sizeTransferred,		\
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS),	\
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE),\
-		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE));
 	FN_EXIT;
 	return status;
 }
@@ -585,7 +721,12 @@ FTDI_API FT_STATUS SPI_Write(FT_HANDLE handle, uint8 *buffer,
  *
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
  * \sa
- * \note
+ * \note May be called from multiple threads. Transfers on the same channel are
+ *		serialized, transfers on different channels proceed in parallel.
+ *		With SPI_CONFIG_OPTION_LSB_FIRST, the bits of a transfer in bits whose size is not a
+ *		multiple of 8 are clocked out of the last byte of outBuffer from bit 0 upwards and
+ *		received into the top bits of the last byte of inBuffer(e.g. bits 7-5 for 3 bits),
+ *		instead of from bit 7 downwards and into the bottom bits as when MSB first
  * \warning
  */
 FTDI_API FT_STATUS SPI_ReadWrite(FT_HANDLE handle, uint8 *inBuffer,
@@ -593,160 +734,27 @@ FTDI_API FT_STATUS SPI_ReadWrite(FT_HANDLE handle, uint8 *inBuffer,
 	uint32 transferOptions)
 {
 	FT_STATUS status;
-	ChannelConfig *config=NULL;
-	uint8 mode;
-	uint8 bitsToTransfer=0;
-	uint32 noOfBytes=0,noOfBytesTransferred=0;
-	uint8 cmdBuffer[10];
+	ChannelContext *context=NULL;
+	uint64 startTime;
 	FN_ENTER;
-
 #ifdef ENABLE_PARAMETER_CHECKING
 	CHECK_NULL_RET(handle);
 	CHECK_NULL_RET(inBuffer);
 	CHECK_NULL_RET(outBuffer);
 	CHECK_NULL_RET(sizeTransferred);
 #endif
-
-	LOCK_CHANNEL(handle);
-	status = SPI_GetChannelConfig(handle,&config);
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_READWRITE,\
+		sizeToTransfer);
+	status = SPI_ReadWriteLocked(context,inBuffer,outBuffer,sizeToTransfer,\
+		sizeTransferred,transferOptions);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_READWRITE,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_READWRITE,startTime);
+	SPI_UnlockChannelContext(context);
 	CHECK_STATUS(status);
-
-	/*mode is given by bit1-bit0 of ChannelConfig.Options*/
-	mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
-	{
-		/* enable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,TRUE);
-		CHECK_STATUS(status);
-	}
-
-	/* start of transfer */
-	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
-	{/* sizeToTransfer is in bits */
-		*sizeTransferred=0;
-		/* Command to write 8bits */
-		switch(mode)
-		{
-			case SPI_CONFIG_OPTION_MODE0:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BITS_IN_POS_OUT_NEG_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE1:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BITS_IN_NEG_OUT_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE2:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BITS_IN_NEG_OUT_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE3:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BITS_IN_POS_OUT_NEG_EDGE;
-				break;
-			default:
-				DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
-		}
-		while(*sizeTransferred < sizeToTransfer)
-		{
-			if((sizeToTransfer - *sizeTransferred)>=8)
-				bitsToTransfer = 8;
-			else
-				bitsToTransfer = (uint8)(sizeToTransfer - *sizeTransferred);
-			cmdBuffer[1] = bitsToTransfer - 1; /*takes value 0 for 1 bit; 7 for 8 bits*/
-			cmdBuffer[2] = outBuffer[(*sizeTransferred+1)/8];
-
-			/*Write command and data*/
-			status = FT_Channel_Write(SPI,handle,3,cmdBuffer,\
-				&noOfBytesTransferred);
-			CHECK_STATUS(status);
-			if(3 > noOfBytesTransferred)
-			{/*timeout occured if FT_OK is returned but transferred length is requested len*/
-				DBG(MSG_ERR,"Timeout occured. RequestedTxLen=3 TxLen=%u \n",\
-					(unsigned)noOfBytesTransferred);
-			}
-
-			/*Read from buffer*/
-			status = FT_Channel_Read(SPI,handle,1,\
-				inBuffer+((*sizeTransferred+1)/8),&noOfBytesTransferred);
-			CHECK_STATUS(status);
-			if(1 > noOfBytesTransferred)
-			{/*timeout occured if FT_OK is returned but transferred length is requested len*/
-				DBG(MSG_ERR,"Timeout occured. RequestedTxLen=1 TxLen=%u \n",\
-					(unsigned)noOfBytesTransferred);
-			}
-
-			if(FT_OK == status)
-				*sizeTransferred += bitsToTransfer;
-		}
-	}
-	else
-	{/*sizeToTransfer is in bytes*/
-		*sizeTransferred=0;
-		/* Command to write 8bits */
-		switch(mode)
-		{
-			case SPI_CONFIG_OPTION_MODE0:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BYTES_IN_POS_OUT_NEG_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE1:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BYTES_IN_NEG_OUT_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE2:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BYTES_IN_NEG_OUT_POS_EDGE;
-				break;
-			case SPI_CONFIG_OPTION_MODE3:
-				cmdBuffer[0] = MPSSE_CMD_DATA_BYTES_IN_POS_OUT_NEG_EDGE;
-				break;
-			default:
-				DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
-		}
-		cmdBuffer[1] = (uint8)((sizeToTransfer-1) & 0x000000FF);/* lengthL */
-		cmdBuffer[2] = (uint8)(((sizeToTransfer-1) & 0x0000FF00)>>8);/*lenghtH*/
-
-		/*Write command*/
-		status = FT_Channel_Write(SPI,handle,3,cmdBuffer,&noOfBytesTransferred);
-		CHECK_STATUS(status);
-
-		/*Write data*/
-		noOfBytes = sizeToTransfer;
-		status = FT_Channel_Write(SPI,handle,noOfBytes,outBuffer,\
-			&noOfBytesTransferred);
-		CHECK_STATUS(status);
-		#if 0
-		{//for debugging
-			int i;
-			printf("\nnoOfBytes=%d noOfBytesTransferred=%d data=",noOfBytes,noOfBytesTransferred);
-			for(i=0;i<noOfBytes;i++)
-			{
-				printf(" 0x%x",outBuffer[i]);
-			}
-			printf("\n");
-		}
-		#endif
-
-		/*Read from buffer*/
-		status = FT_Channel_Read(SPI,handle,sizeToTransfer,inBuffer,\
-			sizeTransferred);
-		CHECK_STATUS(status);
-		#if 0
-		{//for debugging
-			int i;
-			printf("\nsizeToTransfer=%d sizeTransferred=%d data=",sizeToTransfer,*sizeTransferred);
-			for(i=0;i<*sizeTransferred;i++)
-			{
-				printf(" 0x%x",outBuffer[i]);
-			}
-			printf("\n");
-		}
-		#endif
-	}
-	/* end of transfer */
-
-	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
-	{
-		/* disable CHIPSELECT line for the channel */
-		status = SPI_ToggleCS(handle,FALSE);
-		CHECK_STATUS(status);
-	}
-	UNLOCK_CHANNEL(handle);
-
 	FN_EXIT;
 	return status;
 }
@@ -767,33 +775,47 @@ FTDI_API FT_STATUS SPI_ReadWrite(FT_HANDLE handle, uint8 *inBuffer,
  */
 FTDI_API FT_STATUS SPI_IsBusy(FT_HANDLE handle, bool *state)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	uint32 noOfBytes=0,noOfBytesTransferred=0;
-	uint8 buffer[10];
-
+	FT_STATUS status;
+	ChannelContext *context=NULL;
 	FN_ENTER;
-	/*Enable CS*/
-	SPI_ToggleCS(handle, TRUE);
-	/*Send command to read*/
-	buffer[noOfBytes++]=MPSSE_CMD_GET_DATA_BITS_LOWBYTE;
-	buffer[noOfBytes++]=MPSSE_CMD_SEND_IMMEDIATE;
-	status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-		&noOfBytesTransferred);
+	status = SPI_LockChannelContext(handle,&context);
 	CHECK_STATUS(status);
-
-	/*Read*/
-	noOfBytes=1;
-	noOfBytesTransferred=0;
-	status = FT_Channel_Read(SPI,handle,noOfBytes,buffer,&noOfBytesTransferred);
+	status = SPI_IsBusyLocked(context,state);
+	SPI_UnlockChannelContext(context);
 	CHECK_STATUS(status);
-	DBG(MSG_DEBUG,"Low byte read = 0x%x\n",buffer[0]);
-	if(0 == (buffer[0] && 0x04))
-		*state=FALSE;
-	else
-		*state=TRUE;
+	FN_EXIT;
+	return status;
+}
 
-	/*Disable CS*/
-	SPI_ToggleCS(handle, FALSE);
+/*!
+ * \brief Waits until the SPI slave is no longer busy
+ *
+ * This function makes the MPSSE wait on its GPIOL1 pin(ADBUS5), which the slave drives low
+ * while it is busy(high if SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH was given), and returns once the
+ * chip reports that the line has changed. Unlike polling with SPI_IsBusy, the host sends one
+ * command and does a single read however long the slave stays busy
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] timeout Maximum time to wait in milliseconds, 0 for the read timeout of the
+ *			channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_IsBusy, SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY
+ * \note FT_NOT_SUPPORTED is returned for FT2232D, which has no wait on I/O commands, and
+ *		FT_INVALID_PARAMETER if ADBUS5 is an output of the channel(e.g. the chip select).
+ *		FT_IO_ERROR is returned if the slave is still busy when the timeout expires, the MPSSE
+ *		is then reset and the channel configured again so that it can be used further
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_WaitWhileBusy(FT_HANDLE handle, uint32 timeout)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	status = SPI_WaitWhileBusyLocked(context,timeout);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
 	FN_EXIT;
 	return status;
 }
@@ -815,7 +837,13 @@ FTDI_API FT_STATUS SPI_IsBusy(FT_HANDLE handle, bool *state)
  *			 : 011 - A/B/C/D_DBUS6=ChipSelect
  *			 : 100 - A/B/C/D_DBUS7=ChipSelect
  *	BIT5: ChipSelect is active high if this bit is 0
- *	BIT6 -BIT31		: Reserved
+ *	BIT6: Wait for received data on an event(ignored, taken from SPI_InitChannel)
+ *	BIT7: Busy line is high while the slave is busy(SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH)
+ *	BIT9 -BIT8: Ignored, the clocking is kept as SPI_InitChannel or SPI_ReinitChannel set it
+ *	BIT10: BIT4-BIT2 select ACBUS0-ACBUS7 as ChipSelect(SPI_CONFIG_OPTION_CS_ACBUS)
+ *	BIT11: Data is clocked LSB first(SPI_CONFIG_OPTION_LSB_FIRST)
+ *	BIT12: Ignored, the CS hold is kept as SPI_InitChannel or SPI_ReinitChannel set it
+ *	BIT13 -BIT31	: Reserved
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
  * \sa
  * \note This function should only be called after SPI_Init has been called
@@ -826,23 +854,34 @@ FTDI_API FT_STATUS SPI_ChangeCS(FT_HANDLE handle, uint32 configOptions)
 	FT_STATUS status=FT_OTHER_ERROR;
 	uint8 mode;
 #if 1
-	uint8 buffer[5];
+	uint8 buffer[SPI_PIN_CMDS_SIZE];
 	uint32 noOfBytes=0;
 	uint32 noOfBytesTransferred;
 #endif
+	ChannelContext *context=NULL;
 	ChannelConfig *config=NULL;
 	FN_ENTER;
 #ifdef ENABLE_PARAMETER_CHECKING
 	CHECK_NULL_RET(handle);
 #endif
 
-	status = SPI_GetChannelConfig(handle,&config);
+	status = SPI_LockChannelContext(handle,&context);
 	CHECK_STATUS(status);
-	/* Replace config options with new values */
-	config->configOptions = configOptions;
+	status = SPI_CheckCSPin(context->ftDevice,configOptions);
+	if(FT_OK != status)
+	{
+		SPI_UnlockChannelContext(context);
+		return status;
+	}
+	config = &context->config;
+	/* Replace config options with new values, the clock commands are not sent again and
+	csHoldCycles, which is not changed, keeps being used or not */
+	config->configOptions = (configOptions & \
+		~(SPI_CONFIG_OPTION_CLOCK_MASK | SPI_CONFIG_OPTION_CS_HOLD)) | \
+		(config->configOptions & (SPI_CONFIG_OPTION_CLOCK_MASK | SPI_CONFIG_OPTION_CS_HOLD));
 	/* Ensure new CS lins is set as OUT */
-	config->currentPinState |= \
-		((1<<((config->configOptions & SPI_CONFIG_OPTION_CS_MASK)>>2))<<3);
+	config->currentPinState |= SPI_CS_LOW_PIN(config->configOptions);
+	SPI_PrepareCSHigh(context,config->configOptions);
 
 	DBG(MSG_DEBUG,"handle=0x%x configOptions=0x%x \n",\
 		(unsigned)handle,(unsigned)configOptions);
@@ -866,512 +905,3304 @@ FTDI_API FT_STATUS SPI_ChangeCS(FT_HANDLE handle, uint32 configOptions)
 			DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
 	}
 
-	buffer[noOfBytes++] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;/* MPSSE command */
-	buffer[noOfBytes++] = (uint8)((config->currentPinState & 0xFF00)>>8);/*Val*/
-	buffer[noOfBytes++] = (uint8)(config->currentPinState & 0x00FF); /*Dir*/
-
-	status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-			&noOfBytesTransferred);
-	CHECK_STATUS(status);
+	/* Nothing is written if the lines are already in this state */
+	SPI_GetPinCmds(context,config->currentPinState,buffer,&noOfBytes);
 
-	status=SPI_SaveChannelConfig(handle,config);
+	/* The new state is kept in the channel's context, so it is seen by the next
+	transfer as soon as the lock is released */
+	if(noOfBytes > 0)
+	{
+		status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
+				&noOfBytesTransferred);
+		if(FT_OK != status)
+			context->pins.lowKnown = context->pins.highKnown = FALSE;
+	}
+	else
+		status = FT_OK;
+	SPI_UnlockChannelContext(context);
 	CHECK_STATUS(status);
 
 	FN_EXIT;
 	return status;
 }
 
-/******************************************************************************/
-/*						Local function definations						  */
-/******************************************************************************/
-
 /*!
- * \brief Allocates storage in the system to store channel configuration data
+ * \brief Starts an asynchronous read from a SPI slave device
  *
- * This function adds a link in a linked list to store channel configuration
- * information when they are passed by the user in SPI_OpenChannel.
+ * This function sends the commands that read the specified number of bits or bytes from the
+ * SPI device to the chip and returns without waiting for the data. The data is stored in the
+ * buffer when the transfer completes
  *
  * \param[in] handle Handle of the channel
+ * \param[in] *buffer Pointer to buffer to where data will be read to. It must remain valid
+ *			until the transfer completes
+ * \param[in] sizeToTransfer Size of data to be transfered
+ * \param[in] transferOptions This parameter specifies data transfer options(see SPI_Read)
+ * \param[in] callback Function to be called when the transfer completes(may be NULL)
+ * \param[in] userData Passed to the callback as it is
+ * \param[out] ticket Pointer to variable in which the ticket of the transfer is returned
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note This function should be called after a channel has been successfully
- *	     opened and a handle to it has been assigned
- * \warning
+ * \sa SPI_Wait, SPI_Poll
+ * \note Completion is reported by SPI_Wait, SPI_Poll or any other function of the channel
+ *		that has to read from the chip. Transfers of a channel complete in the order in which
+ *		they were started
+ * \warning The callback must not close the channel
  */
-FT_STATUS SPI_AddChannelConfig(FT_HANDLE handle)
+FTDI_API FT_STATUS SPI_ReadAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	ChannelContext *tempNode=NULL;
-	ChannelContext *lastNode=NULL;
+	FT_STATUS status;
 	FN_ENTER;
-	DBG(MSG_DEBUG,"line %u handle=0x%x\n",__LINE__,(unsigned)handle);
-
-#ifdef NO_LINKED_LIST
-	status = FT_OK;
-#else
-	if(NULL == ListHead)
-	{/* Add first node */
-		ListHead = (ChannelContext *) INFRA_MALLOC(sizeof(ChannelContext));
-		if(NULL == ListHead)
-		{
-			status = FT_INSUFFICIENT_RESOURCES;
-			DBG(MSG_ERR,"Failed allocating memory\n");
-		}
-		else
-		{
-			ListHead->handle = handle;
-			ListHead->next = NULL;
-			status = FT_OK;
-		}
-	}
-	else
-	{/* Add subsequent nodes */
-		/* Traverse list */
-		for(tempNode=ListHead; NULL != tempNode; tempNode=tempNode->next)
-		{
-			lastNode=tempNode;
-		}
-		tempNode = (ChannelContext *) INFRA_MALLOC(sizeof(ChannelContext));
-		if(NULL == tempNode)
-		{
-			status = FT_INSUFFICIENT_RESOURCES;
-			DBG(MSG_ERR,"Failed allocating memory\n");
-		}
-		else
-		{
-			tempNode->handle = handle;
-			tempNode->next = NULL;
-			lastNode->next = tempNode;
-			status = FT_OK;
-		}
-	}
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(buffer);
+	CHECK_NULL_RET(ticket);
 #endif
+	status = SPI_AsyncSubmit(handle,buffer,NULL,sizeToTransfer,transferOptions,\
+		callback,userData,ticket);
+	CHECK_STATUS(status);
 	FN_EXIT;
-#ifdef INFRA_DEBUG_ENABLE
-	SPI_DisplayList();
-#endif
 	return status;
 }
 
 /*!
- * \brief Deletes storage allocated for channel configuration data
+ * \brief Starts an asynchronous write to a SPI slave device
  *
- * This function traverses the channel configuration data linked list,
- * finds the channel with the given handle and then deletes it
+ * This function sends the specified number of bits or bytes to the chip and returns without
+ * waiting for the chip to clock them out
  *
  * \param[in] handle Handle of the channel
+ * \param[in] *buffer Pointer to buffer containing the data
+ * \param[in] sizeToTransfer Size of data to be transfered
+ * \param[in] transferOptions This parameter specifies data transfer options(see SPI_Write)
+ * \param[in] callback Function to be called when the transfer completes(may be NULL)
+ * \param[in] userData Passed to the callback as it is
+ * \param[out] ticket Pointer to variable in which the ticket of the transfer is returned
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note
- * \warning
+ * \sa SPI_Wait, SPI_Poll
+ * \note The buffer may be reused as soon as this function returns. A write completes when
+ *		all the transfers started before it have completed
+ * \warning The callback must not close the channel
  */
-FT_STATUS SPI_DelChannelConfig(FT_HANDLE handle)
+FTDI_API FT_STATUS SPI_WriteAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	ChannelContext *tempNode;
-	ChannelContext *lastNode=NULL;
+	FT_STATUS status;
 	FN_ENTER;
-
-#ifdef NO_LINKED_LIST
-	status = FT_OK;
-#else
-	if(NULL == ListHead)
-	{
-		DBG(MSG_NOTICE,"List is empty\n");
-	}
-	else
-	{
-		for(tempNode=ListHead; NULL != tempNode;
-			lastNode=tempNode, tempNode=tempNode->next)
-		{
-			if(tempNode->handle == handle)
-			{/*Node found*/
-				if(tempNode == ListHead)
-				{/* Is the first node */
-					INFRA_FREE(ListHead);
-					ListHead = NULL;
-				}
-				else if(NULL == tempNode->next)
-				{/*Last node*/
-					lastNode->next = NULL;
-					INFRA_FREE(tempNode);
-				}
-				else
-				{/* Middle node */
-					lastNode->next = tempNode->next;
-					INFRA_FREE(tempNode);
-				}
-				status = FT_OK;
-				break;
-			}
-		}
-	}
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(buffer);
+	CHECK_NULL_RET(ticket);
 #endif
-	status=FT_OK;
+	status = SPI_AsyncSubmit(handle,NULL,buffer,sizeToTransfer,transferOptions,\
+		callback,userData,ticket);
+	CHECK_STATUS(status);
 	FN_EXIT;
-#ifdef INFRA_DEBUG_ENABLE
-	SPI_DisplayList();
-#endif
 	return status;
 }
 
-
 /*!
- * \brief Saves the channel's configuration data
+ * \brief Starts an asynchronous full duplex transfer with a SPI slave device
  *
- * This function traverses the channel configuration data linked list
- * and if the node with the provided handle is founed then saves the
- * channel configuration data that is provided into the memory locations
- * that were previously allocated using SPI_AddChannelConfig
+ * This function sends the data to be clocked out to the chip and returns without waiting
+ * for the data clocked in. The data clocked in is stored in inBuffer when the transfer
+ * completes
  *
  * \param[in] handle Handle of the channel
- * \param[in] config Pointer to ChannelConfig structure
+ * \param[in] *inBuffer Pointer to buffer to which data read will be stored. It must remain
+ *			valid until the transfer completes
+ * \param[in] *outBuffer Pointer to buffer that contains data to be transferred to the slave
+ * \param[in] sizeToTransfer Size of data to be transferred
+ * \param[in] transferOptions This parameter specifies data transfer options(see SPI_ReadWrite)
+ * \param[in] callback Function to be called when the transfer completes(may be NULL)
+ * \param[in] userData Passed to the callback as it is
+ * \param[out] ticket Pointer to variable in which the ticket of the transfer is returned
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note
- * \warning
+ * \sa SPI_Wait, SPI_Poll
+ * \note outBuffer may be reused as soon as this function returns
+ * \warning The callback must not close the channel
  */
-FT_STATUS SPI_SaveChannelConfig(FT_HANDLE handle, ChannelConfig *config)
+FTDI_API FT_STATUS SPI_ReadWriteAsync(FT_HANDLE handle, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 transferOptions,
+	SPI_CALLBACK callback, void *userData, uint32 *ticket)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	ChannelContext *tempNode=NULL;
+	FT_STATUS status;
 	FN_ENTER;
-
-#ifdef NO_LINKED_LIST
-		memcpy(&channelContext.config,config,sizeof(ChannelConfig));
-		channelContext.handle = handle;
-		status = FT_OK;
-#else
-	if(NULL == ListHead)
-	{
-		DBG(MSG_NOTICE,"List is empty\n");
-	}
-	else
-	{
-		tempNode = ListHead;
-		for(tempNode = ListHead; 0 != tempNode; tempNode=tempNode->next)
-		{
-			DBG(MSG_DEBUG,"line=%d tempNode->handle=0x%x handle=0x%x tempNode->\
-				next=0x%x\n",__LINE__,(unsigned)tempNode->handle,
-				(unsigned)handle, (unsigned)tempNode->next);
-			if(tempNode->handle == handle)
-			{/*Node found*/
-				INFRA_MEMCPY(&(tempNode->config),config,sizeof(ChannelConfig));
-				status = FT_OK;
-			}
-		}
-	}
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(inBuffer);
+	CHECK_NULL_RET(outBuffer);
+	CHECK_NULL_RET(ticket);
 #endif
-
+	status = SPI_AsyncSubmit(handle,inBuffer,outBuffer,sizeToTransfer,\
+		transferOptions,callback,userData,ticket);
+	CHECK_STATUS(status);
 	FN_EXIT;
-#ifdef INFRA_DEBUG_ENABLE
-		SPI_DisplayList();
-#endif
 	return status;
 }
 
 /*!
- * \brief Retrieves the pointer to the channel's configuration data
+ * \brief Waits for an asynchronous transfer to complete
  *
- * This function traverses the channel configuration data linked list
- * and if the node with the provided handle is founed then it provides
- * the address of the associated channel configuration data structure
- * in the pointer provided in the second parameter of the function
+ * This function blocks until the transfer with the given ticket, and all the transfers of
+ * the channel that were started before it, have completed
  *
  * \param[in] handle Handle of the channel
- * \param[in] config Pointer to ChannelConfig structure
- * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note
+ * \param[in] ticket Ticket returned when the transfer was started
+ * \param[out] sizeTransferred Pointer to variable containing the size of data that got
+ *			transferred(may be NULL)
+ * \return Returns the status of the transfer
+ * \sa SPI_Poll
+ * \note A ticket can be waited for until SPI_ASYNC_QUEUE_SIZE newer transfers have been
+ *		started on the channel. Waiting for an older ticket returns FT_INVALID_PARAMETER
+ *		A transfer whose data comes back short, or not at all, returns FT_IO_ERROR, and so
+ *		do the transfers that were started after it, as their data can no longer be told
+ *		apart. The channel is then resynchronized, which leaves CS in the state that the
+ *		last of the transfers asked for
  * \warning
  */
-FT_STATUS SPI_GetChannelConfig(FT_HANDLE handle, ChannelConfig **config)
+FTDI_API FT_STATUS SPI_Wait(FT_HANDLE handle, uint32 ticket,
+	uint32 *sizeTransferred)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	ChannelContext *tempNode=NULL;
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
 	FN_ENTER;
-
-#ifdef NO_LINKED_LIST
-		if(handle == channelContext.handle)
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_WAIT,\
+		ticket);
+	status = SPI_WaitLocked(context,ticket,sizeTransferred);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_WAIT,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_WAIT,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Completes the asynchronous transfers whose data has arrived
+ *
+ * This function completes, without blocking, the asynchronous transfers of the channel whose
+ * data is already waiting in the D2XX driver and calls their callbacks
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] noOfPending Pointer to variable in which the number of transfers that are still
+ *			in progress is returned(may be NULL)
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_Wait
+ * \note An event loop may call this function for each of its channels to keep all of them
+ *		busy from a single thread
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_Poll(FT_HANDLE handle, uint32 *noOfPending)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+#endif
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,FALSE);
+	if(NULL != noOfPending)
+		*noOfPending = context->asyncNext - context->asyncCompleted;
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Performs a list of transfers as one transaction
+ *
+ * This function compiles a list of transfers, in the manner of the spi_ioc_transfer array of
+ * Linux spidev, into a single stream of MPSSE commands. The stream is sent to the chip with one
+ * USB write and the data clocked in by all the segments is read back afterwards, so a sequence
+ * such as command, address, dummy cycles and data costs a single round trip
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] segments Array of segments, performed in order. Each segment may select or
+ *			deselect the chip(transferOptions), wait for the slave to be ready before it
+ *			starts(SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY), wait a number of SCLK cycles after
+ *			its data(delayCycles) and use its own clock rate and SPI mode
+ * \param[in] noOfSegments Number of segments in the array
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ReadWrite, SPI_WaitWhileBusy
+ * \note The clock rate and mode of the channel are restored at the end of the list. A list
+ *		that reads more than SPI_ASYNC_MAX_READ_PENDING bytes is split into several round
+ *		trips, at segment boundaries. A wait on the busy line is bounded by the read timeout
+ *		of the channel if the list reads data after it, the channel is then recovered as in
+ *		SPI_WaitWhileBusy. A list that only writes returns without waiting for the slave
+ * \warning The mode should only be changed by a segment that starts with the chip
+ *		deselected, since it moves the idle level of SCLK
+ */
+FTDI_API FT_STATUS SPI_TransferList(FT_HANDLE handle, const SpiSegment *segments,
+	uint32 noOfSegments)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(segments);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_TRANSFER_LIST,\
+		noOfSegments);
+	status = SPI_TransferListLocked(context,segments,noOfSegments);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_TRANSFER_LIST,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_TRANSFER_LIST,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Attaches a slave to a channel
+ *
+ * This function records the SPI mode, chip select and clock rate of one of the slaves
+ * connected to a channel and returns a handle through which the slave is accessed. A transfer
+ * on the handle of a slave first switches the channel to the settings of the slave, appending
+ * only the commands of the settings that differ from those the chip already has(the idle
+ * level of SCLK, the clock divisor and the chip select pin) to the commands of the transfer,
+ * so that they go to the chip in the same USB write. Slaves with different settings may so be
+ * accessed in turn without SPI_ChangeCS or SPI_ReinitChannel calls in between
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] configOptions Mode, chip select and polarities of the slave, as in
+ *			ChannelConfig.configOptions
+ *	BIT1-0=CPOL-CPHA:	SPI mode of the slave(SPI_CONFIG_OPTION_MODE0-3)
+ *	BIT4-BIT2: Chip select of the slave(SPI_CONFIG_OPTION_CS_DBUS3-7)
+ *	BIT5: ChipSelect is active high if this bit is 0
+ *	BIT7: Busy line is high while the slave is busy(SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH)
+ *	BIT10: BIT4-BIT2 select ACBUS0-ACBUS7 as ChipSelect(SPI_CONFIG_OPTION_CS_ACBUS)
+ *	BIT11: Data of the slave is clocked LSB first(SPI_CONFIG_OPTION_LSB_FIRST)
+ *	The other bits are ignored, they are those given to SPI_InitChannel
+ * \param[in] clockRate SPI clock rate of the slave, value should be <= 30000000
+ * \param[out] device Pointer to variable in which the handle of the slave is returned
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_DetachDevice, SPI_DeviceRead, SPI_DeviceWrite, SPI_DeviceReadWrite,
+ *		SPI_DeviceTransferList
+ * \note The channel must have been initialized by SPI_InitChannel. Transfers on the handle of
+ *		the channel use the settings of the slave that was accessed last
+ * \warning The handle of the slave must be released with SPI_DetachDevice, also after the
+ *		channel has been closed
+ */
+FTDI_API FT_STATUS SPI_AttachDevice(FT_HANDLE handle, uint32 configOptions,
+	uint32 clockRate, SPI_DEVICE *device)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	SpiDevice *newDevice=NULL;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(device);
+#endif
+	configOptions &= SPI_DEVICE_OPTIONS_MASK;
+	if((clockRate <= MIN_CLOCK_RATE) || (clockRate > MAX_CLOCK_RATE) || \
+		(!(configOptions & SPI_CONFIG_OPTION_CS_ACBUS) && \
+		((configOptions & SPI_CONFIG_OPTION_CS_MASK) > SPI_CONFIG_OPTION_CS_DBUS7)))
+		return FT_INVALID_PARAMETER;
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	if(!context->initialized)
+	{
+		DBG(MSG_ERR,"channel not initialized\n");
+		status = FT_DEVICE_NOT_OPENED;
+	}
+	else
+		status = SPI_CheckCSPin(context->ftDevice,configOptions);
+	if((FT_OK == status) && \
+		(context->config.configOptions & SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING) && \
+		(SPI_CS_LOW_PIN(configOptions) & SPI_RTCK_PIN))
+	{
+		DBG(MSG_ERR,"return clock pin(ADBUS7) can not be a chip select\n");
+		status = FT_INVALID_PARAMETER;
+	}
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	newDevice = (SpiDevice *) INFRA_MALLOC(sizeof(SpiDevice));
+	if(NULL == newDevice)
+	{
+		DBG(MSG_ERR,"Failed allocating memory\n");
+		return FT_INSUFFICIENT_RESOURCES;
+	}
+	newDevice->handle = handle;
+	newDevice->configOptions = configOptions;
+	newDevice->clockRate = clockRate;
+	*device = (SPI_DEVICE)newDevice;
+	DBG(MSG_DEBUG,"handle=0x%x configOptions=0x%x clockRate=%u\n",\
+		(unsigned)handle,(unsigned)configOptions,(unsigned)clockRate);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Detaches a slave from its channel
+ *
+ * This function releases the handle of a slave returned by SPI_AttachDevice
+ *
+ * \param[in] device Handle of the slave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AttachDevice
+ * \note The pins of the channel are left as they are
+ * \warning The handle must not be used any more, nor be in use by another thread
+ */
+FTDI_API FT_STATUS SPI_DetachDevice(SPI_DEVICE device)
+{
+	FT_STATUS status=FT_OK;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(device);
+#endif
+	INFRA_FREE(device);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reads data from a slave attached with SPI_AttachDevice
+ *
+ * \param[in] device Handle of the slave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_Read, SPI_AttachDevice
+ * \note The other parameters are the same as those of SPI_Read. FT_OTHER_ERROR is
+ *		returned once the channel of the slave has been closed
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_DeviceRead(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(device);
+	CHECK_NULL_RET(buffer);
+	CHECK_NULL_RET(sizeTransferred);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(((SpiDevice *)device)->handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_READ,\
+		sizeToTransfer);
+	status = SPI_SelectDeviceLocked(context,(SpiDevice *)device);
+	if(FT_OK == status)
+	{
+		status = SPI_ReadLocked(context,buffer,sizeToTransfer,sizeTransferred,\
+			transferOptions);
+	}
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_READ,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_READ,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Writes data to a slave attached with SPI_AttachDevice
+ *
+ * \param[in] device Handle of the slave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_Write, SPI_AttachDevice
+ * \note The other parameters are the same as those of SPI_Write. FT_OTHER_ERROR is
+ *		returned once the channel of the slave has been closed
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_DeviceWrite(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(device);
+	CHECK_NULL_RET(buffer);
+	CHECK_NULL_RET(sizeTransferred);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(((SpiDevice *)device)->handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_WRITE,\
+		sizeToTransfer);
+	status = SPI_SelectDeviceLocked(context,(SpiDevice *)device);
+	if(FT_OK == status)
+	{
+		status = SPI_WriteLocked(context,buffer,sizeToTransfer,sizeTransferred,\
+			transferOptions);
+	}
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_WRITE,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_WRITE,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reads from and writes to a slave attached with SPI_AttachDevice simultaneously
+ *
+ * \param[in] device Handle of the slave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ReadWrite, SPI_AttachDevice
+ * \note The other parameters are the same as those of SPI_ReadWrite. FT_OTHER_ERROR is
+ *		returned once the channel of the slave has been closed
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_DeviceReadWrite(SPI_DEVICE device, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
+	uint32 transferOptions)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(device);
+	CHECK_NULL_RET(inBuffer);
+	CHECK_NULL_RET(outBuffer);
+	CHECK_NULL_RET(sizeTransferred);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(((SpiDevice *)device)->handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_READWRITE,\
+		sizeToTransfer);
+	status = SPI_SelectDeviceLocked(context,(SpiDevice *)device);
+	if(FT_OK == status)
+	{
+		status = SPI_ReadWriteLocked(context,inBuffer,outBuffer,sizeToTransfer,\
+			sizeTransferred,transferOptions);
+	}
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_READWRITE,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_READWRITE,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Performs a list of transfers on a slave attached with SPI_AttachDevice
+ *
+ * \param[in] device Handle of the slave
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_TransferList, SPI_AttachDevice
+ * \note The other parameters are the same as those of SPI_TransferList. Segments whose
+ *		clockRate or mode is 0 use those of the slave. FT_OTHER_ERROR is returned once the
+ *		channel of the slave has been closed
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_DeviceTransferList(SPI_DEVICE device, const SpiSegment *segments,
+	uint32 noOfSegments)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint64 startTime;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(device);
+	CHECK_NULL_RET(segments);
+#endif
+	startTime = Infra_GetNanoseconds();
+	status = SPI_LockChannelContext(((SpiDevice *)device)->handle,&context);
+	CHECK_STATUS(status);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_TRANSFER_LIST,\
+		noOfSegments);
+	status = SPI_SelectDeviceLocked(context,(SpiDevice *)device);
+	if(FT_OK == status)
+		status = SPI_TransferListLocked(context,segments,noOfSegments);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_TRANSFER_LIST,\
+		status);
+	SPI_StatsRecord(context,SPI_STATS_CALL_TRANSFER_LIST,startTime);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reverses the order of the bits of each byte of a buffer
+ *
+ * This function turns data that is MSB first into LSB first and the other way round, for
+ * streams in which only some of the fields are in the bit order that the channel does not
+ * clock(see SPI_CONFIG_OPTION_LSB_FIRST). It handles 16 or 32 bytes per step with the SSE2,
+ * SSSE3, AVX2 or NEON instructions that the library was compiled for and 8 bytes per step
+ * without them
+ *
+ * \param[in,out] buffer Data whose bytes are reversed in place
+ * \param[in] size Number of bytes in the buffer
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_CONFIG_OPTION_LSB_FIRST
+ * \note Does not need an open channel
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_ReverseBits(uint8 *buffer, uint32 size)
+{
+	FT_STATUS status=FT_OK;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(buffer);
+#endif
+	Infra_ReverseBits(buffer,size);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Gets the statistics of a channel
+ *
+ * This function returns the counters of the traffic of a channel and the histograms of the
+ * time taken by its transfer functions, collected since the channel was opened or since
+ * SPI_ResetStats was last called
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] stats Pointer to the structure in which the statistics are returned
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ResetStats, SPI_STATS_BIN_LOWER_US
+ * \note The channel is not locked, so this function does not wait for a transfer of another
+ *		thread to complete. Each counter is read whole, but while a transfer is in progress
+ *		the counters may not agree with one another(e.g. bytesOut may already count data
+ *		whose USB write is not yet counted in usbBytesWritten)
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_GetStats(FT_HANDLE handle, SpiStats *stats)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint32 call,bin;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(stats);
+#endif
+	status = SPI_GetChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	stats->bytesOut = INFRA_ATOMIC_LOAD64(&context->stats.bytesOut);
+	stats->bytesIn = INFRA_ATOMIC_LOAD64(&context->stats.bytesIn);
+	stats->usbBytesWritten = INFRA_ATOMIC_LOAD64(&context->cmdBuffer.noOfBytesWritten);
+	stats->usbBytesRead = INFRA_ATOMIC_LOAD64(&context->stats.usbBytesRead);
+	stats->usbWrites = INFRA_ATOMIC_LOAD32(&context->cmdBuffer.noOfWrites);
+	stats->usbReads = INFRA_ATOMIC_LOAD32(&context->stats.usbReads);
+	stats->transactions = INFRA_ATOMIC_LOAD32(&context->stats.transactions);
+	stats->csToggles = INFRA_ATOMIC_LOAD32(&context->stats.csToggles);
+	stats->timeouts = INFRA_ATOMIC_LOAD32(&context->stats.timeouts);
+	stats->shortReads = INFRA_ATOMIC_LOAD32(&context->stats.shortReads);
+	for(call=0;call<SPI_STATS_NO_OF_CALLS;call++)
+	{
+		for(bin=0;bin<SPI_STATS_HISTOGRAM_BINS;bin++)
+		{
+			stats->latency[call][bin] = \
+				INFRA_ATOMIC_LOAD32(&context->stats.latency[call][bin]);
+		}
+	}
+	SPI_ReleaseChannelContext(context);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Clears the statistics of a channel
+ *
+ * \param[in] handle Handle of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_GetStats
+ * \note The channel is locked, so that no transfer is counted in part
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_ResetStats(FT_HANDLE handle)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint32 call,bin;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+#endif
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	/* SPI_GetStats may be reading the counters */
+	INFRA_ATOMIC_STORE64(&context->stats.bytesOut,0);
+	INFRA_ATOMIC_STORE64(&context->stats.bytesIn,0);
+	INFRA_ATOMIC_STORE64(&context->cmdBuffer.noOfBytesWritten,0);
+	INFRA_ATOMIC_STORE64(&context->stats.usbBytesRead,0);
+	INFRA_ATOMIC_STORE32(&context->cmdBuffer.noOfWrites,0);
+	INFRA_ATOMIC_STORE32(&context->stats.usbReads,0);
+	INFRA_ATOMIC_STORE32(&context->stats.transactions,0);
+	INFRA_ATOMIC_STORE32(&context->stats.csToggles,0);
+	INFRA_ATOMIC_STORE32(&context->stats.timeouts,0);
+	INFRA_ATOMIC_STORE32(&context->stats.shortReads,0);
+	for(call=0;call<SPI_STATS_NO_OF_CALLS;call++)
+	{
+		for(bin=0;bin<SPI_STATS_HISTOGRAM_BINS;bin++)
+			INFRA_ATOMIC_STORE32(&context->stats.latency[call][bin],0);
+	}
+	SPI_UnlockChannelContext(context);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Sets what is recorded in the trace of a channel
+ *
+ * Each channel can record timestamped events in a ring buffer of SPI_TRACE_BUFFER_SIZE events,
+ * overwriting the oldest ones. Recording an event takes about 30 nanoseconds, mostly to read the
+ * clock, and a transfer call records 2 to 6 events depending on the level, so the trace adds
+ * about 50 to 200 nanoseconds per call. It may so be left enabled and read with SPI_GetTrace or
+ * SPI_DumpTrace when something goes wrong
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] level SPI_TRACE_LEVEL_xxx
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_GetTrace, SPI_DumpTrace
+ * \note The ring buffer is allocated the first time the trace is enabled and freed when the
+ *		channel is closed. Turning the trace off keeps the events recorded so far
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_SetTraceLevel(FT_HANDLE handle, uint32 level)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+#endif
+	if(level > SPI_TRACE_LEVEL_CMDS)
+		return FT_INVALID_PARAMETER;
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	if((SPI_TRACE_LEVEL_OFF != level) && (NULL == context->trace))
+	{
+		context->trace = (SpiTraceEvent*)INFRA_MALLOC(sizeof(SpiTraceEvent)*\
+			SPI_TRACE_BUFFER_SIZE);
+		if(NULL == context->trace)
+			status = FT_INSUFFICIENT_RESOURCES;
+	}
+	if(FT_OK == status)
+	{
+		context->traceLevel = level;
+		/* USB writes are issued by the command buffer of the middle layer */
+		context->cmdBuffer.writeHook = (level >= SPI_TRACE_LEVEL_USB)?\
+			SPI_TraceWriteHook:NULL;
+		context->cmdBuffer.hookContext = context;
+	}
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Copies the events recorded in the trace of a channel
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] events Array in which the most recent events are returned, oldest first
+ * \param[in] maxEvents Number of elements of events
+ * \param[out] noOfEvents Number of events returned
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_SetTraceLevel, SPI_DumpTrace
+ * \note
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_GetTrace(FT_HANDLE handle, SpiTraceEvent *events,
+	uint32 maxEvents, uint32 *noOfEvents)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	uint32 first;
+	uint32 i;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(events);
+	CHECK_NULL_RET(noOfEvents);
+#endif
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	*noOfEvents = 0;
+	if(NULL != context->trace)
+	{
+		*noOfEvents = (context->traceNext < SPI_TRACE_BUFFER_SIZE)?context->traceNext:\
+			SPI_TRACE_BUFFER_SIZE;
+		if(*noOfEvents > maxEvents)
+			*noOfEvents = maxEvents;
+		first = context->traceNext - *noOfEvents;
+		for(i=0;i<*noOfEvents;i++)
+			events[i] = context->trace[(first+i) & (SPI_TRACE_BUFFER_SIZE-1)];
+	}
+	SPI_UnlockChannelContext(context);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Writes the events recorded in the trace of a channel to a file
+ *
+ * The file starts with a SpiTraceFileHeader followed by the events, oldest first. It can be
+ * decoded with the spi-trace-decode tool in Release/tools
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] fileName Name of the file, which is overwritten if it exists
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_SetTraceLevel, SPI_GetTrace
+ * \note
+ * \warning
+ */
+FTDI_API FT_STATUS SPI_DumpTrace(FT_HANDLE handle, const char *fileName)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	SpiTraceFileHeader header;
+	FILE *file;
+	uint32 first;
+	uint32 noOfEvents;
+	FN_ENTER;
+#ifdef ENABLE_PARAMETER_CHECKING
+	CHECK_NULL_RET(handle);
+	CHECK_NULL_RET(fileName);
+#endif
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	file = fopen(fileName,"wb");
+	if(NULL == file)
+	{
+		SPI_UnlockChannelContext(context);
+		return FT_IO_ERROR;
+	}
+	noOfEvents = 0;
+	if(NULL != context->trace)
+		noOfEvents = (context->traceNext < SPI_TRACE_BUFFER_SIZE)?context->traceNext:\
+			SPI_TRACE_BUFFER_SIZE;
+	memcpy(header.magic,SPI_TRACE_FILE_MAGIC,sizeof(header.magic));
+	header.version = SPI_TRACE_FILE_VERSION;
+	header.noOfEvents = noOfEvents;
+	if(1 != fwrite(&header,sizeof(header),1,file))
+		status = FT_IO_ERROR;
+	/* The events are oldest first, so the part of the ring after the oldest one comes first */
+	first = (context->traceNext - noOfEvents) & (SPI_TRACE_BUFFER_SIZE-1);
+	if((FT_OK == status) && (noOfEvents > 0))
+	{
+		if(first + noOfEvents > SPI_TRACE_BUFFER_SIZE)
+		{
+			if(fwrite(&context->trace[first],sizeof(SpiTraceEvent),\
+				SPI_TRACE_BUFFER_SIZE-first,file) != SPI_TRACE_BUFFER_SIZE-first)
+				status = FT_IO_ERROR;
+			noOfEvents -= SPI_TRACE_BUFFER_SIZE-first;
+			first = 0;
+		}
+		if((FT_OK == status) && (fwrite(&context->trace[first],sizeof(SpiTraceEvent),\
+			noOfEvents,file) != noOfEvents))
+			status = FT_IO_ERROR;
+	}
+	SPI_UnlockChannelContext(context);
+	if(0 != fclose(file))
+		status = FT_IO_ERROR;
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Initializes the SPI module
+ *
+ * This function creates the lock that protects the channel table. It is called by
+ * Init_libMPSSE when the library is loaded
+ *
+ * \param[in] none
+ * \return none
+ * \sa Ftdi_SPI_Module_Cleanup
+ * \note
+ * \warning
+ */
+void Ftdi_SPI_Module_Init(void)
+{
+	INFRA_RWLOCK_INIT(&ChannelTableLock);
+#ifdef NO_LINKED_LIST
+	INFRA_MUTEX_INIT(&channelContext.lock);
+#endif
+	Mid_SetGPIOHook(SPI_GPIOHook);
+}
+
+/*!
+ * \brief Cleans up the SPI module
+ *
+ * This function destroys the lock created by Ftdi_SPI_Module_Init. It is called by
+ * Cleanup_libMPSSE when the library is unloaded
+ *
+ * \param[in] none
+ * \return none
+ * \sa Ftdi_SPI_Module_Init
+ * \note
+ * \warning
+ */
+void Ftdi_SPI_Module_Cleanup(void)
+{
+	Mid_SetGPIOHook(NULL);
+#ifdef NO_LINKED_LIST
+	INFRA_MUTEX_DESTROY(&channelContext.lock);
+#endif
+	INFRA_RWLOCK_DESTROY(&ChannelTableLock);
+}
+
+/******************************************************************************/
+/*						Local function definations						  */
+/******************************************************************************/
+
+/*!
+ * \brief Opens a channel through FT_OpenEx and allocates its context
+ *
+ * \param[in] arg Argument of FT_OpenEx
+ * \param[in] flags Flags of FT_OpenEx
+ * \param[out] handle Pointer to the handle of the opened channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_OpenChannelBySerial, SPI_OpenChannelByLocation, SPI_OpenChannelByDescription
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_OpenChannelEx(PVOID arg, DWORD flags, FT_HANDLE *handle)
+{
+	FT_STATUS status;
+	FN_ENTER;
+	status = FT_OpenChannelEx(SPI,arg,flags,handle);
+	DBG(MSG_DEBUG,"flags=%u handle=%u\n",(unsigned)flags,(unsigned)*handle);
+	CHECK_STATUS(status);
+	status = SPI_AddChannelConfig(*handle);
+	if(FT_OK != status)
+		FT_CloseChannel(SPI,*handle);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Allocates storage in the system to store channel configuration data
+ *
+ * This function allocates a channel context to store channel configuration
+ * information when they are passed by the user in SPI_OpenChannel and adds it
+ * to the bucket of the channel table that the handle hashes to.
+ *
+ * \param[in] handle Handle of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa
+ * \note This function should be called after a channel has been successfully
+ *	     opened and a handle to it has been assigned
+ * \warning
+ */
+FT_STATUS SPI_AddChannelConfig(FT_HANDLE handle)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *tempNode=NULL;
+	uint32 bucket;
+	FN_ENTER;
+	DBG(MSG_DEBUG,"line %u handle=0x%x\n",__LINE__,(unsigned)handle);
+
+#ifdef NO_LINKED_LIST
+	memset(channelContext.asyncQueue,0,sizeof(channelContext.asyncQueue));
+	channelContext.asyncNext = 1;
+	channelContext.asyncCompleted = 1;
+	channelContext.asyncDelivered = 1;
+	channelContext.asyncReadPending = 0;
+	channelContext.closed = FALSE;
+	channelContext.rxEventEnabled = FALSE;
+	channelContext.initialized = FALSE;
+	memset(&channelContext.clock,0,sizeof(MidClock));
+	memset(&channelContext.pins,0,sizeof(MidPins));
+	channelContext.currentPinStateHigh = 0;
+	channelContext.csPinsHigh = 0;
+	memset(&channelContext.stats,0,sizeof(SpiStats));
+	channelContext.traceLevel = SPI_TRACE_LEVEL_OFF;
+	channelContext.trace = NULL;
+	channelContext.traceNext = 0;
+	status = Mid_CmdBufferInit(&channelContext.cmdBuffer,SPI,handle,\
+		MID_CMD_BUFFER_SIZE);
+#else
+	tempNode = (ChannelContext *) INFRA_MALLOC(sizeof(ChannelContext));
+	if(NULL == tempNode)
+	{
+		status = FT_INSUFFICIENT_RESOURCES;
+		DBG(MSG_ERR,"Failed allocating memory\n");
+	}
+	else
+	{
+		tempNode->handle = handle;
+		/* No asynchronous transfers yet, ticket 0 is never handed out */
+		memset(tempNode->asyncQueue,0,sizeof(tempNode->asyncQueue));
+		tempNode->asyncNext = 1;
+		tempNode->asyncCompleted = 1;
+		tempNode->asyncDelivered = 1;
+		tempNode->asyncReadPending = 0;
+		/* The reference of the channel table */
+		tempNode->references = 1;
+		tempNode->closed = FALSE;
+		tempNode->rxEventEnabled = FALSE;
+		tempNode->initialized = FALSE;
+		memset(&tempNode->clock,0,sizeof(MidClock));
+		memset(&tempNode->pins,0,sizeof(MidPins));
+		tempNode->currentPinStateHigh = 0;
+		tempNode->csPinsHigh = 0;
+		memset(&tempNode->stats,0,sizeof(SpiStats));
+		tempNode->traceLevel = SPI_TRACE_LEVEL_OFF;
+		tempNode->trace = NULL;
+		tempNode->traceNext = 0;
+		status = Mid_CmdBufferInit(&tempNode->cmdBuffer,SPI,handle,\
+			MID_CMD_BUFFER_SIZE);
+		if(FT_OK == status)
+		{/* Add as first node of the bucket */
+			INFRA_MUTEX_INIT(&tempNode->lock);
+			bucket = SPI_CHANNEL_HASH(handle);
+			INFRA_RWLOCK_WRITE_LOCK(&ChannelTableLock);
+			tempNode->next = ChannelTable[bucket];
+			ChannelTable[bucket] = tempNode;
+			INFRA_RWLOCK_WRITE_UNLOCK(&ChannelTableLock);
+		}
+		else
+			INFRA_FREE(tempNode);
+	}
+#endif
+	FN_EXIT;
+#ifdef INFRA_DEBUG_ENABLE
+	SPI_DisplayList();
+#endif
+	return status;
+}
+
+/*!
+ * \brief Deletes storage allocated for channel configuration data
+ *
+ * This function traverses the bucket of the channel table that the handle
+ * hashes to, finds the channel with the given handle, removes it from the table
+ * and drops the reference of the table
+ *
+ * \param[in] handle Handle of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ReleaseChannelContext
+ * \note The context is freed once the functions that still use it have dropped
+ *		their references
+ * \warning
+ */
+FT_STATUS SPI_DelChannelConfig(FT_HANDLE handle)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *tempNode;
+	ChannelContext **link;
+	FN_ENTER;
+
+#ifdef NO_LINKED_LIST
+	if(channelContext.rxEventEnabled)
+		Infra_EventDestroy(&channelContext.rxEvent);
+	channelContext.rxEventEnabled = FALSE;
+	Mid_CmdBufferFree(&channelContext.cmdBuffer);
+	if(NULL != channelContext.trace)
+	{
+		INFRA_FREE(channelContext.trace);
+	}
+	channelContext.trace = NULL;
+	channelContext.traceLevel = SPI_TRACE_LEVEL_OFF;
+	status = FT_OK;
+#else
+	tempNode = NULL;
+	INFRA_RWLOCK_WRITE_LOCK(&ChannelTableLock);
+	for(link=&ChannelTable[SPI_CHANNEL_HASH(handle)]; NULL != *link;
+		link=&((*link)->next))
+	{
+		if((*link)->handle == handle)
+		{/*Node found*/
+			tempNode = *link;
+			*link = tempNode->next;
+			break;
+		}
+	}
+	INFRA_RWLOCK_WRITE_UNLOCK(&ChannelTableLock);
+	if(NULL != tempNode)
+		SPI_ReleaseChannelContext(tempNode);
+#endif
+	status=FT_OK;
+	FN_EXIT;
+#ifdef INFRA_DEBUG_ENABLE
+	SPI_DisplayList();
+#endif
+	return status;
+}
+
+
+/*!
+ * \brief Saves the channel's configuration data
+ *
+ * This function looks up the context of the channel with the provided handle
+ * and if it is found then saves the channel configuration data that is provided
+ * into the memory locations that were previously allocated using
+ * SPI_AddChannelConfig
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] config Pointer to ChannelConfig structure
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_SaveChannelConfig(FT_HANDLE handle, ChannelConfig *config)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+
+#ifdef NO_LINKED_LIST
+		memcpy(&channelContext.config,config,sizeof(ChannelConfig));
+		channelContext.handle = handle;
+		status = FT_OK;
+#else
+	status = SPI_LockChannelContext(handle,&context);
+	if(FT_OK == status)
+	{
+		INFRA_MEMCPY(&(context->config),config,sizeof(ChannelConfig));
+		SPI_UnlockChannelContext(context);
+	}
+#endif
+
+	FN_EXIT;
+#ifdef INFRA_DEBUG_ENABLE
+		SPI_DisplayList();
+#endif
+	return status;
+}
+
+/*!
+ * \brief Retrieves the pointer to the channel's configuration data
+ *
+ * This function traverses the channel configuration data linked list
+ * and if the node with the provided handle is founed then it provides
+ * the address of the associated channel configuration data structure
+ * in the pointer provided in the second parameter of the function
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] config Pointer to ChannelConfig structure
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa
+ * \note
+ * \warning No reference is kept, the pointer must not be used once the channel may
+ *		have been closed
+ */
+FT_STATUS SPI_GetChannelConfig(FT_HANDLE handle, ChannelConfig **config)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *context=NULL;
+	FN_ENTER;
+
+	status = SPI_GetChannelContext(handle,&context);
+	if(FT_OK == status)
+	{
+		*config = &(context->config);
+		SPI_ReleaseChannelContext(context);
+	}
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Retrieves the pointer to the channel's context
+ *
+ * This function looks up the handle in the channel table and if it is found
+ * then it provides the address of the channel's context in the pointer provided
+ * in the second parameter of the function. The context holds the channel's
+ * configuration data as well as its MPSSE command buffer
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] context Pointer to a ChannelContext pointer
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ReleaseChannelContext, SPI_LockChannelContext
+ * \note Only the bucket that the handle hashes to is searched and nothing is
+ *		allocated, so the lookup does not slow down as more channels are opened.
+ *		The table is only locked for reading, lookups on different threads do not
+ *		wait for each other
+ * \warning A reference is taken on the context, so it is not freed while it is
+ *		used. It must be dropped with SPI_ReleaseChannelContext
+ */
+FT_STATUS SPI_GetChannelContext(FT_HANDLE handle, ChannelContext **context)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *tempNode=NULL;
+	FN_ENTER;
+
+#ifdef NO_LINKED_LIST
+		if(handle == channelContext.handle)
+		{
+			*context= &channelContext;
+			status = FT_OK;
+		}
+		else
+			DBG(MSG_DEBUG,"handle not found in channel config list\n");
+#else
+	INFRA_RWLOCK_READ_LOCK(&ChannelTableLock);
+	for(tempNode=ChannelTable[SPI_CHANNEL_HASH(handle)]; NULL != tempNode;
+		tempNode=tempNode->next)
+	{
+		if(tempNode->handle == handle)
+		{/*Node found*/
+			INFRA_ATOMIC_INC(&tempNode->references);
+			*context = tempNode;
+			status = FT_OK;
+			break;
+		}
+	}
+	INFRA_RWLOCK_READ_UNLOCK(&ChannelTableLock);
+	if(FT_OK != status)
+	{
+		DBG(MSG_NOTICE,"handle not found in channel table\n");
+	}
+#endif
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Drops a reference to the channel's context
+ *
+ * This function drops a reference taken by SPI_GetChannelContext or the one of the
+ * channel table. The last reference frees the context
+ *
+ * \param[in] context Context of the channel, not locked
+ * \return none
+ * \sa SPI_GetChannelContext, SPI_DelChannelConfig
+ * \note
+ * \warning
+ */
+void SPI_ReleaseChannelContext(ChannelContext *context)
+{
+#ifndef NO_LINKED_LIST
+	if(0 == INFRA_ATOMIC_DEC(&context->references))
+	{
+		INFRA_MUTEX_DESTROY(&context->lock);
+		if(context->rxEventEnabled)
+			Infra_EventDestroy(&context->rxEvent);
+		Mid_CmdBufferFree(&context->cmdBuffer);
+		if(NULL != context->trace)
+		{
+			INFRA_FREE(context->trace);
+		}
+		INFRA_FREE(context);
+	}
+#endif
+}
+
+/*!
+ * \brief Looks up the channel's context and locks the channel
+ *
+ * \param[in] handle Handle of the channel
+ * \param[out] context Pointer to a ChannelContext pointer
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_UnlockChannelContext
+ * \note FT_OTHER_ERROR is returned, as for a handle that is not found, if the
+ *		channel has been closed since it was looked up. Nothing is held then
+ * \warning
+ */
+FT_STATUS SPI_LockChannelContext(FT_HANDLE handle, ChannelContext **context)
+{
+	FT_STATUS status;
+
+	status = SPI_GetChannelContext(handle,context);
+	if(FT_OK != status)
+		return status;
+	LOCK_CHANNEL(*context);
+	if((*context)->closed)
+	{
+		DBG(MSG_NOTICE,"channel closed\n");
+		UNLOCK_CHANNEL(*context);
+		SPI_ReleaseChannelContext(*context);
+		status = FT_OTHER_ERROR;
+	}
+	return status;
+}
+
+/*!
+ * \brief Unlocks a channel locked by SPI_LockChannelContext
+ *
+ * This function unlocks the channel, calls the callbacks of the asynchronous transfers
+ * that have completed and drops the reference to the channel's context
+ *
+ * \param[in] context Context of the channel
+ * \return none
+ * \sa SPI_LockChannelContext
+ * \note
+ * \warning The context must not be used after this function returns
+ */
+void SPI_UnlockChannelContext(ChannelContext *context)
+{
+	UNLOCK_CHANNEL(context);
+	SPI_AsyncDeliver(context);
+	SPI_ReleaseChannelContext(context);
+}
+
+/*!
+ * \brief Display the contents of the channel table
+ *
+ * This function traverses all the buckets of the channel table
+ * and prints the data at each node.
+ *
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa
+ * \note	Useful for debuging
+ * \warning
+ */
+FT_STATUS SPI_DisplayList(void)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+#ifdef INFRA_DEBUG_ENABLE
+	ChannelContext *tempNode=NULL;
+	uint32 bucket;
+#endif
+	FN_ENTER;
+#ifdef INFRA_DEBUG_ENABLE
+	printf("%s:%d:%s():\n",__FILE__, __LINE__, __FUNCTION__);
+	for(bucket = 0; bucket < SPI_CHANNEL_TABLE_SIZE; bucket++)
+	for(tempNode = ChannelTable[bucket]; 0 != tempNode; tempNode=tempNode->next)
+	{
+		//if(currentDebugLevel>=MSG_DEBUG)
+		{
+			printf("\ttempNode->handle=0x%x\n",(unsigned)tempNode->handle);
+			printf("\ttempNode-->next=0x%x\n",(unsigned)tempNode->next);
+			printf("\ttempNode->config->ClockRate=%u\n",
+				(unsigned)tempNode->config.ClockRate);
+		}
+	}
+	printf("------------------------------------------------------\n");
+#endif
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Toggles the state of the CS line
+ *
+ * This function turns ON/OFF the chip select line associated with the channel
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] state TRUE if CS needs to be set, false otherwise
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendToggleCS
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_ToggleCS(FT_HANDLE handle, bool state)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	ChannelContext *context=NULL;
+
+	FN_ENTER;
+	status = SPI_LockChannelContext(handle,&context);
+	CHECK_STATUS(status);
+	status = SPI_AppendToggleCS(context,state);
+	if(FT_OK == status)
+		status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	SPI_UnlockChannelContext(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Reads data clocked in from the SPI slave
+ *
+ * This function reads the data of a transfer back from the channel, either by blocking in
+ * FT_Read or, if SPI_CONFIG_OPTION_RX_EVENT was given to SPI_InitChannel, by sleeping on
+ * the channel's receive event. FT_Read gives up when the whole request is not done within
+ * DEVICE_READ_TIMEOUT, which a long read at a slow clock exceeds(16MB take 134s at 1MHz), so
+ * the data is read one MPSSE segment(MPSSE_MAX_DATA_LENGTH bytes) at a time and the reads go
+ * on for as long as each of them brings data
+ *
+ * \param[in] context Context of the channel
+ * \param[in] noOfBytes Number of bytes to be read
+ * \param[out] buffer Pointer to the buffer where data is to be read
+ * \param[out] noOfBytesTransferred The actual number of bytes read
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa Mid_ChannelReadEvent
+ * \note FT_OK is returned with less bytes read only if no data arrived for
+ *		DEVICE_READ_TIMEOUT milliseconds
+ * \warning
+ */
+FT_STATUS SPI_ChannelRead(ChannelContext *context, uint32 noOfBytes,
+	uint8 *buffer, uint32 *noOfBytesTransferred)
+{
+	FT_STATUS status=FT_OK;
+	uint32 length;
+	uint32 bytesRead=1;
+
+	*noOfBytesTransferred = 0;
+	while((*noOfBytesTransferred < noOfBytes) && (bytesRead > 0) && (FT_OK == status))
+	{
+		length = noOfBytes - *noOfBytesTransferred;
+		if(length > MPSSE_MAX_DATA_LENGTH)
+			length = MPSSE_MAX_DATA_LENGTH;
+		bytesRead = 0;
+		if(context->rxEventEnabled)
+		{
+			status = Mid_ChannelReadEvent(context->handle,&context->rxEvent,length,\
+				&buffer[*noOfBytesTransferred],&bytesRead);
+		}
+		else
+		{
+			status = FT_Channel_Read(SPI,context->handle,length,\
+				&buffer[*noOfBytesTransferred],&bytesRead);
+		}
+		*noOfBytesTransferred += bytesRead;
+		INFRA_ATOMIC_ADD32(&context->stats.usbReads,1);
+		INFRA_ATOMIC_ADD64(&context->stats.usbBytesRead,bytesRead);
+		SPI_TRACE(context,SPI_TRACE_LEVEL_USB,SPI_TRACE_EVENT_USB_READ,status,bytesRead);
+	}
+	if(*noOfBytesTransferred < noOfBytes)
+	{
+		INFRA_ATOMIC_ADD32(&context->stats.shortReads,1);
+		/* D2XX returns FT_OK with less data when the read timeout expires */
+		if(FT_OK == status)
+			INFRA_ATOMIC_ADD32(&context->stats.timeouts,1);
+	}
+	return status;
+}
+
+/*!
+ * \brief Appends the command that toggles the state of the CS line
+ *
+ * This function adds the MPSSE command that turns ON/OFF the chip select line
+ * associated with the channel to the channel's command buffer. The command reaches
+ * the chip when the command buffer is flushed
+ *
+ * \param[in] context Context of the channel
+ * \param[in] state TRUE if CS needs to be set, false otherwise
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ToggleCS
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_AppendToggleCS(ChannelContext *context, bool state)
+{
+	ChannelConfig *config=NULL;
+	bool activeLow;
+	FT_STATUS status=FT_OTHER_ERROR;
+#ifdef DEVELOPMENT_FIXED_CS
+	uint8 buffer[5];
+	uint32 i=0;
+#endif
+	uint8 value, oldValue, direction;
+
+	FN_ENTER;
+#ifdef DEVELOPMENT_FIXED_CS
+//#if 1
+	/* For initial development only - assuming only ADBUS0 will be used for CS*/
+	buffer[i++]=MPSSE_CMD_SET_DATA_BITS_LOWBYTE;
+	if(TRUE==state)
+	{
+		//buffer[i++]=0x08;		/*value*/
+		buffer[i++]=0x09;		/*value - mode2,3 clock idle high*/
+	}
+	else
+	{
+		//buffer[i++]=0x00;		/*value*/
+		buffer[i++]=0x01;		/*value - mode2,3 clock idle high*/
+	}
+	buffer[i++]=0x0B;//direction;	/*direction*/
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,i);
+	CHECK_STATUS(status);
+#else
+	/*Manipulate the channel's configuration data directly*/
+	config = &context->config;
+	activeLow = (config->configOptions & \
+		SPI_CONFIG_OPTION_CS_ACTIVELOW)?TRUE:FALSE;
+
+	DBG(MSG_DEBUG,"config->configOptions=0x%x activeLow=0x%x\n",
+		(unsigned)config->configOptions,(unsigned)activeLow);
+
+	if(config->configOptions & SPI_CONFIG_OPTION_CS_ACBUS)
+	{/* The state of the high byte is kept in the channel's context */
+		value = SPI_CS_HIGH_PIN(config->configOptions);
+		context->currentPinStateHigh |= value;
+		if(state != activeLow)
+			context->currentPinStateHigh |= (uint16)value<<8;/* set the CS line high */
+		else
+			context->currentPinStateHigh &= ~((uint16)value<<8);/* set the CS line low */
+		DBG(MSG_DEBUG,"context->currentPinStateHigh=0x%x\n",
+			(unsigned)context->currentPinStateHigh);
+	}
+	else
+	{
+		//direction = (uint8)config->currentPinState;/*get current state*/
+		direction = (uint8)(config->currentPinState & 0x00FF);//20110718
+		direction |= SPI_CS_LOW_PIN(config->configOptions);
+		DBG(MSG_DEBUG,"config->currentPinState=0x%x direction=0x%x\n",
+			(unsigned)config->currentPinState,(unsigned)direction);
+
+		//oldValue = (uint8)(8>>config->currentPinState);
+		oldValue =  (uint8)((config->currentPinState & 0xFF00)>>8);//20110718
+		value = SPI_CS_LOW_PIN(config->configOptions);
+
+		DBG(MSG_DEBUG,"oldValue=0x%x value=0x%x\n",oldValue,value);
+
+		if((TRUE==state && FALSE==activeLow) || (FALSE==state && TRUE==activeLow))
+			value = oldValue | value; /* set the CS line high */
+		if((TRUE==state && TRUE==activeLow) || (FALSE==state && FALSE==activeLow))
+			value = oldValue & ~value;/* set the CS line low */
+
+		config->currentPinState = ((uint16)value<<8) | direction;/*save  dirn & value*/
+		DBG(MSG_DEBUG,"config->currentPinState=0x%x\n",
+			(unsigned)config->currentPinState);
+	}
+
+	/*MPSSE command to set the pins, left out if CS is already in this state*/
+	status = SPI_AppendPins(context);
+	CHECK_STATUS(status);
+#endif
+	INFRA_ATOMIC_ADD32(&context->stats.csToggles,1);
+	if(FALSE == state)
+	{
+		status = SPI_AppendCSHold(context);
+		CHECK_STATUS(status);
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends the commands that set the pins to their current state
+ *
+ * This function adds the MPSSE commands that set the values and directions of the low byte
+ * of pins to ChannelConfig.currentPinState, and of the high byte to currentPinStateHigh of
+ * the context, to the channel's command buffer, leaving out those that would not change the
+ * pins. They go to the chip in the same USB transfer as the data commands around them
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendToggleCS, Mid_GetPinCmds
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_AppendPins(ChannelContext *context)
+{
+	FT_STATUS status=FT_OK;
+	uint8 buffer[SPI_PIN_CMDS_SIZE];
+	uint32 noOfBytes,i;
+
+	FN_ENTER;
+	SPI_GetPinCmds(context,context->config.currentPinState,buffer,&noOfBytes);
+	if(noOfBytes > 0)
+	{
+		for(i=0;i<noOfBytes;i+=3)
+		{
+			SPI_TRACE(context,SPI_TRACE_LEVEL_CMDS,SPI_TRACE_EVENT_CMD,buffer[i],\
+				((uint32)buffer[i+1]<<8) | buffer[i+2]);
+		}
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+		CHECK_STATUS(status);
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends the commands that hold the CS line inactive
+ *
+ * This function pads the channel's command buffer so that the chip keeps the CS line
+ * inactive for ChannelConfig.csHoldCycles SCLK cycles before it executes the next command,
+ * if SPI_CONFIG_OPTION_CS_HOLD is set.
+ * On FT2232H, FT4232H & FT232H this is done by clocking without data transfer, which is
+ * harmless since no slave is selected. FT2232D does not support these commands, so the
+ * current state of the pins is written again instead(see SPI_AppendIdleCycles).
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendToggleCS
+ * \note The hold time on FT2232D is only approximate
+ * \warning
+ */
+FT_STATUS SPI_AppendCSHold(ChannelContext *context)
+{
+	FT_STATUS status;
+
+	FN_ENTER;
+	if(0 == (context->config.configOptions & SPI_CONFIG_OPTION_CS_HOLD))
+	{/* csHoldCycles may be uninitialized padding of an older caller's ChannelConfig */
+		FN_EXIT;
+		return FT_OK;
+	}
+	status = SPI_AppendIdleCycles(context,context->config.csHoldCycles);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends the commands that let SCLK run for a number of cycles without data
+ *
+ * This function appends to the channel's command buffer the commands that make the chip wait
+ * for the given number of SCLK cycles before it executes the next command. The pins are left
+ * as they are
+ *
+ * \param[in] context Context of the channel
+ * \param[in] cycles Number of SCLK cycles
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendCSHold
+ * \note The FT2232D has no command to clock without data, so the wait is approximated by
+ *		rewriting the current pin state, (divisor+1) times per cycle and at most
+ *		SPI_FT2232D_MAX_IDLE_WRITES times
+ * \warning
+ */
+FT_STATUS SPI_AppendIdleCycles(ChannelContext *context, uint32 cycles)
+{
+	FT_STATUS status=FT_OK;
+	uint32 noOfBytes;
+	uint32 segment;
+	uint64 noOfWrites;
+	uint8 buffer[6];
+
+	FN_ENTER;
+	if(cycles > 0)
+	{
+		SPI_TRACE(context,SPI_TRACE_LEVEL_CMDS,SPI_TRACE_EVENT_CMD,MPSSE_CMD_CLOCK_N_BITS,\
+			cycles);
+	}
+	if(FT_DEVICE_2232C == context->ftDevice)
+	{
+		buffer[0] = MPSSE_CMD_SET_DATA_BITS_LOWBYTE;
+		buffer[1] = (uint8)((context->config.currentPinState & 0xFF00)>>8);/*Val*/
+		buffer[2] = (uint8)(context->config.currentPinState & 0x00FF);/*Dir*/
+		noOfWrites = (uint64)cycles*((uint64)context->clock.divisor+1);
+		if(noOfWrites > SPI_FT2232D_MAX_IDLE_WRITES)
+			noOfWrites = SPI_FT2232D_MAX_IDLE_WRITES;
+		for(;(noOfWrites > 0) && (FT_OK == status);noOfWrites--)
+			status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,3);
+	}
+	else
+	{
+		while((cycles > 0) && (FT_OK == status))
+		{
+			noOfBytes = 0;
+			if(cycles >= 8)
+			{/* 8*(length+1) clocks */
+				segment = cycles/8;
+				if(segment > MPSSE_MAX_DATA_LENGTH)
+					segment = MPSSE_MAX_DATA_LENGTH;
+				buffer[noOfBytes++] = MPSSE_CMD_CLOCK_N_BYTES;
+				buffer[noOfBytes++] = (uint8)((segment-1) & 0x000000FF);
+				buffer[noOfBytes++] = (uint8)(((segment-1) & 0x0000FF00)>>8);
+				cycles -= segment*8;
+			}
+			else
+			{/* length+1 clocks */
+				buffer[noOfBytes++] = MPSSE_CMD_CLOCK_N_BITS;
+				buffer[noOfBytes++] = (uint8)(cycles - 1);
+				cycles = 0;
+			}
+			status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+		}
+	}
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends byte mode data commands for a transfer of any length
+ *
+ * A single MPSSE byte mode command can clock at most MPSSE_MAX_DATA_LENGTH bytes. This
+ * function splits the transfer into segments of that size and appends the command (and the
+ * data, if any) of every segment to the channel's command buffer, so that the chip executes
+ * them back to back without any change of the CS line in between.
+ *
+ * \param[in] context Context of the channel
+ * \param[in] opcode MPSSE byte mode data command
+ * \param[in] data Data to be clocked out, NULL if the command does not clock out data
+ * \param[in] size Number of bytes to be transferred
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa
+ * \note Nothing is appended if size is 0
+ * \warning
+ */
+FT_STATUS SPI_AppendByteCmds(ChannelContext *context, uint8 opcode, uint8 *data,
+	uint32 size)
+{
+	FT_STATUS status=FT_OK;
+	uint32 segment;
+	uint8 buffer[3];
+
+	FN_ENTER;
+	if(opcode & MPSSE_DATA_OUT_BIT)
+		INFRA_ATOMIC_ADD64(&context->stats.bytesOut,size);
+	if(opcode & MPSSE_DATA_IN_BIT)
+		INFRA_ATOMIC_ADD64(&context->stats.bytesIn,size);
+	while((size > 0) && (FT_OK == status))
+	{
+		segment = (size > MPSSE_MAX_DATA_LENGTH)?MPSSE_MAX_DATA_LENGTH:size;
+		SPI_TRACE(context,SPI_TRACE_LEVEL_CMDS,SPI_TRACE_EVENT_CMD,opcode,segment);
+		buffer[0] = opcode;
+		buffer[1] = (uint8)((segment-1) & 0x000000FF);/* length low byte */
+		buffer[2] = (uint8)(((segment-1) & 0x0000FF00)>>8);/* length high byte */
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,3);
+		if((FT_OK == status) && (NULL != data))
+		{
+			status = Mid_CmdBufferAppend(&context->cmdBuffer,data,segment);
+			data += segment;
+		}
+		size -= segment;
+	}
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends data commands for a transfer whose length is given in bits
+ *
+ * The whole bytes of the transfer are clocked with byte mode commands(see
+ * SPI_AppendByteCmds) and the remaining 1 to 7 bits with one bit mode command, so that a
+ * transfer of any number of bits is a single MPSSE command stream. The remaining bits are
+ * taken from the MSB side of the last byte of data, or from the LSB side if the commands are
+ * LSB first(MPSSE_DATA_LSB_FIRST_BIT).
+ *
+ * \param[in] context Context of the channel
+ * \param[in] byteOpcode MPSSE byte mode data command
+ * \param[in] bitOpcode MPSSE bit mode data command with the same direction and edges
+ * \param[in] data Data to be clocked out, NULL if the commands do not clock out data
+ * \param[in] sizeInBits Number of bits to be transferred
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendByteCmds
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_AppendBitCmds(ChannelContext *context, uint8 byteOpcode,
+	uint8 bitOpcode, uint8 *data, uint32 sizeInBits)
+{
+	FT_STATUS status;
+	uint32 noOfBytes=0;
+	uint8 buffer[3];
+
+	FN_ENTER;
+	status = SPI_AppendByteCmds(context,byteOpcode,data,sizeInBits/8);
+	CHECK_STATUS(status);
+	if(sizeInBits % 8)
+	{
+		/* the remaining bits count as a byte in the statistics */
+		if(bitOpcode & MPSSE_DATA_OUT_BIT)
+			INFRA_ATOMIC_ADD64(&context->stats.bytesOut,1);
+		if(bitOpcode & MPSSE_DATA_IN_BIT)
+			INFRA_ATOMIC_ADD64(&context->stats.bytesIn,1);
+		SPI_TRACE(context,SPI_TRACE_LEVEL_CMDS,SPI_TRACE_EVENT_CMD,bitOpcode,\
+			sizeInBits % 8);
+		buffer[noOfBytes++] = bitOpcode;
+		buffer[noOfBytes++] = (uint8)((sizeInBits % 8) - 1);/* 1bit->arg=0 */
+		if(NULL != data)
+			buffer[noOfBytes++] = data[sizeInBits/8];
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+		CHECK_STATUS(status);
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Clocks data out and in using a bounded window of data in flight
+ *
+ * This function is called by SPI_ReadWrite. The transfer is divided into chunks of half the
+ * FIFO space that is left after the commands of two chunks(SPI_PIPELINE_CMD_BYTES), so the
+ * two chunks with their commands fit in the chip's FIFO. Two chunks are kept in flight: after
+ * the data of chunk N has been read back, the commands for chunk N+2 are written, so the chip
+ * always has the next chunk queued while the host drains the current one and the clock keeps
+ * running. Each chunk ends with SEND_IMMEDIATE so its data reaches the host without waiting
+ * for the latency timer.
+ *
+ * \param[in] context Context of the channel
+ * \param[in] byteOpcode MPSSE byte mode full duplex data command
+ * \param[in] bitOpcode MPSSE bit mode full duplex data command
+ * \param[in] inBuffer Buffer to which the data read will be stored
+ * \param[in] outBuffer Buffer that contains the data to be written
+ * \param[in] noOfBytes Number of whole bytes to be transferred
+ * \param[in] noOfBits Number of bits(0 to 7) to be transferred after the whole bytes
+ * \param[out] sizeTransferred Number of bytes that were read back, including the byte
+ *				that holds the bits
+ * \param[in] disableCS TRUE if CS is to be disabled after the last chunk
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AppendBitCmds
+ * \note If the data of a chunk does not arrive in time, CS is still disabled if asked for,
+ *		the channel is resynchronized(SPI_ResyncLocked) so that the data of the chunks in
+ *		flight is not returned by later transfers, and FT_IO_ERROR is returned
+ * \warning
+ */
+FT_STATUS SPI_ReadWritePipelined(ChannelContext *context, uint8 byteOpcode,
+	uint8 bitOpcode, uint8 *inBuffer, uint8 *outBuffer, uint32 noOfBytes,
+	uint8 noOfBits, uint32 *sizeTransferred, bool disableCS)
+{
+	FT_STATUS status=FT_OK;
+	uint32 chunk;
+	uint32 total;
+	uint32 issued=0;
+	uint32 length;
+	uint32 noOfBytesTransferred;
+	uint8 cmd = MPSSE_CMD_SEND_IMMEDIATE;
+
+	FN_ENTER;
+	*sizeTransferred = 0;
+	chunk = (Mid_GetFifoSize(context->ftDevice) - 2*SPI_PIPELINE_CMD_BYTES)/2;
+	/* the bits are returned in a byte of their own */
+	total = noOfBytes + ((noOfBits > 0)?1:0);
+	do
+	{
+		/* Keep up to two chunks in flight */
+		while((issued < total) && ((issued - *sizeTransferred) < (2*chunk)))
+		{
+			length = total - issued;
+			if(length > chunk)
+				length = chunk;
+			if((issued + length == total) && (noOfBits > 0))
+			{/* last chunk carries the bits */
+				status = SPI_AppendBitCmds(context,byteOpcode,bitOpcode,\
+					outBuffer+issued,(length-1)*8+noOfBits);
+			}
+			else
+			{
+				status = SPI_AppendByteCmds(context,byteOpcode,outBuffer+issued,\
+					length);
+			}
+			CHECK_STATUS(status);
+			issued += length;
+			if((issued == total) && disableCS)
+			{
+				/* disable CHIPSELECT line once the data has been clocked out */
+				status = SPI_AppendToggleCS(context,FALSE);
+				CHECK_STATUS(status);
+			}
+			status = Mid_CmdBufferAppend(&context->cmdBuffer,&cmd,1);
+			CHECK_STATUS(status);
+		}
+		if((0 == total) && disableCS)
+		{
+			status = SPI_AppendToggleCS(context,FALSE);
+			CHECK_STATUS(status);
+		}
+		status = Mid_CmdBufferFlush(&context->cmdBuffer);
+		CHECK_STATUS(status);
+
+		/* Drain the oldest chunk */
+		length = issued - *sizeTransferred;
+		if(length > chunk)
+			length = chunk;
+		if(length > 0)
+		{
+			noOfBytesTransferred = 0;
+			status = SPI_ChannelRead(context,length,\
+				inBuffer+*sizeTransferred,&noOfBytesTransferred);
+			CHECK_STATUS(status);
+			*sizeTransferred += noOfBytesTransferred;
+			if(noOfBytesTransferred < length)
+			{/*timeout occured if FT_OK is returned but transferred length is requested len*/
+				DBG(MSG_ERR,"Timeout occured. RequestedRxLen=%u RxLen=%u \n",\
+					(unsigned)length,(unsigned)noOfBytesTransferred);
+				/* CS is released as asked even though the transfer is cut short */
+				if((issued < total) && disableCS)
+				{
+					status = SPI_AppendToggleCS(context,FALSE);
+					if(FT_OK == status)
+						status = Mid_CmdBufferFlush(&context->cmdBuffer);
+				}
+				/* The data of the chunks still in flight would be taken for that of the
+				next transfer, throw it away */
+				if(FT_OK == status)
+					status = SPI_ResyncLocked(context);
+				if(FT_OK == status)
+					status = FT_IO_ERROR;
+				break;
+			}
+		}
+	}while(*sizeTransferred < total);
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_Read, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_Read
+ * \note The other parameters are the same as those of SPI_Read
+ * \warning
+ */
+FT_STATUS SPI_ReadLocked(ChannelContext *context, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
+{
+	FT_STATUS status;
+	uint32 noOfBytes;
+	uint8 cmd;
+	uint8 byteCmd=0,bitCmd=0;
+	FN_ENTER;
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+
+	SPI_SelectDataCmds(context,TRUE,FALSE,&byteCmd,&bitCmd);
+
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
+	{
+		/* Enable CHIPSELECT line for the channel */
+		status = SPI_AppendToggleCS(context,TRUE);
+		CHECK_STATUS(status);
+	}
+
+	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+	{/*sizeToTransfer is in bits*/
+		/* Byte commands for the whole bytes, a bit command for the rest */
+		status = SPI_AppendBitCmds(context,byteCmd,bitCmd,NULL,sizeToTransfer);
+		CHECK_STATUS(status);
+		noOfBytes = (sizeToTransfer+7)/8;
+	}
+	else
+	{/*sizeToTransfer is in bytes*/
+		/* One read command for each 64KB segment */
+		status = SPI_AppendByteCmds(context,byteCmd,NULL,sizeToTransfer);
+		CHECK_STATUS(status);
+		noOfBytes = sizeToTransfer;
+	}
+
+	/* The chip select can be released before the data is read back by the host, so that
+	the whole transaction goes to the chip in one USB transfer */
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
+	{
+		/* Disable CHIPSELECT line for the channel */
+		status = SPI_AppendToggleCS(context,FALSE);
+		CHECK_STATUS(status);
+	}
+
+	/*Command MPSSE to send data to PC immediately */
+	cmd = MPSSE_CMD_SEND_IMMEDIATE;
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,&cmd,1);
+	CHECK_STATUS(status);
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+
+	*sizeTransferred = 0;
+	if(noOfBytes > 0)
+	{
+		status = SPI_ChannelRead(context,noOfBytes,buffer,sizeTransferred);
+		CHECK_STATUS(status);
+	}
+	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+	{
+		*sizeTransferred = (*sizeTransferred == noOfBytes)?sizeToTransfer:\
+			(*sizeTransferred*8);
+	}
+	DBG(MSG_DEBUG,"sizeToTransfer=%u sizeTransferred=%u buffer[0]=0x%x \
+		buffer[1]=0x%x\n",sizeToTransfer,*sizeTransferred,buffer[0],buffer[1]);
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_Write, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_Write
+ * \note The other parameters are the same as those of SPI_Write
+ * \warning
+ */
+FT_STATUS SPI_WriteLocked(ChannelContext *context, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions)
+{
+	FT_STATUS status;
+	uint8 byteCmd=0,bitCmd=0;
+	FN_ENTER;
+
+	DBG(MSG_DEBUG,"configOptions=0x%x\n",(unsigned)context->config.configOptions);
+	DBG(MSG_DEBUG,"LatencyTimer=%u\n",(unsigned)context->config.LatencyTimer);
+	SPI_SelectDataCmds(context,FALSE,TRUE,&byteCmd,&bitCmd);
+
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
+	{
+		/* enable CHIPSELECT line for the channel */
+		status = SPI_AppendToggleCS(context,TRUE);
+		CHECK_STATUS(status);
+	}
+
+	*sizeTransferred = 0;
+	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+	{/* sizeToTransfer is in bits */
+		/* Byte commands for the whole bytes, a bit command for the rest */
+		status = SPI_AppendBitCmds(context,byteCmd,bitCmd,buffer,sizeToTransfer);
+		CHECK_STATUS(status);
+	}
+	else
+	{/* sizeToTransfer is in bytes */
+		/* Command and data for each 64KB segment */
+		status = SPI_AppendByteCmds(context,byteCmd,buffer,sizeToTransfer);
+		CHECK_STATUS(status);
+	}
+
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
+	{
+		/* disable CHIPSELECT line for the channel */
+		status = SPI_AppendToggleCS(context,FALSE);
+		CHECK_STATUS(status);
+	}
+	/* Send the whole transaction to the chip */
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+	*sizeTransferred = sizeToTransfer;
+	DBG(MSG_DEBUG,"sizeToTransfer=%u  sizeTransferred=%u BitMode=%u \
+		CS_Enable=%u CS_Disable=%u\n",sizeToTransfer,*sizeTransferred,		\
+		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS),	\
+		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE),\
+		(unsigned)(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE));
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_ReadWrite, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ReadWrite
+ * \note The other parameters are the same as those of SPI_ReadWrite
+ * \warning
+ */
+FT_STATUS SPI_ReadWriteLocked(ChannelContext *context, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
+	uint32 transferOptions)
+{
+	FT_STATUS status;
+	uint8 byteCmd=0,bitCmd=0;
+	bool disableCS;
+	FN_ENTER;
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+
+	SPI_SelectDataCmds(context,TRUE,TRUE,&byteCmd,&bitCmd);
+
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
+	{
+		/* enable CHIPSELECT line for the channel */
+		status = SPI_AppendToggleCS(context,TRUE);
+		CHECK_STATUS(status);
+	}
+
+	/* start of transfer */
+	disableCS = (transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)?TRUE:FALSE;
+	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+	{/* sizeToTransfer is in bits */
+		/*Whole bytes are clocked with byte commands and the rest with a bit command*/
+		status = SPI_ReadWritePipelined(context,byteCmd,bitCmd,inBuffer,outBuffer,\
+			sizeToTransfer/8,(uint8)(sizeToTransfer%8),sizeTransferred,disableCS);
+		CHECK_STATUS(status);
+		*sizeTransferred = (*sizeTransferred == (sizeToTransfer+7)/8)?\
+			sizeToTransfer:(*sizeTransferred*8);
+	}
+	else
+	{/*sizeToTransfer is in bytes*/
+		/*Clock the data out and in with a bounded amount of data in flight*/
+		status = SPI_ReadWritePipelined(context,byteCmd,bitCmd,inBuffer,outBuffer,\
+			sizeToTransfer,0,sizeTransferred,disableCS);
+		CHECK_STATUS(status);
+		#if 0
+		{//for debugging
+			int i;
+			printf("\nsizeToTransfer=%d sizeTransferred=%d data=",sizeToTransfer,*sizeTransferred);
+			for(i=0;i<*sizeTransferred;i++)
+			{
+				printf(" 0x%x",outBuffer[i]);
+			}
+			printf("\n");
+		}
+		#endif
+	}
+	/* end of transfer */
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_IsBusy, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_IsBusy
+ * \note The other parameters are the same as those of SPI_IsBusy
+ * \warning
+ */
+FT_STATUS SPI_IsBusyLocked(ChannelContext *context, bool *state)
+{
+	FT_STATUS status=FT_OTHER_ERROR;
+	uint32 noOfBytes=0,noOfBytesTransferred=0;
+	uint8 buffer[10];
+
+	FN_ENTER;
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+	/*Enable CS*/
+	status = SPI_AppendToggleCS(context, TRUE);
+	CHECK_STATUS(status);
+	/*Command to read*/
+	buffer[noOfBytes++]=MPSSE_CMD_GET_DATA_BITS_LOWBYTE;
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+	CHECK_STATUS(status);
+	/*Disable CS, the pin state has already been sampled*/
+	status = SPI_AppendToggleCS(context, FALSE);
+	CHECK_STATUS(status);
+	noOfBytes=0;
+	buffer[noOfBytes++]=MPSSE_CMD_SEND_IMMEDIATE;
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+	CHECK_STATUS(status);
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+
+	/*Read*/
+	noOfBytes=1;
+	noOfBytesTransferred=0;
+	status = SPI_ChannelRead(context,noOfBytes,buffer,&noOfBytesTransferred);
+	CHECK_STATUS(status);
+	DBG(MSG_DEBUG,"Low byte read = 0x%x\n",buffer[0]);
+	if(0 == (buffer[0] && 0x04))
+		*state=FALSE;
+	else
+		*state=TRUE;
+
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_WaitWhileBusy, called with the channel locked
+ *
+ * The pins are read after the wait command, so the byte arrives when the wait is over
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_WaitWhileBusy
+ * \note The other parameters are the same as those of SPI_WaitWhileBusy
+ * \warning
+ */
+FT_STATUS SPI_WaitWhileBusyLocked(ChannelContext *context, uint32 timeout)
+{
+	FT_STATUS status;
+	uint32 noOfBytes=0,noOfBytesTransferred=0;
+	uint8 buffer[2];
+
+	FN_ENTER;
+	status = SPI_CheckBusyPin(context);
+	CHECK_STATUS(status);
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+	status = SPI_AppendWaitWhileBusy(context);
+	CHECK_STATUS(status);
+	buffer[noOfBytes++] = MPSSE_CMD_GET_DATA_BITS_LOWBYTE;
+	buffer[noOfBytes++] = MPSSE_CMD_SEND_IMMEDIATE;
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+	CHECK_STATUS(status);
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+
+	status = Mid_ChannelReadTimeout(context->handle,1,buffer,&noOfBytesTransferred,\
+		(0 == timeout)?DEVICE_READ_TIMEOUT:timeout);
+	INFRA_ATOMIC_ADD32(&context->stats.usbReads,1);
+	INFRA_ATOMIC_ADD64(&context->stats.usbBytesRead,noOfBytesTransferred);
+	SPI_TRACE(context,SPI_TRACE_LEVEL_USB,SPI_TRACE_EVENT_USB_READ,status,\
+		noOfBytesTransferred);
+	CHECK_STATUS(status);
+	if(0 == noOfBytesTransferred)
+	{
+		INFRA_ATOMIC_ADD32(&context->stats.shortReads,1);
+		INFRA_ATOMIC_ADD32(&context->stats.timeouts,1);
+		DBG(MSG_ERR,"slave still busy after %u ms\n",(unsigned)timeout);
+		/* The MPSSE keeps waiting and would not execute anything sent after the wait */
+		status = SPI_ResyncLocked(context);
+		CHECK_STATUS(status);
+		status = FT_IO_ERROR;
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Checks that the busy line of the slave can be waited on
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_WaitWhileBusy
+ * \note FT_NOT_SUPPORTED for FT2232D, FT_INVALID_PARAMETER if ADBUS5 is an output
+ * \warning
+ */
+FT_STATUS SPI_CheckBusyPin(ChannelContext *context)
+{
+	if(FT_DEVICE_2232C == context->ftDevice)
+	{
+		DBG(MSG_ERR,"FT2232D has no wait on I/O commands\n");
+		return FT_NOT_SUPPORTED;
+	}
+	if(context->config.currentPinState & SPI_BUSY_PIN)
+	{
+		DBG(MSG_ERR,"busy pin(ADBUS5) is an output\n");
+		return FT_INVALID_PARAMETER;
+	}
+	return FT_OK;
+}
+
+/*!
+ * \brief Appends the command that makes the chip wait while the slave is busy
+ *
+ * The MPSSE does not execute the commands that follow until the busy line of the slave has
+ * its ready level
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_CheckBusyPin, SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH
+ * \note The caller checks the busy line with SPI_CheckBusyPin
+ * \warning
+ */
+FT_STATUS SPI_AppendWaitWhileBusy(ChannelContext *context)
+{
+	FT_STATUS status;
+	uint8 cmd;
+
+	FN_ENTER;
+	cmd = (context->config.configOptions & SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH)?\
+		MPSSE_CMD_WAIT_ON_IO_LOW:MPSSE_CMD_WAIT_ON_IO_HIGH;
+	SPI_TRACE(context,SPI_TRACE_LEVEL_CMDS,SPI_TRACE_EVENT_CMD,cmd,0);
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,&cmd,1);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Recovers a channel whose MPSSE is stuck in a wait on I/O
+ *
+ * This function resets the MPSSE, discards what is in the buffers of the chip and the driver,
+ * synchronizes with the MPSSE again and applies the clock and pin settings of the channel
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_WaitWhileBusyLocked
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_ResyncLocked(ChannelContext *context)
+{
+	FT_STATUS status;
+	ChannelConfig config;
+
+	FN_ENTER;
+	status = Mid_ResetMPSSE(context->handle);
+	CHECK_STATUS(status);
+	status = Mid_PurgeDevice(context->handle);
+	CHECK_STATUS(status);
+	status = Mid_EnableMPSSEIn(context->handle);
+	CHECK_STATUS(status);
+	status = Mid_SyncMPSSE(context->handle);
+	CHECK_STATUS(status);
+	status = Mid_SetDeviceLoopbackState(context->handle,MID_LOOPBACK_FALSE);
+	CHECK_STATUS(status);
+	/* The reset has put the clock and the pins of the MPSSE back to their defaults */
+	context->clock.rate = 0;
+	memset(&context->pins,0,sizeof(MidPins));
+	INFRA_MEMCPY(&config,&context->config,sizeof(ChannelConfig));
+	status = SPI_ReinitChannelLocked(context,&config);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Selects the data commands for a transfer
+ *
+ * This function provides the byte mode and bit mode MPSSE data commands that clock data in,
+ * out or in both directions, depending on the SPI mode and the bit order of the channel. All
+ * the transfer functions take their data commands from it
+ *
+ * \param[in] context Context of the channel
+ * \param[in] in TRUE if data is to be clocked in
+ * \param[in] out TRUE if data is to be clocked out
+ * \param[out] byteCmd Pointer to variable in which the byte mode command is returned
+ * \param[out] bitCmd Pointer to variable in which the bit mode command is returned
+ * \return none
+ * \sa SPI_ReadLocked, SPI_WriteLocked, SPI_ReadWriteLocked, SPI_AsyncSubmitLocked,
+ *		SPI_TransferListLocked
+ * \note Data is clocked out on the edge opposite to the one on which it is sampled
+ * \warning
+ */
+void SPI_SelectDataCmds(ChannelContext *context, bool in, bool out,
+	uint8 *byteCmd, uint8 *bitCmd)
+{
+	uint8 mode;
+	bool risingSample;
+
+	/*mode is given by bit1-bit0 of ChannelConfig.Options*/
+	mode = (context->config.configOptions & SPI_CONFIG_OPTION_MODE_MASK);
+	risingSample = ((SPI_CONFIG_OPTION_MODE0 == mode) || \
+		(SPI_CONFIG_OPTION_MODE3 == mode))?TRUE:FALSE;
+	if(in && out)
+	{
+		*byteCmd = risingSample?MPSSE_CMD_DATA_BYTES_IN_POS_OUT_NEG_EDGE:\
+			MPSSE_CMD_DATA_BYTES_IN_NEG_OUT_POS_EDGE;
+		*bitCmd = risingSample?MPSSE_CMD_DATA_BITS_IN_POS_OUT_NEG_EDGE:\
+			MPSSE_CMD_DATA_BITS_IN_NEG_OUT_POS_EDGE;
+	}
+	else if(in)
+	{
+		*byteCmd = risingSample?MPSSE_CMD_DATA_IN_BYTES_POS_EDGE:\
+			MPSSE_CMD_DATA_IN_BYTES_NEG_EDGE;
+		*bitCmd = risingSample?MPSSE_CMD_DATA_IN_BITS_POS_EDGE:\
+			MPSSE_CMD_DATA_IN_BITS_NEG_EDGE;
+	}
+	else
+	{
+		*byteCmd = risingSample?MPSSE_CMD_DATA_OUT_BYTES_NEG_EDGE:\
+			MPSSE_CMD_DATA_OUT_BYTES_POS_EDGE;
+		*bitCmd = risingSample?MPSSE_CMD_DATA_OUT_BITS_NEG_EDGE:\
+			MPSSE_CMD_DATA_OUT_BITS_POS_EDGE;
+	}
+	if(context->config.configOptions & SPI_CONFIG_OPTION_LSB_FIRST)
+	{/* The LSB first variants of the commands */
+		*byteCmd |= MPSSE_DATA_LSB_FIRST_BIT;
+		*bitCmd |= MPSSE_DATA_LSB_FIRST_BIT;
+	}
+}
+
+/*!
+ * \brief Starts an asynchronous transfer
+ *
+ * This function does the work of SPI_ReadAsync, SPI_WriteAsync and SPI_ReadWriteAsync. The
+ * direction of the transfer is given by which of the two buffers is provided
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in] inBuffer Buffer for the data clocked in, NULL if nothing is to be read
+ * \param[in] outBuffer Data to be clocked out, NULL if nothing is to be written
+ * \param[in] sizeToTransfer Size of data to be transferred
+ * \param[in] transferOptions Data transfer options
+ * \param[in] callback Function to be called when the transfer completes
+ * \param[in] userData Passed to the callback as it is
+ * \param[out] ticket Pointer to variable in which the ticket of the transfer is returned
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AsyncSubmitLocked
+ * \note When the queue is full of transfers whose callbacks are yet to be called, the
+ *		callbacks are called and the submission is retried
+ * \warning
+ */
+FT_STATUS SPI_AsyncSubmit(FT_HANDLE handle, uint8 *inBuffer, uint8 *outBuffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket)
+{
+	FT_STATUS status;
+	ChannelContext *context=NULL;
+	bool queued=FALSE;
+	uint64 startTime;
+	FN_ENTER;
+
+	startTime = Infra_GetNanoseconds();
+	while(!queued)
+	{
+		status = SPI_LockChannelContext(handle,&context);
+		CHECK_STATUS(status);
+		SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_ENTER,SPI_STATS_CALL_ASYNC,\
+			sizeToTransfer);
+		status = SPI_AsyncSubmitLocked(context,inBuffer,outBuffer,sizeToTransfer,\
+			transferOptions,callback,userData,ticket,&queued);
+		SPI_TRACE(context,SPI_TRACE_LEVEL_API,SPI_TRACE_EVENT_EXIT,SPI_STATS_CALL_ASYNC,\
+			status);
+		if(queued)
+			SPI_StatsRecord(context,SPI_STATS_CALL_ASYNC,startTime);
+		SPI_UnlockChannelContext(context);
+		CHECK_STATUS(status);
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Sends an asynchronous transfer to the chip, called with the channel locked
+ *
+ * This function makes room for the transfer in the channel's queue, assembles its commands
+ * in the command buffer, sends them to the chip and adds the transfer to the queue
+ *
+ * \param[in] context Context of the channel
+ * \param[out] queued Set to FALSE if the queue is full of transfers whose callbacks are yet
+ *			to be called, in which case nothing is sent
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AsyncSubmit
+ * \note The other parameters are the same as those of SPI_AsyncSubmit. The transfers already
+ *		in the chip are completed first if the new transfer would make the data waiting to
+ *		be read back exceed SPI_ASYNC_MAX_READ_PENDING. A transfer that on its own reads
+ *		more than that completes before this function returns
+ * \warning
+ */
+FT_STATUS SPI_AsyncSubmitLocked(ChannelContext *context, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 transferOptions,
+	SPI_CALLBACK callback, void *userData, uint32 *ticket, bool *queued)
+{
+	FT_STATUS status=FT_OK;
+	SpiAsyncEntry *entry;
+	uint32 readLength=0;
+	uint8 byteCmd=0,bitCmd=0;
+	uint8 cmd;
+	FN_ENTER;
+
+	*queued = FALSE;
+	if(NULL != inBuffer)
+	{
+		readLength = (transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)?\
+			((sizeToTransfer+7)/8):sizeToTransfer;
+	}
+	/* Slots of completed transfers are reused only after their callbacks have been called */
+	while((context->asyncNext - context->asyncDelivered) >= SPI_ASYNC_QUEUE_SIZE)
+	{
+		if(context->asyncCompleted == context->asyncNext)
 		{
-			*config= &(channelContext.config);
-			status = FT_OK;
+			FN_EXIT;
+			return status;
+		}
+		status = SPI_AsyncCompleteLocked(context,context->asyncCompleted,TRUE);
+		CHECK_STATUS(status);
+	}
+	/* Bound the data that waits in the chip and the driver to be read back */
+	while((context->asyncCompleted != context->asyncNext) && \
+		((context->asyncReadPending + readLength) > SPI_ASYNC_MAX_READ_PENDING))
+	{
+		status = SPI_AsyncCompleteLocked(context,context->asyncCompleted,TRUE);
+		CHECK_STATUS(status);
+	}
+
+	SPI_SelectDataCmds(context,(NULL != inBuffer)?TRUE:FALSE,\
+		(NULL != outBuffer)?TRUE:FALSE,&byteCmd,&bitCmd);
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE)
+	{
+		status = SPI_AppendToggleCS(context,TRUE);
+		CHECK_STATUS(status);
+	}
+	if(transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+		status = SPI_AppendBitCmds(context,byteCmd,bitCmd,outBuffer,sizeToTransfer);
+	else
+		status = SPI_AppendByteCmds(context,byteCmd,outBuffer,sizeToTransfer);
+	CHECK_STATUS(status);
+	if(transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
+	{
+		status = SPI_AppendToggleCS(context,FALSE);
+		CHECK_STATUS(status);
+	}
+	if(readLength > 0)
+	{/*Command MPSSE to send data to PC immediately */
+		cmd = MPSSE_CMD_SEND_IMMEDIATE;
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,&cmd,1);
+		CHECK_STATUS(status);
+	}
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+
+	*ticket = context->asyncNext++;
+	*queued = TRUE;
+	entry = &context->asyncQueue[*ticket % SPI_ASYNC_QUEUE_SIZE];
+	entry->ticket = *ticket;
+	entry->inBuffer = inBuffer;
+	entry->readLength = readLength;
+	entry->sizeToTransfer = sizeToTransfer;
+	entry->transferOptions = transferOptions;
+	entry->callback = callback;
+	entry->userData = userData;
+	entry->status = FT_OK;
+	entry->sizeTransferred = 0;
+	context->asyncReadPending += readLength;
+	DBG(MSG_DEBUG,"ticket=%u readLength=%u readPending=%u\n",(unsigned)*ticket,\
+		(unsigned)readLength,(unsigned)context->asyncReadPending);
+
+	if(readLength > SPI_ASYNC_MAX_READ_PENDING)
+	{
+		status = SPI_AsyncCompleteLocked(context,*ticket,TRUE);
+		CHECK_STATUS(status);
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Completes asynchronous transfers in order, called with the channel locked
+ *
+ * This function reads back the data of the oldest transfers of the channel that are still
+ * in the chip, up to and including the one with the given ticket
+ *
+ * \param[in] context Context of the channel
+ * \param[in] ticket Ticket of the last transfer to be completed
+ * \param[in] block If FALSE then the function stops at the first transfer whose data has not
+ *			yet fully arrived in the D2XX driver, instead of waiting for it
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AsyncDeliver
+ * \note The status of a failed read is reported through the transfer, not by this function.
+ *		A read that fails or comes back short(FT_IO_ERROR) leaves the data of the later
+ *		transfers out of step with their buffers, so those transfers fail with FT_IO_ERROR
+ *		too, having transferred nothing, and the channel is resynchronized(SPI_ResyncLocked)
+ * \warning
+ */
+FT_STATUS SPI_AsyncCompleteLocked(ChannelContext *context, uint32 ticket,
+	bool block)
+{
+	FT_STATUS status=FT_OK;
+	SpiAsyncEntry *entry;
+	DWORD available;
+	uint32 noOfBytesTransferred=0;
+
+	while((context->asyncCompleted != context->asyncNext) && \
+		(context->asyncCompleted <= ticket))
+	{
+		entry = &context->asyncQueue[context->asyncCompleted % SPI_ASYNC_QUEUE_SIZE];
+		if(entry->readLength > 0)
+		{
+			if(!block)
+			{
+				status = Mid_GetQueueStatus(context->handle,&available);
+				CHECK_STATUS(status);
+				if(available < entry->readLength)
+					break;
+			}
+			noOfBytesTransferred = 0;
+			entry->status = SPI_ChannelRead(context,entry->readLength,\
+				entry->inBuffer,&noOfBytesTransferred);
+			context->asyncReadPending -= entry->readLength;
+			if(entry->transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+			{
+				entry->sizeTransferred = (noOfBytesTransferred == entry->readLength)?\
+					entry->sizeToTransfer:(noOfBytesTransferred*8);
+			}
+			else
+				entry->sizeTransferred = noOfBytesTransferred;
+			if((FT_OK == entry->status) && (noOfBytesTransferred < entry->readLength))
+				entry->status = FT_IO_ERROR;
 		}
 		else
-			DBG(MSG_DEBUG,"handle not found in channel config list\n");
-#else
-	if(NULL == ListHead)
+			entry->sizeTransferred = entry->sizeToTransfer;
+		context->asyncCompleted++;
+		if(FT_OK != entry->status)
+		{
+			DBG(MSG_ERR,"ticket %u read %u of %u bytes, failing the transfers after it\n",\
+				(unsigned)entry->ticket,(unsigned)noOfBytesTransferred,\
+				(unsigned)entry->readLength);
+			/* The queue is emptied before the resync, which completes it again */
+			while(context->asyncCompleted != context->asyncNext)
+			{
+				entry = &context->asyncQueue[context->asyncCompleted % \
+					SPI_ASYNC_QUEUE_SIZE];
+				entry->status = FT_IO_ERROR;
+				entry->sizeTransferred = 0;
+				context->asyncCompleted++;
+			}
+			context->asyncReadPending = 0;
+			status = SPI_ResyncLocked(context);
+			CHECK_STATUS(status);
+			break;
+		}
+	}
+	return status;
+}
+
+/*!
+ * \brief Calls the callbacks of the completed asynchronous transfers
+ *
+ * This function calls, in order, the callbacks of the transfers of the channel that have
+ * completed since the callbacks were last called
+ *
+ * \param[in] context Context of the channel
+ * \return none
+ * \sa SPI_AsyncCompleteLocked
+ * \note Must be called with the channel unlocked, so that a callback may start new
+ *		transfers on the channel
+ * \warning
+ */
+void SPI_AsyncDeliver(ChannelContext *context)
+{
+	SpiAsyncEntry entry;
+
+	for(;;)
+	{
+		LOCK_CHANNEL(context);
+		if(context->asyncDelivered == context->asyncCompleted)
+		{
+			UNLOCK_CHANNEL(context);
+			break;
+		}
+		entry = context->asyncQueue[context->asyncDelivered % SPI_ASYNC_QUEUE_SIZE];
+		context->asyncDelivered++;
+		UNLOCK_CHANNEL(context);
+		if(NULL != entry.callback)
+		{
+			entry.callback(context->handle,entry.ticket,entry.status,\
+				entry.sizeTransferred,entry.userData);
+		}
+	}
+}
+
+/*!
+ * \brief Body of SPI_Wait, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns the status of the transfer
+ * \sa SPI_Wait
+ * \note The other parameters are the same as those of SPI_Wait
+ * \warning
+ */
+FT_STATUS SPI_WaitLocked(ChannelContext *context, uint32 ticket,
+	uint32 *sizeTransferred)
+{
+	FT_STATUS status;
+	SpiAsyncEntry *entry;
+	FN_ENTER;
+
+	entry = &context->asyncQueue[ticket % SPI_ASYNC_QUEUE_SIZE];
+	if((0 == ticket) || (ticket >= context->asyncNext) || (entry->ticket != ticket))
+	{
+		DBG(MSG_ERR,"invalid ticket %u\n",(unsigned)ticket);
+		return FT_INVALID_PARAMETER;
+	}
+	status = SPI_AsyncCompleteLocked(context,ticket,TRUE);
+	CHECK_STATUS(status);
+	if(NULL != sizeTransferred)
+		*sizeTransferred = entry->sizeTransferred;
+	status = entry->status;
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Body of SPI_TransferList, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_TransferList
+ * \note The other parameters are the same as those of SPI_TransferList. The segments are
+ *		checked before anything is sent, so an invalid list has no effect on the chip
+ * \warning
+ */
+FT_STATUS SPI_TransferListLocked(ChannelContext *context,
+	const SpiSegment *segments, uint32 noOfSegments)
+{
+	FT_STATUS status;
+	ChannelConfig *config=NULL;
+	const SpiSegment *segment;
+	uint32 channelMode,mode;
+	uint32 i,first,readLength,readPending;
+	uint32 noOfBytes;
+	uint8 byteCmd=0,bitCmd=0;
+	uint8 buffer[MID_CLOCK_CMDS_SIZE];
+	bool wait=FALSE;
+	FN_ENTER;
+
+	for(i=0;i<noOfSegments;i++)
+	{
+		segment = &segments[i];
+		if(((segment->length > 0) && (NULL == segment->txBuffer) && \
+			(NULL == segment->rxBuffer)) || (segment->clockRate > MAX_CLOCK_RATE) || \
+			(segment->mode > SPI_SEGMENT_MODE(SPI_CONFIG_OPTION_MODE3)))
+		{
+			DBG(MSG_ERR,"invalid segment %u\n",(unsigned)i);
+			return FT_INVALID_PARAMETER;
+		}
+		if(segment->transferOptions & SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY)
+		{
+			status = SPI_CheckBusyPin(context);
+			CHECK_STATUS(status);
+			wait = TRUE;
+		}
+	}
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+
+	config = &context->config;
+	channelMode = config->configOptions & SPI_CONFIG_OPTION_MODE_MASK;
+	first = 0;
+	readPending = 0;
+	for(i=0;(i<noOfSegments) && (FT_OK == status);i++)
+	{
+		segment = &segments[i];
+		readLength = 0;
+		if(NULL != segment->rxBuffer)
+		{
+			readLength = (segment->transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)?\
+				((segment->length+7)/8):segment->length;
+		}
+		/* Read back what the earlier segments clocked in before the data waiting to be read
+		could overflow the buffers of the chip and the driver */
+		if((readPending > 0) && ((readPending + readLength) > SPI_ASYNC_MAX_READ_PENDING))
+		{
+			status = SPI_TransferListRead(context,&segments[first],i-first);
+			first = i;
+			readPending = 0;
+			if(FT_OK != status)
+				break;
+		}
+
+		mode = (0 == segment->mode)?channelMode:(uint32)(segment->mode-1);
+		if(mode != (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK))
+			status = SPI_AppendMode(context,mode);
+		if((FT_OK == status) && (0 != segment->clockRate))
+		{/* Nothing is sent if the rate gives the settings the chip already has */
+			Mid_GetClockCmds(context->ftDevice,segment->clockRate,\
+				SPI_CLOCK_OPTIONS(config->configOptions),&context->clock,buffer,&noOfBytes);
+			if(noOfBytes > 0)
+				status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+		}
+		if((FT_OK == status) && \
+			(segment->transferOptions & SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY))
+			status = SPI_AppendWaitWhileBusy(context);
+		if((FT_OK == status) && \
+			(segment->transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE))
+			status = SPI_AppendToggleCS(context,TRUE);
+		if((FT_OK == status) && (segment->length > 0))
+		{
+			SPI_SelectDataCmds(context,(NULL != segment->rxBuffer)?TRUE:FALSE,\
+				(NULL != segment->txBuffer)?TRUE:FALSE,&byteCmd,&bitCmd);
+			if(segment->transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)
+			{
+				status = SPI_AppendBitCmds(context,byteCmd,bitCmd,segment->txBuffer,\
+					segment->length);
+			}
+			else
+			{
+				status = SPI_AppendByteCmds(context,byteCmd,segment->txBuffer,\
+					segment->length);
+			}
+		}
+		if((FT_OK == status) && \
+			(segment->transferOptions & SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE))
+			status = SPI_AppendToggleCS(context,FALSE);
+		if((FT_OK == status) && (segment->delayCycles > 0))
+			status = SPI_AppendIdleCycles(context,segment->delayCycles);
+		readPending += readLength;
+	}
+
+	/* Leave the channel in its own mode and clock rate */
+	if(channelMode != (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK))
+	{
+		if(FT_OK == status)
+			status = SPI_AppendMode(context,channelMode);
+		else
+			SPI_AppendMode(context,channelMode);
+	}
+	if(FT_OK == status)
+	{
+		Mid_GetClockCmds(context->ftDevice,config->ClockRate,\
+			SPI_CLOCK_OPTIONS(config->configOptions),&context->clock,buffer,&noOfBytes);
+		if(noOfBytes > 0)
+			status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+	}
+	if(FT_OK == status)
+		status = SPI_TransferListRead(context,&segments[first],noOfSegments-first);
+	if(FT_OK != status)
+	{/* The commands assembled may not all have reached the chip */
+		context->clock.rate = 0;
+		context->pins.lowKnown = context->pins.highKnown = FALSE;
+	}
+	if((FT_IO_ERROR == status) && wait)
+	{/* The data may be missing because a wait on the busy line has not ended */
+		SPI_ResyncLocked(context);
+	}
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Sends the commands of a transfer list and reads back the data of its segments
+ *
+ * This function sends the commands assembled in the channel's command buffer to the chip and
+ * stores the data clocked in by each of the given segments in its rxBuffer
+ *
+ * \param[in] context Context of the channel
+ * \param[in] segments Segments whose commands are in the command buffer
+ * \param[in] noOfSegments Number of segments
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_TransferListLocked
+ * \note Returns FT_IO_ERROR if the data of a segment did not arrive in time
+ * \warning
+ */
+FT_STATUS SPI_TransferListRead(ChannelContext *context,
+	const SpiSegment *segments, uint32 noOfSegments)
+{
+	FT_STATUS status=FT_OK;
+	uint32 i,readLength,noOfBytesTransferred;
+	bool read=FALSE;
+	uint8 cmd;
+	FN_ENTER;
+
+	for(i=0;i<noOfSegments;i++)
+	{
+		if((NULL != segments[i].rxBuffer) && (segments[i].length > 0))
+			read = TRUE;
+	}
+	if(read)
+	{/*Command MPSSE to send data to PC immediately */
+		cmd = MPSSE_CMD_SEND_IMMEDIATE;
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,&cmd,1);
+		CHECK_STATUS(status);
+	}
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+
+	for(i=0;(i<noOfSegments) && read;i++)
+	{
+		if((NULL == segments[i].rxBuffer) || (0 == segments[i].length))
+			continue;
+		readLength = (segments[i].transferOptions & SPI_TRANSFER_OPTIONS_SIZE_IN_BITS)?\
+			((segments[i].length+7)/8):segments[i].length;
+		noOfBytesTransferred = 0;
+		status = SPI_ChannelRead(context,readLength,segments[i].rxBuffer,\
+			&noOfBytesTransferred);
+		CHECK_STATUS(status);
+		if(noOfBytesTransferred != readLength)
+		{
+			DBG(MSG_ERR,"segment %u: requested %u bytes, read %u\n",(unsigned)i,\
+				(unsigned)readLength,(unsigned)noOfBytesTransferred);
+			status = FT_IO_ERROR;
+			break;
+		}
+	}
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Appends the command that switches the channel to another SPI mode
+ *
+ * This function changes the mode in the channel's configuration, which selects the data
+ * commands of later transfers, and appends the command that moves SCLK to the idle level of
+ * the mode
+ *
+ * \param[in] context Context of the channel
+ * \param[in] mode SPI_CONFIG_OPTION_MODE0 to SPI_CONFIG_OPTION_MODE3
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_ChangeCS
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_AppendMode(ChannelContext *context, uint32 mode)
+{
+	FT_STATUS status;
+	ChannelConfig *config=&context->config;
+	FN_ENTER;
+
+	config->configOptions = (config->configOptions & ~SPI_CONFIG_OPTION_MODE_MASK) | \
+		(mode & SPI_CONFIG_OPTION_MODE_MASK);
+	if((SPI_CONFIG_OPTION_MODE2 == mode) || (SPI_CONFIG_OPTION_MODE3 == mode))
+		config->currentPinState |= 0x0100;/* clock idle high */
+	else
+		config->currentPinState &= 0xFEFF;/* clock idle low */
+	status = SPI_AppendPins(context);
+	CHECK_STATUS(status);
+	FN_EXIT;
+	return status;
+}
+
+/*!
+ * \brief Switches a channel to the settings of a slave attached with SPI_AttachDevice
+ *
+ * This function makes the mode, chip select, polarities and clock rate of the slave those of
+ * the channel and appends to the channel's command buffer the commands of the settings that
+ * differ from the ones last sent to the chip. Nothing is appended when the slave was also
+ * the one accessed last
+ *
+ * \param[in] context Context of the channel
+ * \param[in] device Slave that the next transfer is for
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_AttachDevice, SPI_AppendMode, SPI_AppendPins
+ * \note A chip select that was not an output before becomes one at the level that deselects
+ *		its slave
+ * \warning
+ */
+FT_STATUS SPI_SelectDeviceLocked(ChannelContext *context, SpiDevice *device)
+{
+	FT_STATUS status;
+	ChannelConfig *config=&context->config;
+	uint32 configOptions;
+	uint32 noOfBytes;
+	uint8 buffer[MID_CLOCK_CMDS_SIZE];
+	uint8 pin;
+	FN_ENTER;
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+
+	configOptions = (config->configOptions & ~SPI_DEVICE_OPTIONS_MASK) | \
+		device->configOptions;
+	if(configOptions != config->configOptions)
 	{
-		DBG(MSG_NOTICE,"List is empty\n");
+		pin = SPI_CS_LOW_PIN(configOptions);
+		if(0 == (config->currentPinState & pin))
+		{/* The pin becomes an output at the level that deselects the slave */
+			if(configOptions & SPI_CONFIG_OPTION_CS_ACTIVELOW)
+				config->currentPinState |= (uint16)pin<<8;
+			else
+				config->currentPinState &= ~((uint16)pin<<8);
+		}
+		config->currentPinState |= pin;
+		SPI_PrepareCSHigh(context,configOptions);
+		config->configOptions = configOptions;
 	}
-	else
+	/* The pins and the clock are only written if they are not already as the slave needs */
+	status = SPI_AppendMode(context,configOptions & SPI_CONFIG_OPTION_MODE_MASK);
+	CHECK_STATUS(status);
+	config->ClockRate = device->clockRate;
+	Mid_GetClockCmds(context->ftDevice,config->ClockRate,\
+		SPI_CLOCK_OPTIONS(config->configOptions),&context->clock,buffer,&noOfBytes);
+	if(noOfBytes > 0)
 	{
-		for(tempNode=ListHead; NULL != tempNode; tempNode=tempNode->next)
-		{
-			if(tempNode->handle == handle)
-			{/*Node found*/
-				*config = &(tempNode->config);
-				status = FT_OK;
-			}
-		}
+		status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+		CHECK_STATUS(status);
 	}
-#endif
-
 	FN_EXIT;
-#ifdef INFRA_DEBUG_ENABLE
-	SPI_DisplayList();
-#endif
 	return status;
 }
 
 /*!
- * \brief Display the contents of linked list
+ * \brief Corrects the pin settings of a channel configuration
  *
- * This function traverses the channel configuration data linked list
- * and prints the data at each node.
+ * This function ensures that the library puts the lines to correct directions even if wrong
+ * values are passed by the user, sets the idle state of the clock line as per the SPI mode
+ * and copies the initial pin state to currentPinState
+ *
+ * \param[in,out] config Pointer to ChannelConfig structure
+ * \return none
+ * \sa SPI_InitChannel, SPI_ReinitChannel
+ * \note
+ * \warning
+ */
+void SPI_PrepareConfig(ChannelConfig *config)
+{
+	uint8 mode;
+
+	/* Set initial direction of line SCLK  as OUT */
+	config->Pin |= 0x00000001;/*Note: Direction is out if bit is 1!!! */
+	/* Set initial direction of  MOSI line as OUT */
+	config->Pin |= 0x00000002;
+	/* Set initial direction of MISO line as IN */
+	config->Pin &= 0xFFFFFFFB;
+	/* Set initial direction of CS line as OUT, if it is on the low byte */
+	config->Pin |= SPI_CS_LOW_PIN(config->configOptions);
+
+	/*Set initial state of clock line*/
+	mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
+	switch(mode)
+	{
+		case 0:
+		case 1:
+			/* clock idle low */
+			config->Pin &= 0xFFFFFEFF;
+			break;
+
+		case 2:
+		case 3:
+			/* clock idle high */
+			config->Pin |= 0x00000100;
+			break;
+		default:
+			DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
+	}
+
+	/* Copy initial state values to present state variable */
+	config->currentPinState = (uint16)config->Pin;
+}
+
+/*!
+ * \brief Registers the receive event of a channel if the configuration asks for it
  *
+ * \param[in] context Context of the channel
+ * \param[in] config Configuration being applied to the channel
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note	Useful for debuging
+ * \sa SPI_CONFIG_OPTION_RX_EVENT
+ * \note Does nothing if the event is already registered
  * \warning
  */
-FT_STATUS SPI_DisplayList(void)
+FT_STATUS SPI_EnableRxEvent(ChannelContext *context, ChannelConfig *config)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-#ifdef INFRA_DEBUG_ENABLE
-	ChannelContext *tempNode=NULL;
-#endif
+	FT_STATUS status=FT_OK;
 	FN_ENTER;
-#ifdef INFRA_DEBUG_ENABLE
-	printf("%s:%d:%s():\n",__FILE__, __LINE__, __FUNCTION__);
-	for(tempNode = ListHead; 0 != tempNode; tempNode=tempNode->next)
+	if((config->configOptions & SPI_CONFIG_OPTION_RX_EVENT) && \
+		!context->rxEventEnabled)
 	{
-		//if(currentDebugLevel>=MSG_DEBUG)
-		{
-			printf("\ttempNode->handle=0x%x\n",(unsigned)tempNode->handle);
-			printf("\ttempNode-->next=0x%x\n",(unsigned)tempNode->next);
-			printf("\ttempNode->config->ClockRate=%u\n",
-				(unsigned)tempNode->config.ClockRate);
-		}
+		status = Infra_EventInit(&context->rxEvent);
+		CHECK_STATUS(status);
+		status = Mid_SetRxEvent(context->handle,&context->rxEvent);
+		if(FT_OK != status)
+			Infra_EventDestroy(&context->rxEvent);
+		CHECK_STATUS(status);
+		context->rxEventEnabled = TRUE;
 	}
-	printf("------------------------------------------------------\n");
-#endif
 	FN_EXIT;
 	return status;
 }
 
 /*!
- * \brief Toggles the state of the CS line
- *
- * This function turns ON/OFF the chip select line associated with the channel
+ * \brief Checks that the chip can clock the channel as its configuration asks
  *
- * \param[in] handle Handle of the channel
- * \param[in] state TRUE if CS needs to be set, false otherwise
+ * \param[in] ftDevice Type of the chip
+ * \param[in] config Configuration being applied to the channel
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note
+ * \sa SPI_CONFIG_OPTION_3PHASE_CLOCKING, SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING
+ * \note FT_NOT_SUPPORTED for FT2232D, FT_INVALID_PARAMETER if adaptive clocking is asked for
+ *		while ADBUS7 is an output(e.g. the chip select)
  * \warning
  */
-FT_STATUS SPI_ToggleCS(FT_HANDLE handle, bool state)
+FT_STATUS SPI_CheckClockOptions(FT_DEVICE ftDevice, ChannelConfig *config)
 {
-	ChannelConfig *config=NULL;
-	bool activeLow;
-	FT_STATUS status=FT_OTHER_ERROR;
-	uint8 buffer[5];
-	uint32 i=0;
-	uint32 noOfBytesTransferred;
-	uint8 value, oldValue, direction;
-
-	FN_ENTER;
-	if(!state)
+	if(0 == (config->configOptions & SPI_CONFIG_OPTION_CLOCK_MASK))
+		return FT_OK;
+	if(FT_DEVICE_2232C == ftDevice)
 	{
-		INFRA_SLEEP(2);
+		DBG(MSG_ERR,"FT2232D has no three phase or adaptive clocking\n");
+		return FT_NOT_SUPPORTED;
 	}
-#ifdef DEVELOPMENT_FIXED_CS
-//#if 1
-	/* For initial development only - assuming only ADBUS0 will be used for CS*/
-	buffer[i++]=MPSSE_CMD_SET_DATA_BITS_LOWBYTE;
-	if(TRUE==state)
+	if((config->configOptions & SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING) && \
+		(config->currentPinState & SPI_RTCK_PIN))
 	{
-		//buffer[i++]=0x08;		/*value*/
-		buffer[i++]=0x09;		/*value - mode2,3 clock idle high*/
+		DBG(MSG_ERR,"return clock pin(ADBUS7) is an output\n");
+		return FT_INVALID_PARAMETER;
 	}
-	else
+	return FT_OK;
+}
+
+/*!
+ * \brief Checks that the chip has the chip select pin that configOptions select
+ *
+ * \param[in] ftDevice Type of the chip
+ * \param[in] configOptions Options being applied to the channel
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_CONFIG_OPTION_CS_ACBUS
+ * \note FT_NOT_SUPPORTED for FT4232H, whose MPSSE channels have no high byte, and
+ *		FT_INVALID_PARAMETER for ACBUS4-ACBUS7 on FT2232D
+ * \warning
+ */
+FT_STATUS SPI_CheckCSPin(FT_DEVICE ftDevice, uint32 configOptions)
+{
+	if(0 == (configOptions & SPI_CONFIG_OPTION_CS_ACBUS))
+		return FT_OK;
+	if(FT_DEVICE_4232H == ftDevice)
 	{
-		//buffer[i++]=0x00;		/*value*/
-		buffer[i++]=0x01;		/*value - mode2,3 clock idle high*/
+		DBG(MSG_ERR,"FT4232H has no high byte for the chip select\n");
+		return FT_NOT_SUPPORTED;
 	}
-	buffer[i++]=0x0B;//direction;	/*direction*/
-	status = FT_Channel_Write(SPI,handle,i,buffer,&noOfBytesTransferred);
-	CHECK_STATUS(status);
-#else
-	/*Get a pointer to the channel's configuration data and manipulate there directly*/
-	status = SPI_GetChannelConfig(handle,&config);
-	CHECK_STATUS(status);
-	activeLow = (config->configOptions & \
-		SPI_CONFIG_OPTION_CS_ACTIVELOW)?TRUE:FALSE;
+	if((FT_DEVICE_2232C == ftDevice) && \
+		((configOptions & SPI_CONFIG_OPTION_CS_MASK) > (SPI_CONFIG_OPTION_CS_ACBUS3 & \
+		SPI_CONFIG_OPTION_CS_MASK)))
+	{
+		DBG(MSG_ERR,"FT2232D has ACBUS0-ACBUS3 only\n");
+		return FT_INVALID_PARAMETER;
+	}
+	return FT_OK;
+}
 
-	DBG(MSG_DEBUG,"config->configOptions=0x%x activeLow=0x%x\n",
-		(unsigned)config->configOptions,(unsigned)activeLow);
+/*!
+ * \brief Makes the chip select of the high byte that configOptions select an inactive output
+ *
+ * \param[in] context Context of the channel
+ * \param[in] configOptions Options being applied to the channel
+ * \return none
+ * \sa SPI_CONFIG_OPTION_CS_ACBUS
+ * \note Does nothing if the chip select is on the low byte. Chip selects that were selected
+ *		before stay outputs at the level they have
+ * \warning
+ */
+void SPI_PrepareCSHigh(ChannelContext *context, uint32 configOptions)
+{
+	uint8 pin = SPI_CS_HIGH_PIN(configOptions);
 
-	//direction = (uint8)config->currentPinState;/*get current state*/
-	direction = (uint8)(config->currentPinState & 0x00FF);//20110718
-	direction |= \
-		((1<<((config->configOptions & SPI_CONFIG_OPTION_CS_MASK)>>2))<<3);
-	DBG(MSG_DEBUG,"config->currentPinState=0x%x direction=0x%x\n",
-		(unsigned)config->currentPinState,(unsigned)direction);
+	if(0 == pin)
+		return;
+	if(0 == (context->csPinsHigh & pin))
+	{/* The pin becomes an output at the level that deselects the slave */
+		if(configOptions & SPI_CONFIG_OPTION_CS_ACTIVELOW)
+			context->currentPinStateHigh |= (uint16)pin<<8;
+		else
+			context->currentPinStateHigh &= ~((uint16)pin<<8);
+	}
+	context->currentPinStateHigh |= pin;
+	context->csPinsHigh |= pin;
+}
 
-	//oldValue = (uint8)(8>>config->currentPinState);
-	oldValue =  (uint8)((config->currentPinState & 0xFF00)>>8);//20110718
-	value = ((1<<((config->configOptions & SPI_CONFIG_OPTION_CS_MASK)>>2))<<3);
+/*!
+ * \brief Provides the commands that set the low and the high byte of pins of a channel
+ *
+ * This function provides the commands that set the low byte to pinState and the high byte to
+ * currentPinStateHigh of the context, leaving out those that would not change the pins. The
+ * high byte is only written once it has a chip select
+ *
+ * \param[in] context Context of the channel
+ * \param[in] pinState Values and directions of the low byte, as ChannelConfig.currentPinState
+ * \param[out] buffer Buffer of at least SPI_PIN_CMDS_SIZE bytes
+ * \param[out] noOfBytes Pointer to variable in which the number of bytes written is returned
+ * \return none
+ * \sa Mid_GetPinCmds
+ * \note
+ * \warning
+ */
+void SPI_GetPinCmds(ChannelContext *context, uint16 pinState, uint8 *buffer,
+	uint32 *noOfBytes)
+{
+	uint32 noOfHighBytes=0;
 
-	DBG(MSG_DEBUG,"oldValue=0x%x value=0x%x\n",oldValue,value);
+	Mid_GetPinCmds(MPSSE_CMD_SET_DATA_BITS_LOWBYTE,pinState,&context->pins,buffer,\
+		noOfBytes);
+	if(0 != context->csPinsHigh)
+	{
+		Mid_GetPinCmds(MPSSE_CMD_SET_DATA_BITS_HIGHBYTE,context->currentPinStateHigh,\
+			&context->pins,&buffer[*noOfBytes],&noOfHighBytes);
+	}
+	*noOfBytes += noOfHighBytes;
+}
 
-	if((TRUE==state && FALSE==activeLow) || (FALSE==state && TRUE==activeLow))
-		value = oldValue | value; /* set the CS line high */
-	if((TRUE==state && TRUE==activeLow) || (FALSE==state && FALSE==activeLow))
-		value = oldValue & ~value;/* set the CS line low */
+/*!
+ * \brief Keeps the chip selects of a channel when FT_WriteGPIO writes its high byte
+ *
+ * This function is called by FT_WriteGPIO before it writes the high byte of a channel. The
+ * chip selects of the channel on the high byte are kept as outputs at the level they have,
+ * and the state that is written becomes the channel's currentPinStateHigh
+ *
+ * \param[in] handle Handle of the channel
+ * \param[in,out] dir Directions that FT_WriteGPIO writes
+ * \param[in,out] value Values that FT_WriteGPIO writes
+ * \return none
+ * \sa Mid_SetGPIOHook
+ * \note Handles that are not SPI channels are left alone
+ * \warning
+ */
+void SPI_GPIOHook(FT_HANDLE handle, uint8 *dir, uint8 *value)
+{
+	ChannelContext *context=NULL;
+	uint8 mask;
 
-	config->currentPinState = ((uint16)value<<8) | direction;/*save  dirn & value*/
-	DBG(MSG_DEBUG,"config->currentPinState=0x%x\n",
-		(unsigned)config->currentPinState);
+	if(FT_OK != SPI_LockChannelContext(handle,&context))
+		return;
+	mask = context->csPinsHigh;
+	*dir |= mask;
+	*value = (*value & ~mask) | ((uint8)(context->currentPinStateHigh>>8) & mask);
+	context->currentPinStateHigh = ((uint16)*value<<8) | *dir;
+	/* The write goes to the chip directly, the commands of transfers will not repeat it */
+	context->pins.high = context->currentPinStateHigh;
+	context->pins.highKnown = TRUE;
+	UNLOCK_CHANNEL(context);
+	SPI_ReleaseChannelContext(context);
+}
 
-	/*MPSSE command to set low bytes*/
-	buffer[i++]=MPSSE_CMD_SET_DATA_BITS_LOWBYTE;
-	buffer[i++]=value;		/*value*/
-	buffer[i++]=direction;	/*direction*/
-	DBG(MSG_DEBUG,"direction=0x%x value=0x%x\n",direction,value);
-	status = FT_Channel_Write(SPI,handle,i,buffer,&noOfBytesTransferred);
+/*!
+ * \brief Body of SPI_InitChannel, called with the channel locked
+ *
+ * \param[in] context Context of the channel
+ * \param[in] config Configuration to be applied, already corrected by SPI_PrepareConfig
+ * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
+ * \sa SPI_InitChannel, SPI_ReinitChannelLocked
+ * \note
+ * \warning
+ */
+FT_STATUS SPI_InitChannelLocked(ChannelContext *context, ChannelConfig *config)
+{
+	FT_STATUS status;
+	FT_HANDLE handle=context->handle;
+	uint8 buffer[MID_CLOCK_CMDS_SIZE+SPI_PIN_CMDS_SIZE];
+	uint32 noOfBytes=0,noOfPinBytes;
+	uint32 noOfBytesTransferred;
+	FN_ENTER;
+	status = FT_InitChannel(SPI,handle,(uint32)config->ClockRate,	\
+		(uint32)config->LatencyTimer,(uint32)config->configOptions,
+		(uint32)config->Pin);
 	CHECK_STATUS(status);
-#endif
+	if(FT_OK == status)
+	{
+		/* The chip type decides how the CS hold time is generated */
+		status = Mid_GetFtDeviceType(handle,&context->ftDevice);
+		CHECK_STATUS(status);
+		status = SPI_CheckClockOptions(context->ftDevice,config);
+		CHECK_STATUS(status);
+		status = SPI_CheckCSPin(context->ftDevice,config->configOptions);
+		CHECK_STATUS(status);
+		/* Wait for received data on an event instead of blocking in FT_Read */
+		status = SPI_EnableRxEvent(context,config);
+		CHECK_STATUS(status);
+
+		/* FT_InitChannel has set the clock without three phase or adaptive clocking */
+		Mid_SolveClock(context->ftDevice,config->ClockRate,0,&context->clock);
+		Mid_GetClockCmds(context->ftDevice,config->ClockRate,\
+			SPI_CLOCK_OPTIONS(config->configOptions),&context->clock,buffer,&noOfBytes);
+		/* Set the directions and values to the lines, the MPSSE has just been reset */
+		memset(&context->pins,0,sizeof(MidPins));
+		context->currentPinStateHigh = 0;
+		context->csPinsHigh = 0;
+		SPI_PrepareCSHigh(context,config->configOptions);
+		SPI_GetPinCmds(context,config->currentPinState,&buffer[noOfBytes],&noOfPinBytes);
+		noOfBytes += noOfPinBytes;
+		status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
+			&noOfBytesTransferred);
+		CHECK_STATUS(status);
+
+		if(FT_OK == status)
+		{
+			DBG(MSG_DEBUG,"line %u handle=0x%x\n",__LINE__,(unsigned)handle);
+			INFRA_MEMCPY(&(context->config),config,sizeof(ChannelConfig));
+			/* The MPSSE is synchronized, SPI_ReinitChannel may skip the sequence above */
+			context->initialized = TRUE;
+		}
+	}
 	FN_EXIT;
 	return status;
 }
 
 /*!
- * \brief Writes 8 or less bits to the SPI device
+ * \brief Body of SPI_ReinitChannel, called with the channel locked
  *
- * This function is called by SPI_Write to write 8 or few number of bits
- *
- * \param[in] handle Handle of the channel
- * \param[in] byte Data of length 8 or less bits
- * \param[in] len Length of data in bits(maximum 8)
+ * \param[in] context Context of the channel
+ * \param[in] config Configuration to be applied, already corrected by SPI_PrepareConfig
  * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
- * \note
+ * \sa SPI_ReinitChannel
+ * \note The chip executes the clock and pin commands before any later transfer, so there
+ *		is nothing to wait for
  * \warning
  */
-FT_STATUS SPI_Write8bits(FT_HANDLE handle,uint8 byte, uint8 len)
+FT_STATUS SPI_ReinitChannelLocked(ChannelContext *context, ChannelConfig *config)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	uint32 noOfBytes=0,noOfBytesTransferred=0;
-	uint8 buffer[10];
-	ChannelConfig *config=NULL;
-	uint8 mode;
+	FT_STATUS status;
+	uint8 buffer[MID_CLOCK_CMDS_SIZE+SPI_PIN_CMDS_SIZE];
+	uint32 noOfBytes=0,noOfPinBytes;
 	FN_ENTER;
 
-	status = SPI_GetChannelConfig(handle,&config);
+	status = SPI_CheckClockOptions(context->ftDevice,config);
 	CHECK_STATUS(status);
-	/*mode is given by bit1-bit0 of ChannelConfig.Options*/
-	mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-	/* Command to write 8bits */
-	switch(mode)
+	status = SPI_CheckCSPin(context->ftDevice,config->configOptions);
+	CHECK_STATUS(status);
+	/* Data of asynchronous transfers arrives first, read it out of the way */
+	status = SPI_AsyncCompleteLocked(context,context->asyncNext-1,TRUE);
+	CHECK_STATUS(status);
+	if(config->LatencyTimer != context->config.LatencyTimer)
 	{
-		case 0:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BITS_NEG_EDGE;
-			break;
-		case 1:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BITS_POS_EDGE;
-			break;
-		case 2:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BITS_POS_EDGE;
-			break;
-		case 3:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_OUT_BITS_NEG_EDGE;
-			break;
-		default:
-			DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
+		status = Mid_SetLatencyTimer(context->handle,(UCHAR)config->LatencyTimer);
+		CHECK_STATUS(status);
 	}
-	buffer[noOfBytes++] = len-1;/* 1bit->arg=0, for 8bits->arg=7 */
-	buffer[noOfBytes++] = byte;
-	DBG(MSG_DEBUG,"SPIMODE=%u buffer[0]=0x%x writing data=0x%x len=%u\n",
-		(unsigned)mode,(unsigned)buffer[0],(unsigned)byte,(unsigned)len);
-	status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-		&noOfBytesTransferred);
+	status = SPI_EnableRxEvent(context,config);
 	CHECK_STATUS(status);
 
+	/* Only the clock settings that differ from those of the chip are sent */
+	Mid_GetClockCmds(context->ftDevice,config->ClockRate,\
+		SPI_CLOCK_OPTIONS(config->configOptions),&context->clock,buffer,&noOfBytes);
+	/* Set the directions and values to the lines, unless they have them already */
+	SPI_PrepareCSHigh(context,config->configOptions);
+	SPI_GetPinCmds(context,config->currentPinState,&buffer[noOfBytes],&noOfPinBytes);
+	noOfBytes += noOfPinBytes;
+	status = Mid_CmdBufferAppend(&context->cmdBuffer,buffer,noOfBytes);
+	CHECK_STATUS(status);
+	status = Mid_CmdBufferFlush(&context->cmdBuffer);
+	CHECK_STATUS(status);
+	INFRA_MEMCPY(&context->config,config,sizeof(ChannelConfig));
 	FN_EXIT;
 	return status;
 }
 
-
 /*!
- * \brief Reads 8 or less bits to the SPI device
+ * \brief Records a call of a transfer function in the statistics of a channel
  *
- * This function is called by SPI_Read to read 8 or few number of bits
+ * This function adds the time elapsed since startTime to the latency histogram of the call.
+ * The bin is found from the position of the most significant bit of the latency and the two
+ * bits below it(see SPI_STATS_HISTOGRAM_BINS)
  *
- * \param[in] handle Handle of the channel
- * \param[in] byte Data of length 8 or less bits
- * \param[in] len Length of data in bits(maximum 8)
- * \param[in] mode SPI mode
- * \return Returns status code of type FT_STATUS(see D2XX Programmer's Guide)
- * \sa
+ * \param[in] context Context of the channel, locked by the caller
+ * \param[in] call SPI_STATS_CALL_xxx
+ * \param[in] startTime Value of Infra_GetNanoseconds when the call started
+ * \return none
+ * \sa SPI_GetStats
  * \note
  * \warning
  */
-FT_STATUS SPI_Read8bits(FT_HANDLE handle,uint8 *byte, uint8 len)
+void SPI_StatsRecord(ChannelContext *context, uint32 call, uint64 startTime)
 {
-	FT_STATUS status=FT_OTHER_ERROR;
-	uint32 noOfBytes=0,noOfBytesTransferred=0;
-	uint8 buffer[10];
-	ChannelConfig *config=NULL;
-	uint8 mode;
+	uint64 latency;
+	uint32 msb=0;
+	uint32 bin;
 
-	FN_ENTER;
-	status = SPI_GetChannelConfig(handle,&config);
-	CHECK_STATUS(status);
-	/*mode is given by bit1-bit0 of ChannelConfig.Options*/
-	mode = (config->configOptions & SPI_CONFIG_OPTION_MODE_MASK);
-	/* Command to write 8bits */
-	switch(mode)
+	latency = (Infra_GetNanoseconds() - startTime)/1000;
+	if(latency < 4)
 	{
-		case 0:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BITS_POS_EDGE;
-			break;
-		case 1:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BITS_NEG_EDGE;
-			break;
-		case 2:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BITS_NEG_EDGE;
-			break;
-		case 3:
-			buffer[noOfBytes++] = MPSSE_CMD_DATA_IN_BITS_POS_EDGE;
-			break;
-		default:
-			DBG(MSG_DEBUG,"invalid mode(%u)\n",(unsigned)mode);
+		bin = (uint32)latency;
 	}
-	buffer[noOfBytes++] = len-1;/* 1bit->arg=0, for 8bits->arg=7 */
-
-	/*Command MPSSE to send data to PC immediately */
-	buffer[noOfBytes++] = MPSSE_CMD_SEND_IMMEDIATE;
-
-	DBG(MSG_DEBUG,"writing data=0x%x len=%u\n",(unsigned)byte,(unsigned)len);
-	status = FT_Channel_Write(SPI,handle,noOfBytes,buffer,\
-		&noOfBytesTransferred);
-	CHECK_STATUS(status);
-
-	noOfBytes=1;
-	noOfBytesTransferred=0;
-	status = FT_Channel_Read(SPI,handle,noOfBytes,buffer,&noOfBytesTransferred);
-	CHECK_STATUS(status);
+	else
+	{
+		while((latency >> (msb+1)) != 0)
+			msb++;
+		bin = ((msb-1)<<2) | (uint32)((latency >> (msb-2)) & 3);
+		if(bin >= SPI_STATS_HISTOGRAM_BINS)
+			bin = SPI_STATS_HISTOGRAM_BINS - 1;
+	}
+	INFRA_ATOMIC_ADD32(&context->stats.latency[call][bin],1);
+	if(SPI_STATS_CALL_WAIT != call)
+		INFRA_ATOMIC_ADD32(&context->stats.transactions,1);
+}
 
-	*byte = buffer[0];
-	DBG(MSG_DEBUG,"SPI_Read8bits len=%u(in bits) byte=0x%x mode=%u\n",\
-		(unsigned)len,*byte,(unsigned)mode);
+/*!
+ * \brief Records an event in the trace of a channel
+ *
+ * \param[in] context Context of the channel, locked by the caller
+ * \param[in] type SPI_TRACE_EVENT_xxx
+ * \param[in] code Code of the event, see SPI_TRACE_EVENT_xxx
+ * \param[in] value Value of the event, see SPI_TRACE_EVENT_xxx
+ * \return none
+ * \sa SPI_TRACE
+ * \note Called through the macro SPI_TRACE, which checks the trace level of the channel
+ * \warning
+ */
+void SPI_TraceEvent(ChannelContext *context, uint8 type, uint8 code, uint32 value)
+{
+	SpiTraceEvent *event;
 
-	FN_EXIT;
-	return status;
+	event = &context->trace[context->traceNext & (SPI_TRACE_BUFFER_SIZE-1)];
+	event->timestamp = Infra_GetNanoseconds();
+	event->value = value;
+	event->type = type;
+	event->code = code;
+	event->reserved = 0;
+	context->traceNext++;
 }
 
+/*!
+ * \brief Records a USB write in the trace of a channel
+ *
+ * This function is set as the write hook of the channel's command buffer while the trace level
+ * is SPI_TRACE_LEVEL_USB or higher
+ *
+ * \param[in] hookContext Context of the channel
+ * \param[in] status Status of the write
+ * \param[in] noOfBytes Number of bytes written
+ * \return none
+ * \sa SPI_SetTraceLevel, MID_WRITE_HOOK
+ * \note
+ * \warning
+ */
+void SPI_TraceWriteHook(void *hookContext, FT_STATUS status, uint32 noOfBytes)
+{
+	ChannelContext *context=(ChannelContext*)hookContext;
 
+	SPI_TRACE(context,SPI_TRACE_LEVEL_USB,SPI_TRACE_EVENT_USB_WRITE,status,noOfBytes);
+}
 
@@ -24,6 +24,28 @@
  * 0.2  - 20110708 - added FT_ReadGPIO, FT_WriteGPIO & SPI_ChangeCS
  * 0.3  - 20111025 - modified for supporting 64bit linux
  * 0.41 - 20140903 - modified for compilation issues with either C application/C++ application
+ * 0.5  - 20261015 - added csHoldCycles to ChannelConfig
+ *				  added asynchronous transfers(SPI_ReadAsync, SPI_WriteAsync,
+ *				  SPI_ReadWriteAsync, SPI_Wait & SPI_Poll)
+ *				  added SPI_CONFIG_OPTION_RX_EVENT
+ *				  added SPI_TransferList & SpiSegment
+ *				  added SPI_RefreshChannelList
+ *				  added SPI_OpenChannelBySerial, SPI_OpenChannelByLocation &
+ *				  SPI_OpenChannelByDescription
+ *				  added SPI_ReinitChannel
+ *				  added SPI_GetStats, SPI_ResetStats & SpiStats
+ *				  added SPI_SetTraceLevel, SPI_GetTrace & SPI_DumpTrace
+ *				  added the emulator(Emu_Install, Emu_Uninstall, Emu_AttachSlave,
+ *				  Emu_GetStats, Emu_ResetStats, Emu_LoopbackSlave & Emu_FlashSlave)
+ *				  added SPI_WaitWhileBusy, SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY,
+ *				  SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH & EmuSlave.busy
+ *				  added SPI_CONFIG_OPTION_3PHASE_CLOCKING & SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING
+ *				  added SPI_GetClockRate
+ *				  added SPI_CONFIG_OPTION_CS_ACBUS0-7, EmuSlave.csPin 8-15 are ACBUS0-ACBUS7
+ *				  added SPI_AttachDevice, SPI_DetachDevice, SPI_DeviceRead, SPI_DeviceWrite,
+ *				  SPI_DeviceReadWrite, SPI_DeviceTransferList & SPI_DEVICE
+ *				  added SPI_CONFIG_OPTION_LSB_FIRST & SPI_ReverseBits
+ *				  added SPI_CONFIG_OPTION_CS_HOLD, csHoldCycles is ignored unless it is set
  */
 
 #ifndef LIBMPSSE_SPI_H
@@ -52,6 +74,9 @@
 #define	SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE		0x00000002
 /* transferOptions-Bit2: if BIT2 is 1 then CHIP_SELECT line will be disabled at end of transfer */
 #define SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE		0x00000004
+/* transferOptions-Bit3: if BIT3 is 1 then the chip waits for the slave to be ready(see
+SPI_WaitWhileBusy) before the transfer. Only honoured by SPI_TransferList */
+#define SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY		0x00000008
 
 
 
@@ -72,6 +97,100 @@
 
 #define SPI_CONFIG_OPTION_CS_ACTIVELOW	0x00000020
 
+/*If set, reads sleep on an event that D2XX signals when data arrives instead of blocking in
+FT_Read*/
+#define SPI_CONFIG_OPTION_RX_EVENT		0x00000040
+
+/*If set, the busy line of the slave(GPIOL1) is high while the slave is busy, otherwise it is
+low while the slave is busy*/
+#define SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH	0x00000080
+
+/*If set, each SCLK cycle has three phases: data is put out on one edge, held for half a period
+and sampled on the next edge, so it is stable at both ends of long cables. A cycle lasts 1.5
+periods and the fastest clock is 20MHz. FT2232H, FT4232H & FT232H only*/
+#define SPI_CONFIG_OPTION_3PHASE_CLOCKING	0x00000100
+/*If set, each SCLK edge waits for the slave to return the clock on GPIOL3(ADBUS7), which must
+then be an input. FT2232H, FT4232H & FT232H only*/
+#define SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING	0x00000200
+#define SPI_CONFIG_OPTION_CLOCK_MASK		0x00000300
+
+/*If set, BIT4-BIT2 select ACBUS0-ACBUS7(the high byte of pins) as the chip select instead of
+ADBUS3-ADBUS7, so that a channel can have up to 13 slaves. FT2232H & FT232H, ACBUS0-ACBUS3 on
+FT2232D. FT_WriteGPIO keeps the chip selects of the channel as they are*/
+#define SPI_CONFIG_OPTION_CS_ACBUS		0x00000400
+#define SPI_CONFIG_OPTION_CS_ACBUS0		0x00000400		/*1 000 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS1		0x00000404		/*1 001 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS2		0x00000408		/*1 010 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS3		0x0000040C		/*1 011 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS4		0x00000410		/*1 100 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS5		0x00000414		/*1 101 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS6		0x00000418		/*1 110 00*/
+#define SPI_CONFIG_OPTION_CS_ACBUS7		0x0000041C		/*1 111 00*/
+
+/*If set, data is clocked LSB first, so that buffers in that order need not be bit reversed
+with SPI_ReverseBits. The bits of a transfer whose size is not a multiple of 8 are clocked from
+bit 0 of the last byte, and received into its top bits*/
+#define SPI_CONFIG_OPTION_LSB_FIRST		0x00000800
+
+/*If set, CS is held inactive for ChannelConfig.csHoldCycles SCLK cycles after it is disabled.
+If not set, csHoldCycles is ignored, so that callers built before it was added, whose
+ChannelConfig has padding in its place, get no hold*/
+#define SPI_CONFIG_OPTION_CS_HOLD		0x00001000
+
+/*Value of SpiSegment.mode that selects SPI mode SPI_CONFIG_OPTION_MODEx for the segment*/
+#define SPI_SEGMENT_MODE(mode)	((uint8)(((mode) & SPI_CONFIG_OPTION_MODE_MASK)+1))
+
+/*Maximum number of asynchronous transfers of a channel whose completion has not yet been
+reported*/
+#define SPI_ASYNC_QUEUE_SIZE			32
+
+/*Calls whose latency is recorded in SpiStats.latency*/
+#define SPI_STATS_CALL_READ				0
+#define SPI_STATS_CALL_WRITE			1
+#define SPI_STATS_CALL_READWRITE		2
+#define SPI_STATS_CALL_ASYNC			3/*SPI_ReadAsync, SPI_WriteAsync & SPI_ReadWriteAsync*/
+#define SPI_STATS_CALL_WAIT				4
+#define SPI_STATS_CALL_TRANSFER_LIST	5
+#define SPI_STATS_NO_OF_CALLS			6
+/*Number of bins of a latency histogram. Bins 0 to 3 count calls that took 0 to 3us, after
+that every power of 2 is split into 4 bins of equal width, so that the resolution is 25% of
+the latency. The last bin also counts anything longer than it*/
+#define SPI_STATS_HISTOGRAM_BINS		96
+/*Lowest latency in microseconds counted by a bin of the histogram*/
+#define SPI_STATS_BIN_LOWER_US(bin)	(((bin) < 4)?(uint64)(bin):\
+	((uint64)(4 + ((bin) & 3)) << (((bin) >> 2) - 1)))
+
+/*Levels of the trace of a channel(SPI_SetTraceLevel). Each level also records the events of
+the levels below it*/
+#define SPI_TRACE_LEVEL_OFF				0
+#define SPI_TRACE_LEVEL_API				1/*entry to and exit from the transfer functions*/
+#define SPI_TRACE_LEVEL_USB				2/*USB writes and reads*/
+#define SPI_TRACE_LEVEL_CMDS			3/*MPSSE commands*/
+/*Number of events kept by the trace of a channel(power of 2). Older events are overwritten*/
+#define SPI_TRACE_BUFFER_SIZE			4096
+/*Types of trace events(SpiTraceEvent.type) and the meaning of their code and value*/
+#define SPI_TRACE_EVENT_ENTER			1/*SPI_STATS_CALL_xxx, size to transfer or ticket*/
+#define SPI_TRACE_EVENT_EXIT			2/*SPI_STATS_CALL_xxx, status*/
+#define SPI_TRACE_EVENT_USB_WRITE		3/*status, number of bytes written*/
+#define SPI_TRACE_EVENT_USB_READ		4/*status, number of bytes read*/
+#define SPI_TRACE_EVENT_CMD				5/*MPSSE opcode, length of data in bytes or bits,
+										SCLK cycles or value and direction of pins*/
+/*Start of a file written by SPI_DumpTrace*/
+#define SPI_TRACE_FILE_MAGIC			"MPSSETRC"
+#define SPI_TRACE_FILE_VERSION			1
+
+/*Environment variable that makes the library start on emulated chips instead of loading D2XX.
+Its value is the number of channels to emulate*/
+#define EMU_ENVIRONMENT_VARIABLE		"LIBMPSSE_EMULATOR"
+/*Defaults of the members of EmuConfig that are 0*/
+#define EMU_DEFAULT_CHANNELS			2
+#define EMU_DEFAULT_PACKET_SIZE			512
+#define EMU_DEFAULT_USB_RATE			40000000/*bytes per second*/
+#define EMU_DEFAULT_TRANSFER_TIME		125000/*ns*/
+#define EMU_MAX_CHANNELS				16
+/*Size of the memory of Emu_FlashSlave when 0 is given*/
+#define EMU_FLASH_DEFAULT_SIZE			0x100000
+
 
 /******************************************************************************/
 /*								Type defines								  */
@@ -123,7 +242,14 @@ typedef struct ChannelConfig_t
  			 : 011 - A/B/C/D_DBUS6=ChipSelect
  			 : 100 - A/B/C/D_DBUS7=ChipSelect
  	BIT5: ChipSelect is active high if this bit is 0
-	BIT6 -BIT31		: Reserved
+	BIT6: Wait for received data on an event(SPI_CONFIG_OPTION_RX_EVENT)
+	BIT7: Busy line is high while the slave is busy(SPI_CONFIG_OPTION_BUSY_ACTIVEHIGH)
+	BIT8: Three phase clocking(SPI_CONFIG_OPTION_3PHASE_CLOCKING)
+	BIT9: Adaptive clocking(SPI_CONFIG_OPTION_ADAPTIVE_CLOCKING)
+	BIT10: BIT4-BIT2 select ACBUS0-ACBUS7 as ChipSelect(SPI_CONFIG_OPTION_CS_ACBUS)
+	BIT11: Data is clocked LSB first(SPI_CONFIG_OPTION_LSB_FIRST)
+	BIT12: CS is held inactive for csHoldCycles(SPI_CONFIG_OPTION_CS_HOLD)
+	BIT13 -BIT31	: Reserved
 	*/
 
 	uint32		Pin;/*BIT7   -BIT0:   Initial direction of the pins	*/
@@ -131,8 +257,117 @@ typedef struct ChannelConfig_t
 					/*BIT23 -BIT16: Final direction of the pins		*/
 					/*BIT31 -BIT24: Final values of the pins		*/
 	uint16		reserved;
+	uint16		csHoldCycles;/*Number of SCLK cycles for which CS is held inactive
+							after it is disabled. 0 = no hold. Only used if
+							SPI_CONFIG_OPTION_CS_HOLD is set. Approximate on
+							FT2232D, which writes the pins again instead and
+							holds CS for at most about 43us*/
 }ChannelConfig;
 
+/*One transfer of the list passed to SPI_TransferList. Members that are 0 leave the settings
+of the channel unchanged*/
+typedef struct SpiSegment_t
+{
+	uint8	*txBuffer;/*data to be clocked out, NULL if the segment only reads*/
+	uint8	*rxBuffer;/*where the data clocked in is stored, NULL if the segment only writes*/
+	uint32	length;/*size of the data, in bytes or bits as per transferOptions*/
+	uint32	transferOptions;/*SPI_TRANSFER_OPTIONS_xxx, as in SPI_ReadWrite*/
+	uint32	delayCycles;/*SCLK cycles to wait after the segment, before the next one*/
+	uint32	clockRate;/*clock rate of the segment, 0 = clock rate of the channel*/
+	uint8	mode;/*SPI_SEGMENT_MODE(x) to use SPI mode x, 0 = mode of the channel*/
+}SpiSegment;
+
+/*Statistics of a channel, returned by SPI_GetStats*/
+typedef struct SpiStats_t
+{
+	uint64	bytesOut;/*data bytes clocked out to the slave*/
+	uint64	bytesIn;/*data bytes clocked in from the slave*/
+	uint64	usbBytesWritten;/*bytes of commands and data written to the chip*/
+	uint64	usbBytesRead;/*bytes read back from the chip*/
+	uint32	usbWrites;/*USB writes issued*/
+	uint32	usbReads;/*reads of data from the chip*/
+	uint32	transactions;/*calls that transferred data, see SPI_STATS_CALL_xxx*/
+	uint32	csToggles;/*times the CS line was enabled or disabled*/
+	uint32	timeouts;/*reads that ended because the read timeout expired*/
+	uint32	shortReads;/*reads that returned fewer bytes than asked for, for any reason*/
+	uint32	latency[SPI_STATS_NO_OF_CALLS][SPI_STATS_HISTOGRAM_BINS];/*histogram of the
+			time taken by each call, see SPI_STATS_BIN_LOWER_US*/
+}SpiStats;
+
+/*An event recorded in the trace of a channel*/
+typedef struct SpiTraceEvent_t
+{
+	uint64	timestamp;/*nanoseconds, from a monotonic clock*/
+	uint32	value;
+	uint8	type;/*SPI_TRACE_EVENT_xxx*/
+	uint8	code;
+	uint16	reserved;
+}SpiTraceEvent;
+
+/*Header of a file written by SPI_DumpTrace. It is followed by noOfEvents events, oldest
+first, in the byte order of the host that wrote the file*/
+typedef struct SpiTraceFileHeader_t
+{
+	char	magic[8];/*SPI_TRACE_FILE_MAGIC, not terminated*/
+	uint32	version;/*SPI_TRACE_FILE_VERSION*/
+	uint32	noOfEvents;
+}SpiTraceFileHeader;
+
+/*Functions of a virtual SPI slave of the emulator. Bits are passed in the order they are on
+the wire, the first one in bit 7. transfer returns the bits driven on MISO, aligned the same way*/
+typedef void (*EMU_SLAVE_SELECT)(void *context, bool selected);
+typedef uint8 (*EMU_SLAVE_TRANSFER)(void *context, uint8 mosi, uint8 noOfBits);
+typedef void (*EMU_SLAVE_DESTROY)(void *context);
+typedef bool (*EMU_SLAVE_BUSY)(void *context);
+
+/*A virtual SPI slave attached to an emulated channel with Emu_AttachSlave*/
+typedef struct EmuSlave_t
+{
+	uint8	csPin;/*ADBUS pin(3-7) that selects the slave, or 8-15 for ACBUS0-ACBUS7*/
+	bool	csActiveLow;
+	EMU_SLAVE_SELECT	select;/*called when the slave is selected or deselected, may be NULL*/
+	EMU_SLAVE_TRANSFER	transfer;/*called for the bits clocked while it is selected*/
+	EMU_SLAVE_DESTROY	destroy;/*called when the slave is detached, may be NULL*/
+	EMU_SLAVE_BUSY	busy;/*TRUE while the slave pulls GPIOL1 low, may be NULL*/
+	void	*context;/*passed to the functions*/
+}EmuSlave;
+
+/*Chips emulated by Emu_Install. Members that are 0 take the EMU_DEFAULT_xxx value*/
+typedef struct EmuConfig_t
+{
+	uint32	noOfChannels;/*MPSSE channels listed by the emulated D2XX*/
+	uint32	deviceType;/*FT_DEVICE_2232H(default), FT_DEVICE_4232H or FT_DEVICE_232H*/
+	uint32	usbPacketSize;/*size of the bulk packets in bytes*/
+	uint32	usbBytesPerSecond;/*throughput of the bus*/
+	uint32	usbTransferTime;/*ns of overhead of each FT_Write and FT_Read*/
+	uint32	fifoSize;/*bytes, 0 = FIFO size of deviceType*/
+}EmuConfig;
+
+/*Counters of an emulated channel, returned by Emu_GetStats. time is the virtual time that
+the traffic would have taken on the chip and bus that are modelled*/
+typedef struct EmuStats_t
+{
+	uint64	time;/*ns*/
+	uint64	sckCycles;/*clock cycles generated by the MPSSE*/
+	uint64	bytesWritten;/*bytes written by the host*/
+	uint64	bytesRead;/*bytes read by the host*/
+	uint32	usbWrites;
+	uint32	usbReads;/*reads that returned data*/
+	uint32	outPackets;
+	uint32	inPackets;
+	uint32	latencyFlushes;/*IN packets sent because the latency timer expired*/
+	uint32	sendImmediates;/*IN packets sent because of SEND_IMMEDIATE*/
+	uint32	commands;/*MPSSE commands executed*/
+	uint32	badCommands;/*commands answered with the bad command response*/
+}EmuStats;
+
+/*Handle of a slave attached to a channel with SPI_AttachDevice*/
+typedef void *SPI_DEVICE;
+
+/*Function called when an asynchronous transfer completes*/
+typedef void (*SPI_CALLBACK)(FT_HANDLE handle, uint32 ticket, FT_STATUS status,
+	uint32 sizeTransferred, void *userData);
+
 
 /******************************************************************************/
 /*								External variables							  */
@@ -148,8 +383,16 @@ typedef struct ChannelConfig_t
 FTDI_API FT_STATUS SPI_GetNumChannels(uint32 *numChannels);
 FTDI_API FT_STATUS SPI_GetChannelInfo(uint32 index,
 	FT_DEVICE_LIST_INFO_NODE *chanInfo);
+FTDI_API FT_STATUS SPI_RefreshChannelList(void);
 FTDI_API FT_STATUS SPI_OpenChannel(uint32 index, FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelBySerial(const char *serialNumber,
+	FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelByLocation(uint32 locationId, FT_HANDLE *handle);
+FTDI_API FT_STATUS SPI_OpenChannelByDescription(const char *description,
+	FT_HANDLE *handle);
 FTDI_API FT_STATUS SPI_InitChannel(FT_HANDLE handle, ChannelConfig *config);
+FTDI_API FT_STATUS SPI_ReinitChannel(FT_HANDLE handle, ChannelConfig *config);
+FTDI_API FT_STATUS SPI_GetClockRate(FT_HANDLE handle, uint32 *clockRate);
 FTDI_API FT_STATUS SPI_CloseChannel(FT_HANDLE handle);
 FTDI_API FT_STATUS SPI_Read(FT_HANDLE handle, uint8 *buffer,
 	uint32 sizeToTransfer, uint32 *sizeTransfered, uint32 options);
@@ -159,12 +402,54 @@ FTDI_API FT_STATUS SPI_ReadWrite(FT_HANDLE handle, uint8 *inBuffer,
 	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
 	uint32 transferOptions);
 FTDI_API FT_STATUS SPI_IsBusy(FT_HANDLE handle, bool *state);
+FTDI_API FT_STATUS SPI_WaitWhileBusy(FT_HANDLE handle, uint32 timeout);
 FTDI_API void Init_libMPSSE(void);
 FTDI_API void Cleanup_libMPSSE(void);
 FTDI_API FT_STATUS SPI_ChangeCS(FT_HANDLE handle, uint32 configOptions);
 FTDI_API FT_STATUS FT_WriteGPIO(FT_HANDLE handle, uint8 dir, uint8 value);
 FTDI_API FT_STATUS FT_ReadGPIO(FT_HANDLE handle,uint8 *value);
 FTDI_API FT_STATUS SPI_ToggleCS(FT_HANDLE handle, bool state);
+FTDI_API FT_STATUS SPI_ReadAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_WriteAsync(FT_HANDLE handle, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 transferOptions, SPI_CALLBACK callback,
+	void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_ReadWriteAsync(FT_HANDLE handle, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 transferOptions,
+	SPI_CALLBACK callback, void *userData, uint32 *ticket);
+FTDI_API FT_STATUS SPI_Wait(FT_HANDLE handle, uint32 ticket,
+	uint32 *sizeTransferred);
+FTDI_API FT_STATUS SPI_Poll(FT_HANDLE handle, uint32 *noOfPending);
+FTDI_API FT_STATUS SPI_TransferList(FT_HANDLE handle, const SpiSegment *segments,
+	uint32 noOfSegments);
+FTDI_API FT_STATUS SPI_AttachDevice(FT_HANDLE handle, uint32 configOptions,
+	uint32 clockRate, SPI_DEVICE *device);
+FTDI_API FT_STATUS SPI_DetachDevice(SPI_DEVICE device);
+FTDI_API FT_STATUS SPI_DeviceRead(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceWrite(SPI_DEVICE device, uint8 *buffer,
+	uint32 sizeToTransfer, uint32 *sizeTransferred, uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceReadWrite(SPI_DEVICE device, uint8 *inBuffer,
+	uint8 *outBuffer, uint32 sizeToTransfer, uint32 *sizeTransferred,
+	uint32 transferOptions);
+FTDI_API FT_STATUS SPI_DeviceTransferList(SPI_DEVICE device, const SpiSegment *segments,
+	uint32 noOfSegments);
+FTDI_API FT_STATUS SPI_ReverseBits(uint8 *buffer, uint32 size);
+FTDI_API FT_STATUS SPI_GetStats(FT_HANDLE handle, SpiStats *stats);
+FTDI_API FT_STATUS SPI_ResetStats(FT_HANDLE handle);
+FTDI_API FT_STATUS SPI_SetTraceLevel(FT_HANDLE handle, uint32 level);
+FTDI_API FT_STATUS SPI_GetTrace(FT_HANDLE handle, SpiTraceEvent *events,
+	uint32 maxEvents, uint32 *noOfEvents);
+FTDI_API FT_STATUS SPI_DumpTrace(FT_HANDLE handle, const char *fileName);
+FTDI_API FT_STATUS Emu_Install(const EmuConfig *config);
+FTDI_API FT_STATUS Emu_Uninstall(void);
+FTDI_API FT_STATUS Emu_AttachSlave(uint32 index, const EmuSlave *slave);
+FTDI_API FT_STATUS Emu_GetStats(uint32 index, EmuStats *stats);
+FTDI_API FT_STATUS Emu_ResetStats(uint32 index);
+FTDI_API FT_STATUS Emu_LoopbackSlave(uint8 csPin, bool csActiveLow, EmuSlave *slave);
+FTDI_API FT_STATUS Emu_FlashSlave(uint8 csPin, bool csActiveLow, uint32 size,
+	EmuSlave *slave);
 
 
 
@@ -0,0 +1,439 @@
+/*!
+ * \file spi-bench.c
+ *
+ * \author FTDI
+ * \date 20261015
+ *
+ * Copyright  2000-2014 Future Technology Devices International Limited
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Project: libMPSSE
+ * Module: Tools - throughput and latency benchmark of SPI_Write, SPI_Read & SPI_ReadWrite
+ *
+ * Builds with:
+ *		Linux:	make spi-bench (LibMPSSE/Build/Linux), or
+ *				gcc -I../include -I../include/linux -o spi-bench spi-bench.c libMPSSE.a -ldl -lpthread
+ *		Windows:gcc -I../include -I../include/windows -o spi-bench.exe spi-bench.c libMPSSE.a
+ * Usage:
+ *		spi-bench [-i index] [-e] [-o csv|json] [-f functions] [-u units] [-s sizes]
+ *			[-m modes] [-c clocks] [-n calls] [-t ms] [-l latency]
+ *
+ * Every combination of function, unit, size, mode and clock rate is a point. The calls of a
+ * point are repeated until -n calls have been made or -t milliseconds have elapsed, and one
+ * line(CSV) or object(JSON) is printed for each point:
+ *		function,unit,size,mode,clock_hz,calls,mb_per_s,lat_min_us,lat_mean_us,lat_p50_us,
+ *		lat_p99_us,lat_max_us,usb_writes_per_call,usb_reads_per_call,usb_bytes_per_call,
+ *		emu_mb_per_s,emu_us_per_call,emu_out_packets_per_call,emu_in_packets_per_call
+ * clock_hz is the SCLK that the channel generates(see SPI_GetClockRate), the nearest one that
+ * the chip can make to the clock rate given with -c. size is in bytes. In bit mode size*8-1 bits are transferred, so that the last bits go
+ * through a bit command, and mb_per_s counts them as bits/8 bytes. The usb_ columns come from
+ * SPI_GetStats. The emu_ columns are filled in when the channel is emulated(see
+ * Emu_Install) and give the time that the modelled chip and bus would have taken; they are
+ * empty(CSV) or null(JSON) on real hardware. On the emulator the wall clock columns(mb_per_s,
+ * lat_) measure the CPU time of the library and of the emulator only.
+ *
+ * The benchmark runs on whatever D2XX the library loads: the driver, a stub libftd2xx
+ * found first on the library path, or the emulator when LIBMPSSE_EMULATOR is set or -e is
+ * given. -e replaces a D2XX library that was loaded; on machines without one the library can
+ * only be started with LIBMPSSE_EMULATOR. When the channel is emulated a loopback slave is
+ * attached to ADBUS3.
+ *
+ * Rivision History:
+ * 0.5  - 20261015 - Initial version
+ *				  clock_hz is the rate returned by SPI_GetClockRate
+ */
+
+/******************************************************************************/
+/* 							 Include files										   */
+/******************************************************************************/
+/* Standard C libraries */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<time.h>
+/* OS specific libraries */
+#ifdef _WIN32
+#include<windows.h>
+#endif
+
+/* Include D2XX header*/
+#include "ftd2xx.h"
+
+/* Include libMPSSE header */
+#include "libMPSSE_spi.h"
+
+/******************************************************************************/
+/*								Macro and type defines							   */
+/******************************************************************************/
+#define BENCH_MAX_LIST				32
+#define BENCH_MAX_CALLS				100000
+#define BENCH_FUNCTION_WRITE		0
+#define BENCH_FUNCTION_READ			1
+#define BENCH_FUNCTION_READWRITE	2
+#define BENCH_UNIT_BYTES			0
+#define BENCH_UNIT_BITS				1
+#define BENCH_CS_PIN				3
+
+#define BENCH_OPTIONS	(SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE | \
+	SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
+
+typedef struct BenchList_t
+{
+	uint32	count;
+	uint32	value[BENCH_MAX_LIST];
+}BenchList;
+
+/******************************************************************************/
+/*								Global variables							  	    */
+/******************************************************************************/
+static const char *functionNames[] = {"SPI_Write","SPI_Read","SPI_ReadWrite"};
+static const char *unitNames[] = {"bytes","bits"};
+static const char *columns[] = {"function","unit","size","mode","clock_hz","calls",
+	"mb_per_s","lat_min_us","lat_mean_us","lat_p50_us","lat_p99_us","lat_max_us",
+	"usb_writes_per_call","usb_reads_per_call","usb_bytes_per_call","emu_mb_per_s",
+	"emu_us_per_call","emu_out_packets_per_call","emu_in_packets_per_call"};
+
+static double latencies[BENCH_MAX_CALLS];
+
+/******************************************************************************/
+/*						Local function definitions						  		   */
+/******************************************************************************/
+/*!
+ * \brief Returns the time of a monotonic clock in microseconds
+ */
+static double now_us(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter,frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return (double)counter.QuadPart*1e6/(double)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (double)ts.tv_sec*1e6+(double)ts.tv_nsec/1e3;
+#endif
+}
+
+/*!
+ * \brief Parses a comma separated list of numbers, or of names when names is not NULL
+ */
+static int parse_list(const char *text, const char **names, uint32 noOfNames,
+	BenchList *list)
+{
+	char buffer[512],*item;
+	uint32 i;
+
+	strncpy(buffer,text,sizeof(buffer)-1);
+	buffer[sizeof(buffer)-1] = '\0';
+	list->count = 0;
+	for(item=strtok(buffer,",");NULL!=item;item=strtok(NULL,","))
+	{
+		if(list->count == BENCH_MAX_LIST)
+			return -1;
+		if(NULL == names)
+		{
+			list->value[list->count++] = (uint32)strtoul(item,NULL,0);
+			continue;
+		}
+		for(i=0;i<noOfNames;i++)
+		{
+			if(0 == strcmp(item,names[i]))
+				break;
+		}
+		if(i == noOfNames)
+			return -1;
+		list->value[list->count++] = i;
+	}
+	return (0 == list->count)?-1:0;
+}
+
+/*!
+ * \brief Orders latencies for qsort
+ */
+static int compare_latency(const void *a, const void *b)
+{
+	double x = *(const double*)a,y = *(const double*)b;
+	return (x < y)?-1:((x > y)?1:0);
+}
+
+/*!
+ * \brief Makes one call of the function of a point
+ */
+static FT_STATUS bench_call(FT_HANDLE handle, uint32 function, uint32 unit,
+	uint32 size, uint8 *inBuffer, uint8 *outBuffer)
+{
+	uint32 sizeToTransfer=size,sizeTransferred=0,options=BENCH_OPTIONS;
+
+	if(BENCH_UNIT_BITS == unit)
+	{
+		sizeToTransfer = size*8-1;
+		options |= SPI_TRANSFER_OPTIONS_SIZE_IN_BITS;
+	}
+	switch(function)
+	{
+		case BENCH_FUNCTION_WRITE:
+			return SPI_Write(handle,outBuffer,sizeToTransfer,&sizeTransferred,options);
+		case BENCH_FUNCTION_READ:
+			return SPI_Read(handle,inBuffer,sizeToTransfer,&sizeTransferred,options);
+		default:
+			return SPI_ReadWrite(handle,inBuffer,outBuffer,sizeToTransfer,
+				&sizeTransferred,options);
+	}
+}
+
+/*!
+ * \brief Prints a number of a result, or an empty(CSV) or null(JSON) value when it is
+ * not available
+ */
+static void print_value(int json, int available, double value)
+{
+	if(available)
+		printf("%.3f",value);
+	else if(json)
+		printf("null");
+}
+
+/******************************************************************************/
+/*						Public function definitions						  		   */
+/******************************************************************************/
+int main(int argc, char **argv)
+{
+	FT_STATUS status;
+	FT_HANDLE handle;
+	FT_DEVICE_LIST_INFO_NODE info;
+	ChannelConfig config;
+	SpiStats stats;
+	EmuStats emuStats;
+	EmuSlave slave;
+	BenchList functions,units,sizes,modes,clocks;
+	uint32 index=0,maxCalls=100,budgetMs=100,latencyTimer=1,noOfChannels=0;
+	uint32 f,u,s,m,c,calls,clockRate=0,maxSize=0,points=0;
+	int json=0,install=0,emulated,i;
+	uint8 *inBuffer,*outBuffer;
+	double start,before,total,sum,bytes;
+
+	parse_list("SPI_Write,SPI_Read,SPI_ReadWrite",functionNames,3,&functions);
+	parse_list("bytes,bits",unitNames,2,&units);
+	parse_list("1,4,16,64,256,1024,4096,16384,65536,262144,1048576,4194304,16777216",
+		NULL,0,&sizes);
+	parse_list("0,1,2,3",NULL,0,&modes);
+	parse_list("1000000,10000000,30000000",NULL,0,&clocks);
+	for(i=1;i<argc;i++)
+	{
+		const char *arg = argv[i],*value = (i+1 < argc)?argv[i+1]:NULL;
+		int bad = 0;
+
+		if(0 == strcmp(arg,"-e"))
+		{
+			install = 1;
+			continue;
+		}
+		if(NULL == value)
+			bad = 1;
+		else if(0 == strcmp(arg,"-i"))
+			index = (uint32)strtoul(value,NULL,0);
+		else if(0 == strcmp(arg,"-o"))
+			json = (0 == strcmp(value,"json"));
+		else if(0 == strcmp(arg,"-f"))
+			bad = parse_list(value,functionNames,3,&functions);
+		else if(0 == strcmp(arg,"-u"))
+			bad = parse_list(value,unitNames,2,&units);
+		else if(0 == strcmp(arg,"-s"))
+			bad = parse_list(value,NULL,0,&sizes);
+		else if(0 == strcmp(arg,"-m"))
+			bad = parse_list(value,NULL,0,&modes);
+		else if(0 == strcmp(arg,"-c"))
+			bad = parse_list(value,NULL,0,&clocks);
+		else if(0 == strcmp(arg,"-n"))
+			maxCalls = (uint32)strtoul(value,NULL,0);
+		else if(0 == strcmp(arg,"-t"))
+			budgetMs = (uint32)strtoul(value,NULL,0);
+		else if(0 == strcmp(arg,"-l"))
+			latencyTimer = (uint32)strtoul(value,NULL,0);
+		else
+			bad = 1;
+		if(bad)
+		{
+			fprintf(stderr,"usage: %s [-i index] [-e] [-o csv|json] "
+				"[-f SPI_Write,SPI_Read,SPI_ReadWrite] [-u bytes,bits] [-s sizes] "
+				"[-m modes] [-c clocks] [-n calls] [-t ms] [-l latency]\n",argv[0]);
+			return 1;
+		}
+		i++;
+	}
+	if((0 == maxCalls) || (maxCalls > BENCH_MAX_CALLS))
+		maxCalls = BENCH_MAX_CALLS;
+	for(s=0;s<sizes.count;s++)
+	{
+		if((0 == sizes.value[s]) || (sizes.value[s] > 0x1FFFFFFF))
+		{
+			fprintf(stderr,"invalid size %u\n",(unsigned)sizes.value[s]);
+			return 1;
+		}
+		if(sizes.value[s] > maxSize)
+			maxSize = sizes.value[s];
+	}
+
+#ifdef _MSC_VER
+	Init_libMPSSE();
+#endif
+	memset(&emuStats,0,sizeof(emuStats));
+	emulated = (FT_OK == Emu_GetStats(index,&emuStats));
+	if(install && !emulated)
+	{
+		status = Emu_Install(NULL);
+		if(FT_OK != status)
+		{
+			fprintf(stderr,"Emu_Install failed(%u)\n",(unsigned)status);
+			return 1;
+		}
+		emulated = 1;
+	}
+	status = SPI_GetNumChannels(&noOfChannels);
+	if((FT_OK != status) || (index >= noOfChannels))
+	{
+		fprintf(stderr,"channel %u not found(%u channels, status %u)\n",(unsigned)index,
+			(unsigned)noOfChannels,(unsigned)status);
+		return 1;
+	}
+	memset(&info,0,sizeof(info));
+	SPI_GetChannelInfo(index,&info);
+	status = SPI_OpenChannel(index,&handle);
+	if(FT_OK != status)
+	{
+		fprintf(stderr,"SPI_OpenChannel failed(%u)\n",(unsigned)status);
+		return 1;
+	}
+	if(emulated)
+	{
+		Emu_LoopbackSlave(BENCH_CS_PIN,TRUE,&slave);
+		Emu_AttachSlave(index,&slave);
+	}
+	inBuffer = (uint8*)malloc(maxSize);
+	outBuffer = (uint8*)malloc(maxSize);
+	if((NULL == inBuffer) || (NULL == outBuffer))
+	{
+		fprintf(stderr,"out of memory\n");
+		return 1;
+	}
+	for(s=0;s<maxSize;s++)
+		outBuffer[s] = (uint8)(s*13+7);
+
+	if(json)
+	{
+		printf("{\n\"channel\": {\"index\": %u, \"description\": \"%s\", "
+			"\"serial\": \"%s\", \"emulated\": %s},\n\"results\": [",(unsigned)index,
+			info.Description,info.SerialNumber,emulated?"true":"false");
+	}
+	else
+	{
+		for(i=0;i<(int)(sizeof(columns)/sizeof(columns[0]));i++)
+			printf("%s%s",i?",":"",columns[i]);
+		printf("\n");
+	}
+
+	memset(&config,0,sizeof(config));
+	config.LatencyTimer = (uint8)latencyTimer;
+	for(c=0;c<clocks.count;c++)
+	for(m=0;m<modes.count;m++)
+	{
+		config.ClockRate = clocks.value[c];
+		config.configOptions = (modes.value[m] & SPI_CONFIG_OPTION_MODE_MASK) | \
+			SPI_CONFIG_OPTION_CS_DBUS3 | SPI_CONFIG_OPTION_CS_ACTIVELOW;
+		status = SPI_ReinitChannel(handle,&config);
+		if(FT_OK != status)
+		{
+			fprintf(stderr,"SPI_ReinitChannel(%u Hz, mode %u) failed(%u)\n",
+				(unsigned)config.ClockRate,(unsigned)modes.value[m],(unsigned)status);
+			return 1;
+		}
+		SPI_GetClockRate(handle,&clockRate);
+		for(f=0;f<functions.count;f++)
+		for(u=0;u<units.count;u++)
+		for(s=0;s<sizes.count;s++)
+		{
+			SPI_ResetStats(handle);
+			if(emulated)
+				Emu_ResetStats(index);
+			calls = 0;
+			start = now_us();
+			do
+			{
+				before = now_us();
+				status = bench_call(handle,functions.value[f],units.value[u],
+					sizes.value[s],inBuffer,outBuffer);
+				latencies[calls++] = now_us()-before;
+				if(FT_OK != status)
+				{
+					fprintf(stderr,"%s of %u %s failed(%u)\n",functionNames[functions.value[f]],
+						(unsigned)sizes.value[s],unitNames[units.value[u]],(unsigned)status);
+					return 1;
+				}
+			}while((calls < maxCalls) && (now_us()-start < budgetMs*1000.0));
+			total = now_us()-start;
+			SPI_GetStats(handle,&stats);
+			if(emulated)
+				Emu_GetStats(index,&emuStats);
+
+			bytes = (double)sizes.value[s];
+			if(BENCH_UNIT_BITS == units.value[u])
+				bytes = (double)(sizes.value[s]*8-1)/8;
+			qsort(latencies,calls,sizeof(latencies[0]),compare_latency);
+			for(i=0,sum=0;i<(int)calls;i++)
+				sum += latencies[i];
+
+			if(json)
+			{
+				printf("%s\n{\"%s\": \"%s\", \"%s\": \"%s\", \"%s\": %u, \"%s\": %u, "
+					"\"%s\": %u, \"%s\": %u",points?",":"",columns[0],
+					functionNames[functions.value[f]],columns[1],unitNames[units.value[u]],
+					columns[2],(unsigned)sizes.value[s],columns[3],(unsigned)modes.value[m],
+					columns[4],(unsigned)clockRate,columns[5],(unsigned)calls);
+			}
+			else
+			{
+				printf("%s,%s,%u,%u,%u,%u",functionNames[functions.value[f]],
+					unitNames[units.value[u]],(unsigned)sizes.value[s],
+					(unsigned)modes.value[m],(unsigned)clockRate,(unsigned)calls);
+			}
+			{
+				double values[] = {
+					bytes*calls/total,latencies[0],sum/calls,latencies[calls/2],
+					latencies[(calls*99)/100],latencies[calls-1],
+					(double)stats.usbWrites/calls,(double)stats.usbReads/calls,
+					(double)(stats.usbBytesWritten+stats.usbBytesRead)/calls,
+					(emuStats.time > 0)?bytes*calls*1000/(double)emuStats.time:0,
+					(double)emuStats.time/1000/calls,(double)emuStats.outPackets/calls,
+					(double)emuStats.inPackets/calls};
+				for(i=0;i<(int)(sizeof(values)/sizeof(values[0]));i++)
+				{
+					printf(json?", \"%s\": ":",",columns[6+i]);
+					print_value(json,(i < 9) || emulated,values[i]);
+				}
+			}
+			printf(json?"}":"\n");
+			fflush(stdout);
+			points++;
+		}
+	}
+	if(json)
+		printf("\n]\n}\n");
+
+	SPI_CloseChannel(handle);
+	free(inBuffer);
+	free(outBuffer);
+#ifdef _MSC_VER
+	Cleanup_libMPSSE();
+#endif
+	return 0;
+}
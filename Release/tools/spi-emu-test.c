@@ -0,0 +1,470 @@
+/*!
+ * \file spi-emu-test.c
+ *
+ * \author FTDI
+ * \date 20261016
+ *
+ * Copyright  2000-2014 Future Technology Devices International Limited
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Project: libMPSSE
+ * Module: Tools - functional checks of the SPI functions on the emulator
+ *
+ * Builds with:
+ *		Linux:	make spi-emu-test (LibMPSSE/Build/Linux), or
+ *				gcc -I../include -I../include/linux -o spi-emu-test spi-emu-test.c libMPSSE.a -ldl -lpthread
+ *		Windows:gcc -I../include -I../include/windows -o spi-emu-test.exe spi-emu-test.c libMPSSE.a
+ * Usage:
+ *		LIBMPSSE_EMULATOR=2 spi-emu-test
+ *		make test (LibMPSSE/Build/Linux) builds and runs it
+ *
+ * The checks run on channel 0 of the emulator, on which a loopback slave is attached to ADBUS3,
+ * a slave that records MOSI to ADBUS4 and a flash slave to ADBUS6(ADBUS5 is its busy line), and
+ * compares what the slaves saw and answered with what the library returned:
+ *		loopback	SPI_ReadWrite of more than 64KiB, so that it takes several USB reads
+ *		bits		SPI_ReadWrite in bit mode, with a last byte that is not full
+ *		lsb-first	SPI_CONFIG_OPTION_LSB_FIRST on the wire, in bit mode & with SPI_TransferList
+ *		async		SPI_ReadWriteAsync & SPI_WriteAsync tickets, their callbacks and SPI_Wait
+ *		list-flash	SPI_TransferList that programs the flash slave and reads it back after
+ *					SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY
+ *		cs-hold		SPI_CONFIG_OPTION_CS_HOLD clocks csHoldCycles SCLK cycles on the emulator
+ * A line is printed for each check and the exit code is the number of checks that failed.
+ * The library must be started on the emulator(LIBMPSSE_EMULATOR), the checks are not meant
+ * for real hardware.
+ *
+ * Rivision History:
+ * 0.5  - 20261016 - Initial version
+ */
+
+/******************************************************************************/
+/* 							 Include files										   */
+/******************************************************************************/
+/* Standard C libraries */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+
+/* Include D2XX header*/
+#include "ftd2xx.h"
+
+/* Include libMPSSE header */
+#include "libMPSSE_spi.h"
+
+/******************************************************************************/
+/*								Macro and type defines							   */
+/******************************************************************************/
+#define TEST_INDEX					0
+#define TEST_CLOCK_RATE				10000000
+#define TEST_LOOPBACK_PIN			3
+#define TEST_RECORDER_PIN			4
+#define TEST_FLASH_PIN				6
+#define TEST_LOOPBACK_CS			SPI_CONFIG_OPTION_CS_DBUS3
+#define TEST_RECORDER_CS			SPI_CONFIG_OPTION_CS_DBUS4
+#define TEST_FLASH_CS				SPI_CONFIG_OPTION_CS_DBUS6
+#define TEST_LOOPBACK_SIZE			100000
+#define TEST_RECORDER_SIZE			64
+#define TEST_ASYNC_TRANSFERS		4
+#define TEST_ASYNC_SIZE				1000
+#define TEST_CS_HOLD_CYCLES			1000
+
+#define TEST_OPTIONS	(SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE | \
+	SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE)
+
+/* Returns 1 from the check when a call fails */
+#define TEST_CALL(call) do{\
+	FT_STATUS callStatus = (call);\
+	if(FT_OK != callStatus)\
+	{\
+		printf("  %s failed(%u)\n",#call,(unsigned)callStatus);\
+		return 1;\
+	}\
+}while(0)
+
+/* Returns 1 from the check when a condition does not hold */
+#define TEST_EXPECT(condition,...) do{\
+	if(!(condition))\
+	{\
+		printf("  ");\
+		printf(__VA_ARGS__);\
+		printf("\n");\
+		return 1;\
+	}\
+}while(0)
+
+typedef int (*TEST_FUNCTION)(FT_HANDLE handle);
+
+typedef struct TestCheck_t
+{
+	const char		*name;
+	TEST_FUNCTION	function;
+}TestCheck;
+
+typedef struct TestAsyncResult_t
+{
+	uint32		calls;
+	uint32		ticket;
+	FT_STATUS	status;
+	uint32		sizeTransferred;
+}TestAsyncResult;
+
+/******************************************************************************/
+/*								Global variables							  	    */
+/******************************************************************************/
+static uint8 inBuffer[TEST_LOOPBACK_SIZE];
+static uint8 outBuffer[TEST_LOOPBACK_SIZE];
+
+/* MOSI seen by the recorder slave and the byte it answers with */
+static uint8 recorded[TEST_RECORDER_SIZE];
+static uint32 noOfRecorded;
+static uint8 recorderReply;
+
+static TestAsyncResult asyncResults[TEST_ASYNC_TRANSFERS+1];
+
+/******************************************************************************/
+/*						Local function definitions						  		   */
+/******************************************************************************/
+/*!
+ * \brief Transfer function of the recorder slave
+ */
+static uint8 recorder_transfer(void *context, uint8 mosi, uint8 noOfBits)
+{
+	(void)context;
+	(void)noOfBits;
+	if(noOfRecorded < TEST_RECORDER_SIZE)
+		recorded[noOfRecorded++] = mosi;
+	return recorderReply;
+}
+
+/*!
+ * \brief Returns a byte with the bits of value in the opposite order
+ */
+static uint8 reverse_byte(uint8 value)
+{
+	uint8 result=0;
+	int i;
+
+	for(i=0;i<8;i++)
+	{
+		if(value & (1<<i))
+			result |= (uint8)(0x80>>i);
+	}
+	return result;
+}
+
+/*!
+ * \brief Initializes the channel in mode 0 with CS active low, configOptions selects the
+ * CS pin and adds options
+ */
+static FT_STATUS init_channel(FT_HANDLE handle, uint32 configOptions, uint16 csHoldCycles)
+{
+	ChannelConfig config;
+
+	memset(&config,0,sizeof(config));
+	config.ClockRate = TEST_CLOCK_RATE;
+	config.LatencyTimer = 2;
+	config.configOptions = SPI_CONFIG_OPTION_MODE0 | SPI_CONFIG_OPTION_CS_ACTIVELOW |
+		configOptions;
+	config.csHoldCycles = csHoldCycles;
+	return SPI_ReinitChannel(handle,&config);
+}
+
+/*!
+ * \brief Callback of the asynchronous transfers, userData is the index of the transfer
+ */
+static void async_done(FT_HANDLE handle, uint32 ticket, FT_STATUS status,
+	uint32 sizeTransferred, void *userData)
+{
+	TestAsyncResult *result = &asyncResults[(size_t)userData];
+
+	(void)handle;
+	result->calls++;
+	result->ticket = ticket;
+	result->status = status;
+	result->sizeTransferred = sizeTransferred;
+}
+
+/*!
+ * \brief SPI_ReadWrite of TEST_LOOPBACK_SIZE bytes through the loopback slave
+ */
+static int check_loopback(FT_HANDLE handle)
+{
+	uint32 i,sizeTransferred=0;
+
+	TEST_CALL(init_channel(handle,TEST_LOOPBACK_CS,0));
+	for(i=0;i<TEST_LOOPBACK_SIZE;i++)
+		outBuffer[i] = (uint8)(i*13+7);
+	memset(inBuffer,0,sizeof(inBuffer));
+	TEST_CALL(SPI_ReadWrite(handle,inBuffer,outBuffer,TEST_LOOPBACK_SIZE,&sizeTransferred,
+		SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS));
+	TEST_EXPECT(TEST_LOOPBACK_SIZE == sizeTransferred,"%u bytes transferred",
+		(unsigned)sizeTransferred);
+	for(i=0;i<TEST_LOOPBACK_SIZE;i++)
+	{
+		TEST_EXPECT(inBuffer[i] == outBuffer[i],"byte %u read %02x, written %02x",
+			(unsigned)i,inBuffer[i],outBuffer[i]);
+	}
+	return 0;
+}
+
+/*!
+ * \brief SPI_ReadWrite of 13 bits through the loopback slave. The 5 bits of the last byte
+ * are sent from its MSB and received into its LSBs
+ */
+static int check_bits(FT_HANDLE handle)
+{
+	uint8 out[2]={0xA5,0xD8},in[2]={0,0};
+	uint32 sizeTransferred=0;
+
+	TEST_CALL(init_channel(handle,TEST_LOOPBACK_CS,0));
+	TEST_CALL(SPI_ReadWrite(handle,in,out,13,&sizeTransferred,
+		SPI_TRANSFER_OPTIONS_SIZE_IN_BITS | TEST_OPTIONS));
+	TEST_EXPECT(13 == sizeTransferred,"%u bits transferred",(unsigned)sizeTransferred);
+	TEST_EXPECT((in[0] == out[0]) && ((in[1] & 0x1F) == (out[1] >> 3)),
+		"read %02x %02x, written %02x %02x",in[0],in[1],out[0],out[1]);
+	return 0;
+}
+
+/*!
+ * \brief SPI_CONFIG_OPTION_LSB_FIRST puts bit 0 of each byte on the wire first, in byte and
+ * bit mode and in the segments of SPI_TransferList
+ */
+static int check_lsb_first(FT_HANDLE handle)
+{
+	uint8 out[3]={0x01,0x12,0xF0},in[3],rx=0;
+	uint32 i,sizeTransferred=0;
+	SpiSegment segment;
+
+	TEST_CALL(init_channel(handle,TEST_RECORDER_CS | SPI_CONFIG_OPTION_LSB_FIRST,0));
+	noOfRecorded = 0;
+	recorderReply = 0x80;
+	TEST_CALL(SPI_ReadWrite(handle,in,out,3,&sizeTransferred,
+		SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS));
+	TEST_EXPECT(3 == noOfRecorded,"%u bytes on the wire",(unsigned)noOfRecorded);
+	for(i=0;i<3;i++)
+	{
+		TEST_EXPECT((recorded[i] == reverse_byte(out[i])) && (0x01 == in[i]),
+			"byte %u wire %02x read %02x",(unsigned)i,recorded[i],in[i]);
+	}
+
+	/* The 3 bits are the 3 LSBs of the byte, they come back in the same bits */
+	noOfRecorded = 0;
+	recorderReply = 0xA0;
+	out[0] = 0x05;
+	TEST_CALL(SPI_ReadWrite(handle,in,out,3,&sizeTransferred,
+		SPI_TRANSFER_OPTIONS_SIZE_IN_BITS | TEST_OPTIONS));
+	TEST_EXPECT(((recorded[0] & 0xE0) == 0xA0) && ((in[0] & 0xE0) == 0xA0),
+		"bits wire %02x read %02x",recorded[0],in[0]);
+
+	noOfRecorded = 0;
+	recorderReply = 0x80;
+	out[0] = 0x01;
+	memset(&segment,0,sizeof(segment));
+	segment.txBuffer = out;
+	segment.rxBuffer = &rx;
+	segment.length = 1;
+	segment.transferOptions = TEST_OPTIONS;
+	TEST_CALL(SPI_TransferList(handle,&segment,1));
+	TEST_EXPECT((0x80 == recorded[0]) && (0x01 == rx),"list wire %02x read %02x",
+		recorded[0],rx);
+	return 0;
+}
+
+/*!
+ * \brief Queues SPI_ReadWriteAsync transfers and a SPI_WriteAsync through the loopback
+ * slave, then waits for their tickets in turn
+ */
+static int check_async(FT_HANDLE handle)
+{
+	uint32 i,tickets[TEST_ASYNC_TRANSFERS+1],sizeTransferred,noOfPending=0;
+
+	TEST_CALL(init_channel(handle,TEST_LOOPBACK_CS,0));
+	memset(asyncResults,0,sizeof(asyncResults));
+	memset(inBuffer,0,TEST_ASYNC_TRANSFERS*TEST_ASYNC_SIZE);
+	for(i=0;i<TEST_ASYNC_TRANSFERS*TEST_ASYNC_SIZE;i++)
+		outBuffer[i] = (uint8)(i*7+1);
+	for(i=0;i<TEST_ASYNC_TRANSFERS;i++)
+	{
+		TEST_CALL(SPI_ReadWriteAsync(handle,&inBuffer[i*TEST_ASYNC_SIZE],
+			&outBuffer[i*TEST_ASYNC_SIZE],TEST_ASYNC_SIZE,
+			SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS,async_done,(void*)(size_t)i,
+			&tickets[i]));
+	}
+	TEST_CALL(SPI_WriteAsync(handle,outBuffer,TEST_ASYNC_SIZE,
+		SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS,async_done,
+		(void*)(size_t)TEST_ASYNC_TRANSFERS,&tickets[TEST_ASYNC_TRANSFERS]));
+	for(i=0;i<=TEST_ASYNC_TRANSFERS;i++)
+	{
+		sizeTransferred = 0;
+		TEST_CALL(SPI_Wait(handle,tickets[i],&sizeTransferred));
+		TEST_EXPECT(TEST_ASYNC_SIZE == sizeTransferred,"ticket %u transferred %u bytes",
+			(unsigned)tickets[i],(unsigned)sizeTransferred);
+		TEST_EXPECT((1 == asyncResults[i].calls) &&
+			(tickets[i] == asyncResults[i].ticket) && (FT_OK == asyncResults[i].status) &&
+			(TEST_ASYNC_SIZE == asyncResults[i].sizeTransferred),
+			"callback of ticket %u: %u calls, ticket %u, status %u, %u bytes",
+			(unsigned)tickets[i],(unsigned)asyncResults[i].calls,
+			(unsigned)asyncResults[i].ticket,(unsigned)asyncResults[i].status,
+			(unsigned)asyncResults[i].sizeTransferred);
+	}
+	TEST_CALL(SPI_Poll(handle,&noOfPending));
+	TEST_EXPECT(0 == noOfPending,"%u transfers still pending",(unsigned)noOfPending);
+	for(i=0;i<TEST_ASYNC_TRANSFERS*TEST_ASYNC_SIZE;i++)
+	{
+		TEST_EXPECT(inBuffer[i] == outBuffer[i],"byte %u read %02x, written %02x",
+			(unsigned)i,inBuffer[i],outBuffer[i]);
+	}
+	return 0;
+}
+
+/*!
+ * \brief Reads the JEDEC ID of the flash slave, programs a page and reads it back in one
+ * SPI_TransferList. The read waits for the program to finish with
+ * SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY
+ */
+static int check_list_flash(FT_HANDLE handle)
+{
+	uint8 jedec[4]={0x9F,0,0,0},id[4]={0,0,0,0},writeEnable=0x06;
+	uint8 program[4+16]={0x02,0x00,0x20,0x00},read[4]={0x03,0x00,0x20,0x00},data[16];
+	SpiSegment segments[5];
+	uint32 i;
+
+	TEST_CALL(init_channel(handle,TEST_FLASH_CS,0));
+	for(i=0;i<16;i++)
+		program[4+i] = (uint8)(0x5A+i*3);
+	memset(data,0,sizeof(data));
+	memset(segments,0,sizeof(segments));
+	segments[0].txBuffer = jedec;
+	segments[0].rxBuffer = id;
+	segments[0].length = 4;
+	segments[0].transferOptions = TEST_OPTIONS;
+	segments[1].txBuffer = &writeEnable;
+	segments[1].length = 1;
+	segments[1].transferOptions = TEST_OPTIONS;
+	segments[2].txBuffer = program;
+	segments[2].length = sizeof(program);
+	segments[2].transferOptions = TEST_OPTIONS;
+	segments[3].txBuffer = read;
+	segments[3].length = sizeof(read);
+	segments[3].transferOptions = SPI_TRANSFER_OPTIONS_WAIT_WHILE_BUSY |
+		SPI_TRANSFER_OPTIONS_CHIPSELECT_ENABLE;
+	segments[4].rxBuffer = data;
+	segments[4].length = sizeof(data);
+	segments[4].transferOptions = SPI_TRANSFER_OPTIONS_CHIPSELECT_DISABLE;
+	TEST_CALL(SPI_TransferList(handle,segments,5));
+	TEST_EXPECT((0xEF == id[1]) && (0x40 == id[2]) && (0x14 == id[3]),
+		"JEDEC ID %02x %02x %02x",id[1],id[2],id[3]);
+	for(i=0;i<16;i++)
+	{
+		TEST_EXPECT(data[i] == program[4+i],"byte %u read back %02x, programmed %02x",
+			(unsigned)i,data[i],program[4+i]);
+	}
+	return 0;
+}
+
+/*!
+ * \brief SPI_CONFIG_OPTION_CS_HOLD adds csHoldCycles SCLK cycles to a write and a read
+ */
+static int check_cs_hold(FT_HANDLE handle)
+{
+	uint8 value=0x5A;
+	uint32 sizeTransferred;
+	uint64 cycles[2];
+	EmuStats stats;
+	int hold;
+
+	for(hold=0;hold<2;hold++)
+	{
+		TEST_CALL(init_channel(handle,
+			TEST_LOOPBACK_CS | (hold?SPI_CONFIG_OPTION_CS_HOLD:0),TEST_CS_HOLD_CYCLES));
+		TEST_CALL(Emu_ResetStats(TEST_INDEX));
+		TEST_CALL(SPI_Write(handle,&value,1,&sizeTransferred,
+			SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS));
+		TEST_CALL(SPI_Read(handle,&value,1,&sizeTransferred,
+			SPI_TRANSFER_OPTIONS_SIZE_IN_BYTES | TEST_OPTIONS));
+		TEST_CALL(Emu_GetStats(TEST_INDEX,&stats));
+		cycles[hold] = stats.sckCycles;
+	}
+	TEST_EXPECT(cycles[1] >= cycles[0] + 2*TEST_CS_HOLD_CYCLES,
+		"%llu SCLK cycles with the hold, %llu without",(unsigned long long)cycles[1],
+		(unsigned long long)cycles[0]);
+	return 0;
+}
+
+static const TestCheck checks[] = {
+	{"loopback",check_loopback},
+	{"bits",check_bits},
+	{"lsb-first",check_lsb_first},
+	{"async",check_async},
+	{"list-flash",check_list_flash},
+	{"cs-hold",check_cs_hold},
+};
+
+int main(void)
+{
+	FT_STATUS status;
+	FT_HANDLE handle;
+	ChannelConfig config;
+	EmuStats emuStats;
+	EmuSlave slave;
+	int i,failed=0,noOfChecks=(int)(sizeof(checks)/sizeof(checks[0]));
+
+#ifdef _MSC_VER
+	Init_libMPSSE();
+#endif
+	if(FT_OK != Emu_GetStats(TEST_INDEX,&emuStats))
+	{
+		fprintf(stderr,"channel %u is not emulated, set LIBMPSSE_EMULATOR\n",
+			(unsigned)TEST_INDEX);
+		return 1;
+	}
+	status = SPI_OpenChannel(TEST_INDEX,&handle);
+	if(FT_OK != status)
+	{
+		fprintf(stderr,"SPI_OpenChannel failed(%u)\n",(unsigned)status);
+		return 1;
+	}
+	memset(&config,0,sizeof(config));
+	config.ClockRate = TEST_CLOCK_RATE;
+	config.LatencyTimer = 2;
+	config.configOptions = SPI_CONFIG_OPTION_MODE0 | TEST_LOOPBACK_CS |
+		SPI_CONFIG_OPTION_CS_ACTIVELOW;
+	status = SPI_InitChannel(handle,&config);
+	if(FT_OK != status)
+	{
+		fprintf(stderr,"SPI_InitChannel failed(%u)\n",(unsigned)status);
+		return 1;
+	}
+	Emu_LoopbackSlave(TEST_LOOPBACK_PIN,TRUE,&slave);
+	Emu_AttachSlave(TEST_INDEX,&slave);
+	memset(&slave,0,sizeof(slave));
+	slave.csPin = TEST_RECORDER_PIN;
+	slave.csActiveLow = TRUE;
+	slave.transfer = recorder_transfer;
+	Emu_AttachSlave(TEST_INDEX,&slave);
+	Emu_FlashSlave(TEST_FLASH_PIN,TRUE,0,&slave);
+	Emu_AttachSlave(TEST_INDEX,&slave);
+
+	for(i=0;i<noOfChecks;i++)
+	{
+		int result = checks[i].function(handle);
+
+		printf("%s %s\n",result?"FAIL":"PASS",checks[i].name);
+		failed += result;
+	}
+	printf("%d of %d checks failed\n",failed,noOfChecks);
+
+	SPI_CloseChannel(handle);
+#ifdef _MSC_VER
+	Cleanup_libMPSSE();
+#endif
+	return failed;
+}
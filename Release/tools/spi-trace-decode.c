@@ -0,0 +1,187 @@
+/*!
+ * \file spi-trace-decode.c
+ *
+ * \author FTDI
+ * \date 20261015
+ *
+ * Copyright  2000-2014 Future Technology Devices International Limited
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL FUTURE TECHNOLOGY DEVICES INTERNATIONAL LIMITED
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ * THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Project: libMPSSE
+ * Module: Tools - decoder of the files written by SPI_DumpTrace
+ *
+ * Builds with:
+ *		Linux:	gcc -I../include -I../include/linux -o spi-trace-decode spi-trace-decode.c
+ *		Windows:gcc -I../include -I../include/windows -o spi-trace-decode.exe spi-trace-decode.c
+ * Usage:
+ *		spi-trace-decode <file>
+ *
+ * Rivision History:
+ * 0.5  - 20261015 - Initial version
+ *				  decodes the wait on I/O commands
+ *				  decodes the command that sets the high byte
+ */
+
+/******************************************************************************/
+/* 							 Include files										   */
+/******************************************************************************/
+/* Standard C libraries */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+/* OS specific libraries */
+#ifdef _WIN32
+#include<windows.h>
+#endif
+
+/* Include D2XX header*/
+#include "ftd2xx.h"
+
+/* Include libMPSSE header */
+#include "libMPSSE_spi.h"
+
+/******************************************************************************/
+/*								Global variables							  	    */
+/******************************************************************************/
+static const char *callNames[SPI_STATS_NO_OF_CALLS] = {
+	"SPI_Read","SPI_Write","SPI_ReadWrite","SPI_xxxAsync","SPI_Wait","SPI_TransferList"};
+
+static const char *statusNames[] = {
+	"FT_OK","FT_INVALID_HANDLE","FT_DEVICE_NOT_FOUND","FT_DEVICE_NOT_OPENED",
+	"FT_IO_ERROR","FT_INSUFFICIENT_RESOURCES","FT_INVALID_PARAMETER",
+	"FT_INVALID_BAUD_RATE","FT_DEVICE_NOT_OPENED_FOR_ERASE",
+	"FT_DEVICE_NOT_OPENED_FOR_WRITE","FT_FAILED_TO_WRITE_DEVICE",
+	"FT_EEPROM_READ_FAILED","FT_EEPROM_WRITE_FAILED","FT_EEPROM_ERASE_FAILED",
+	"FT_EEPROM_NOT_PRESENT","FT_EEPROM_NOT_PROGRAMMED","FT_INVALID_ARGS",
+	"FT_NOT_SUPPORTED","FT_OTHER_ERROR"};
+
+/******************************************************************************/
+/*						Local function definitions						  		   */
+/******************************************************************************/
+/*!
+ * \brief Returns the name of a status code
+ */
+static const char *status_name(uint32 status)
+{
+	if(status < sizeof(statusNames)/sizeof(statusNames[0]))
+		return statusNames[status];
+	return "unknown status";
+}
+
+/*!
+ * \brief Returns the name of the function of an entry or exit event
+ */
+static const char *call_name(uint8 call)
+{
+	if(call < SPI_STATS_NO_OF_CALLS)
+		return callNames[call];
+	return "unknown call";
+}
+
+/*!
+ * \brief Prints an MPSSE command event
+ */
+static void print_cmd(uint8 opcode, uint32 value)
+{
+	switch(opcode)
+	{
+		case 0x80:
+			printf("set low byte value=0x%02x direction=0x%02x\n",
+				(unsigned)((value>>8) & 0xFF),(unsigned)(value & 0xFF));
+			break;
+		case 0x82:
+			printf("set high byte value=0x%02x direction=0x%02x\n",
+				(unsigned)((value>>8) & 0xFF),(unsigned)(value & 0xFF));
+			break;
+		case 0x8E:
+			printf("clock %u cycles without data\n",(unsigned)value);
+			break;
+		case 0x88:
+			printf("wait while GPIOL1 is low\n");
+			break;
+		case 0x89:
+			printf("wait while GPIOL1 is high\n");
+			break;
+		default:
+			/* bit 1 of a data command selects bit mode, bit 3 LSB first */
+			printf("data 0x%02x %s%s%s%u %s\n",(unsigned)opcode,
+				(opcode & 0x10)?"out ":"",(opcode & 0x20)?"in ":"",
+				(opcode & 0x08)?"lsb first ":"",(unsigned)value,
+				(opcode & 0x02)?"bits":"bytes");
+	}
+}
+
+/******************************************************************************/
+/*						Public function definitions						  		   */
+/******************************************************************************/
+int main(int argc, char **argv)
+{
+	FILE *file;
+	SpiTraceFileHeader header;
+	SpiTraceEvent event;
+	uint32 i;
+	uint64 start=0,previous=0;
+
+	if(argc != 2)
+	{
+		printf("usage: %s <file written by SPI_DumpTrace>\n",argv[0]);
+		return 1;
+	}
+	file = fopen(argv[1],"rb");
+	if(NULL == file)
+	{
+		printf("cannot open %s\n",argv[1]);
+		return 1;
+	}
+	if((1 != fread(&header,sizeof(header),1,file)) ||
+		memcmp(header.magic,SPI_TRACE_FILE_MAGIC,sizeof(header.magic)) ||
+		(header.version != SPI_TRACE_FILE_VERSION))
+	{
+		printf("%s is not a trace file of this version\n",argv[1]);
+		fclose(file);
+		return 1;
+	}
+	printf("%u events\n      time(us)     delta(us)  event\n",(unsigned)header.noOfEvents);
+	for(i=0;(i<header.noOfEvents) && (1 == fread(&event,sizeof(event),1,file));i++)
+	{
+		if(0 == i)
+			start = previous = event.timestamp;
+		printf("%14.3f %13.3f  ",(double)(event.timestamp-start)/1000,
+			(double)(event.timestamp-previous)/1000);
+		previous = event.timestamp;
+		switch(event.type)
+		{
+			case SPI_TRACE_EVENT_ENTER:
+				printf("-> %s(%u)\n",call_name(event.code),(unsigned)event.value);
+				break;
+			case SPI_TRACE_EVENT_EXIT:
+				printf("<- %s %s\n",call_name(event.code),status_name(event.value));
+				break;
+			case SPI_TRACE_EVENT_USB_WRITE:
+				printf("   USB write %u bytes %s\n",(unsigned)event.value,
+					status_name(event.code));
+				break;
+			case SPI_TRACE_EVENT_USB_READ:
+				printf("   USB read %u bytes %s\n",(unsigned)event.value,
+					status_name(event.code));
+				break;
+			case SPI_TRACE_EVENT_CMD:
+				printf("     ");
+				print_cmd(event.code,event.value);
+				break;
+			default:
+				printf("unknown event type %u\n",(unsigned)event.type);
+		}
+	}
+	fclose(file);
+	return 0;
+}